@@ -2,6 +2,8 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <stdint.h>
+#include <math.h>
 
 #include "../tools/debug_alloc.h"
 #include "R-tree.h"
@@ -457,6 +459,255 @@ static int __search_rect(RT_Node *n, RT_Rect *mbr,
 	return nhits;
 }
 
+//
+// Flat image definition
+//
+
+typedef struct RT_ImageHeader
+{
+	char magic[4]; // "RTI"
+	uint32_t version;
+	uint32_t node_count;
+	uint32_t reserved;
+} RT_ImageHeader;
+
+typedef struct RT_FlatBranch
+{
+	int32_t x1, y1;
+	int32_t x2, y2;
+	uint64_t child; // Index of the child node, or the data in a leaf
+} RT_FlatBranch;
+
+typedef struct RT_FlatNode
+{
+	int32_t count;
+	int32_t level;
+	RT_FlatBranch branches[RT_MAXNODES];
+} RT_FlatNode;
+
+#define flat_nodes(image) \
+	((const RT_FlatNode *)((const char *)(image) + sizeof(RT_ImageHeader)))
+
+// The links are checked while searching, so attaching an image costs
+// nothing. A child is always stored after its parent, a link not doing so
+// is skipped and the search always ends.
+static int __search_flat_node(const RT_FlatNode *nodes, uint32_t node_count, uint32_t i, 
+		RT_Rect *mbr, RT_SearchFilter filter, void *arg, BOOL *stop)
+{
+	const RT_FlatNode *n = nodes + i;
+	int count = MIN(n->count, RT_MAXNODES);
+	int nhits = 0;
+	int k;
+
+	for (k = 0; k < count && !*stop; ++k) {
+		const RT_FlatBranch *b = n->branches + k;
+		if (MAX(mbr->x1, b->x1) > MIN(mbr->x2, b->x2)
+				|| MAX(mbr->y1, b->y1) > MIN(mbr->y2, b->y2))
+			continue;
+
+		/* this is an internal node in the tree */
+		if (n->level > 0) {
+			if (b->child > i && b->child < node_count)
+				nhits += __search_flat_node(nodes, node_count, (uint32_t)b->child, 
+						mbr, filter, arg, stop);
+		}
+		/* this is a leaf node */
+		else {
+			++nhits;
+			if (filter((void *)(uintptr_t)b->child, arg) == 0)
+				*stop = TRUE;
+		}
+	}
+
+	return nhits;
+}
+
+static int __search_flat(const void *image, RT_Rect *mbr, 
+		RT_SearchFilter filter, void *arg)
+{
+	const RT_ImageHeader *header = (const RT_ImageHeader *)image;
+	BOOL stop = FALSE;
+
+	if (header->node_count == 0)
+		return 0;
+	return __search_flat_node(flat_nodes(image), header->node_count, 0, 
+			mbr, filter, arg, &stop);
+}
+
+//
+// Node access shared by the pointer and the flat trees, both nodes start
+// with the count and the level.
+//
+
+static const void *__root_node(const RTree *tree)
+{
+	if (tree->image != NULL) {
+		if (((const RT_ImageHeader *)tree->image)->node_count == 0)
+			return NULL;
+		return flat_nodes(tree->image);
+	}
+	return tree->root;
+}
+
+static void __branch_rect(const RTree *tree, const void *n, int i, RT_Rect *r)
+{
+	if (tree->image != NULL) {
+		const RT_FlatBranch *b = ((const RT_FlatNode *)n)->branches + i;
+		r->x1 = b->x1;
+		r->y1 = b->y1;
+		r->x2 = b->x2;
+		r->y2 = b->y2;
+	}
+	else
+		*r = ((const RT_Node *)n)->branches[i].mbr;
+}
+
+static void *__branch_data(const RTree *tree, const void *n, int i)
+{
+	if (tree->image != NULL)
+		return (void *)(uintptr_t)((const RT_FlatNode *)n)->branches[i].child;
+	return ((const RT_Node *)n)->branches[i].child;
+}
+
+// Returns the child of an internal node, or NULL if the link is bad.
+static const void *__child_node(const RTree *tree, const void *n, int i)
+{
+	const RT_Node *child;
+
+	if (tree->image != NULL) {
+		const RT_ImageHeader *header = (const RT_ImageHeader *)tree->image;
+		const RT_FlatNode *nodes = flat_nodes(tree->image);
+		uint64_t index = ((const RT_FlatNode *)n)->branches[i].child;
+		if (index <= (uint64_t)((const RT_FlatNode *)n - nodes) || index >= header->node_count)
+			return NULL;
+		child = (const RT_Node *)(nodes + index);
+	}
+	else
+		child = ((const RT_Node *)n)->branches[i].child;
+
+	/* the levels go down one by one, which bounds the depth */
+	if (child->level != ((const RT_Node *)n)->level - 1)
+		return NULL;
+	return child;
+}
+
+static int __search_batch(const RTree *tree, const void *n, const RT_Window *windows, 
+		int count, int *active, int nactive, RT_BatchFilter filter, void *arg, BOOL *stop)
+{
+	const RT_Node *hdr = (const RT_Node *)n;
+	int *sub = active + count; /* the list for the next level */
+	int ncount = MIN(hdr->count, RT_MAXNODES);
+	int nhits = 0;
+	int i, j;
+
+	for (i = 0; i < ncount && !*stop; ++i) {
+		RT_Rect r;
+		__branch_rect(tree, n, i, &r);
+
+		/* this is an internal node in the tree */
+		if (hdr->level > 0) {
+			int nsub = 0;
+			for (j = 0; j < nactive; ++j) {
+				const RT_Window *w = windows + active[j];
+				if (MAX(w->minX, r.x1) <= MIN(w->maxX, r.x2)
+						&& MAX(w->minY, r.y1) <= MIN(w->maxY, r.y2))
+					sub[nsub++] = active[j];
+			}
+			if (nsub > 0) {
+				const void *child = __child_node(tree, n, i);
+				if (child != NULL)
+					nhits += __search_batch(tree, child, windows, count, 
+							sub, nsub, filter, arg, stop);
+			}
+		}
+		/* this is a leaf node */
+		else {
+			for (j = 0; j < nactive && !*stop; ++j) {
+				const RT_Window *w = windows + active[j];
+				if (MAX(w->minX, r.x1) <= MIN(w->maxX, r.x2)
+						&& MAX(w->minY, r.y1) <= MIN(w->maxY, r.y2)) {
+					++nhits;
+					if (filter(__branch_data(tree, n, i), active[j], arg) == 0)
+						*stop = TRUE;
+				}
+			}
+		}
+	}
+
+	return nhits;
+}
+
+//
+// Priority queue of the nearest search, a binary min-heap on the distance
+//
+
+typedef struct RT_HeapItem
+{
+	double dist2;
+	const void *node; /* NULL for a data item */
+	void *data;
+} RT_HeapItem;
+
+typedef struct RT_Heap
+{
+	RT_HeapItem *items;
+	size_t count;
+	size_t size;
+} RT_Heap;
+
+static void __heap_push(RT_Heap *heap, const RT_HeapItem *item)
+{
+	size_t i;
+
+	if (heap->count == heap->size) {
+		size_t size = heap->size == 0 ? 64 : heap->size * 2;
+		RT_HeapItem *items = (RT_HeapItem *)REALLOC(heap->items, size * sizeof(RT_HeapItem));
+		if (items == NULL) {
+			fprintf(stderr, "***[RTree] Lack of memory.\n");
+			exit(1);
+		}
+		heap->items = items;
+		heap->size = size;
+	}
+
+	i = heap->count++;
+	while (i > 0 && heap->items[(i - 1) / 2].dist2 > item->dist2) {
+		heap->items[i] = heap->items[(i - 1) / 2];
+		i = (i - 1) / 2;
+	}
+	heap->items[i] = *item;
+}
+
+static BOOL __heap_pop(RT_Heap *heap, RT_HeapItem *item)
+{
+	RT_HeapItem last;
+	size_t i = 0, c;
+
+	if (heap->count == 0)
+		return FALSE;
+
+	*item = heap->items[0];
+	last = heap->items[--heap->count];
+	while ((c = 2 * i + 1) < heap->count) {
+		if (c + 1 < heap->count && heap->items[c + 1].dist2 < heap->items[c].dist2)
+			++c;
+		if (last.dist2 <= heap->items[c].dist2)
+			break;
+		heap->items[i] = heap->items[c];
+		i = c;
+	}
+	heap->items[i] = last;
+
+	return TRUE;
+}
+
+static double __point_dist2(const RT_Rect *r, int x, int y)
+{
+	double dx = x < r->x1 ? (double)r->x1 - x : (x > r->x2 ? (double)x - r->x2 : 0);
+	double dy = y < r->y1 ? (double)r->y1 - y : (y > r->y2 ? (double)y - r->y2 : 0);
+	return dx * dx + dy * dy;
+}
+
 /*
  * ~
  */
@@ -473,15 +724,111 @@ RTree *rtreeCreate()
 	tree->root->level = 0; /* a leaf */
 	tree->split = NULL;
 	tree->isdummy = FALSE;
+	tree->image = NULL;
 	tree->filter = NULL;
 	tree->cb_arg = NULL;
 
 	return tree;
 }
 
+/*
+ * Sort-Tile-Recursive packing
+ *
+ * The branches of a level are sorted by the x of their centers and cut
+ * into vertical slices of about sqrt(P) nodes, P is the number of nodes
+ * of the level. Each slice is sorted by the y of the centers and packed
+ * into full nodes, which are the branches of the upper level.
+ */
+
+static int __cmp_center_x(const void *a, const void *b)
+{
+	const RT_Rect *r1 = &((const RT_Branch *)a)->mbr;
+	const RT_Rect *r2 = &((const RT_Branch *)b)->mbr;
+	COORTYPE c1 = r1->x1 + r1->x2;
+	COORTYPE c2 = r2->x1 + r2->x2;
+	return c1 < c2 ? -1 : (c1 > c2 ? 1 : 0);
+}
+
+static int __cmp_center_y(const void *a, const void *b)
+{
+	const RT_Rect *r1 = &((const RT_Branch *)a)->mbr;
+	const RT_Rect *r2 = &((const RT_Branch *)b)->mbr;
+	COORTYPE c1 = r1->y1 + r1->y2;
+	COORTYPE c2 = r2->y1 + r2->y2;
+	return c1 < c2 ? -1 : (c1 > c2 ? 1 : 0);
+}
+
+/* packs the branches of a level into nodes, and returns the number of them, 
+ * the branches are replaced by the ones of the nodes */
+static size_t __pack_level(RT_Branch *branches, size_t count, int level)
+{
+	size_t nnodes = (count + RT_MAXNODES - 1) / RT_MAXNODES;
+	size_t nslices = (size_t)ceil(sqrt((double)nnodes));
+	size_t slice_size = ((nnodes + nslices - 1) / nslices) * RT_MAXNODES;
+	size_t i, j, k = 0;
+
+	qsort(branches, count, sizeof(RT_Branch), __cmp_center_x);
+	for (i = 0; i < count; i += slice_size)
+		qsort(branches + i, MIN(slice_size, count - i), sizeof(RT_Branch), __cmp_center_y);
+
+	/* the node k is made of the branches from k*RT_MAXNODES, 
+	 * which are not needed any more when its branch is stored at k */
+	for (i = 0; i < count; i += RT_MAXNODES) {
+		RT_Node *n = __new_node();
+		n->level = level;
+		for (j = i; j < count && j < i + RT_MAXNODES; ++j)
+			n->branches[n->count++] = branches[j];
+
+		branches[k].mbr = __node_mbr(n);
+		branches[k].child = n;
+		++k;
+	}
+	assert(k == nnodes);
+
+	return nnodes;
+}
+
+RTree *rtreeBulkLoad(const RT_Item *items, size_t count)
+{
+	RTree *tree = rtreeCreate();
+	RT_Branch *branches;
+	size_t i;
+	int level = 0;
+
+	if (count == 0)
+		return tree;
+
+	branches = (RT_Branch *)MALLOC(count * sizeof(RT_Branch));
+	if (branches == NULL) {
+		fprintf(stderr, "***[RTree] Lack of memory.\n");
+		exit(1);
+	}
+
+	for (i = 0; i < count; ++i) {
+		assert(items[i].data != NULL);
+		branches[i].mbr.x1 = items[i].minX;
+		branches[i].mbr.y1 = items[i].minY;
+		branches[i].mbr.x2 = items[i].maxX;
+		branches[i].mbr.y2 = items[i].maxY;
+		branches[i].child = (RT_Node *)items[i].data;
+	}
+
+	/* the leaves and the internal levels, until the rest fit in the root */
+	while (count > RT_MAXNODES)
+		count = __pack_level(branches, count, level++);
+
+	tree->root->level = level;
+	for (i = 0; i < count; ++i)
+		tree->root->branches[tree->root->count++] = branches[i];
+
+	FREE(branches);
+
+	return tree;
+}
+
 void rtreeDestroy(RTree *tree)
 {
-	if (!tree->isdummy)
+	if (!tree->isdummy && tree->image == NULL)
 		__free_node(tree->root);
 
 	if (tree->split != NULL)
@@ -500,7 +847,7 @@ void rtreeInsert(RTree *tree, int minX, int minY, int maxX, int maxY, void *data
 	mbr.x2 = maxX;
 	mbr.y2 = maxY;
 
-	assert(!tree->isdummy);
+	assert(!tree->isdummy && tree->image == NULL);
 
 	if (__insert_rect(tree, &mbr, data, tree->root, &new_node, 0)) {
 		RT_Node *new_root;
@@ -529,14 +876,127 @@ void rtreeSetFilter(RTree *tree, RT_SearchFilter filter, void *arg)
 
 int rtreeSearch(RTree *tree, int minX, int minY, int maxX, int maxY)
 {
-	assert(tree->filter != NULL);
+	return rtreeSearchWith(tree, minX, minY, maxX, maxY, tree->filter, tree->cb_arg);
+}
+
+int rtreeSearchWith(const RTree *tree, int minX, int minY, int maxX, int maxY, 
+		RT_SearchFilter filter, void *arg)
+{
+	assert(filter != NULL);
 
 	RT_Rect mbr;
 	mbr.x1 = minX;
 	mbr.y1 = minY;
 	mbr.x2 = maxX;
 	mbr.y2 = maxY;
-	return __search_rect(tree->root, &mbr, tree->filter, tree->cb_arg);
+	if (tree->image != NULL)
+		return __search_flat(tree->image, &mbr, filter, arg);
+	return __search_rect(tree->root, &mbr, filter, arg);
+}
+
+int rtreeSearchBatch(const RTree *tree, const RT_Window *windows, int count, 
+		RT_BatchFilter filter, void *arg)
+{
+	const void *root = __root_node(tree);
+	BOOL stop = FALSE;
+	int *buf;
+	int i, nhits;
+
+	assert(filter != NULL);
+
+	if (root == NULL || count <= 0 || ((const RT_Node *)root)->level < 0)
+		return 0;
+
+	/* a list of the windows overlapping the node for each level */
+	buf = (int *)MALLOC(sizeof(int) * count * (((const RT_Node *)root)->level + 1));
+	if (buf == NULL) {
+		fprintf(stderr, "***[RTree] Lack of memory.\n");
+		exit(1);
+	}
+
+	for (i = 0; i < count; ++i)
+		buf[i] = i;
+	nhits = __search_batch(tree, root, windows, count, buf, count, filter, arg, &stop);
+
+	FREE(buf);
+
+	return nhits;
+}
+
+int rtreeNearest(const RTree *tree, int x, int y, int k, void **data, double *dist2)
+{
+	const void *root = __root_node(tree);
+	RT_Heap heap;
+	RT_HeapItem *best; /* the k nearest data items found, ascending */
+	int nbest = 0;
+	int i, j;
+
+	if (root == NULL || k <= 0)
+		return 0;
+
+	best = (RT_HeapItem *)MALLOC(sizeof(RT_HeapItem) * k);
+	if (best == NULL) {
+		fprintf(stderr, "***[RTree] Lack of memory.\n");
+		exit(1);
+	}
+
+	heap.items = NULL;
+	heap.count = 0;
+	heap.size = 0;
+
+	RT_HeapItem item;
+	item.dist2 = 0;
+	item.node = root;
+	item.data = NULL;
+	__heap_push(&heap, &item);
+
+	/* best first, the nodes are visited by the distance to them, 
+	 * until the nearest one is farther than the k items found */
+	while (__heap_pop(&heap, &item)) {
+		if (nbest == k && item.dist2 > best[k - 1].dist2)
+			break;
+
+		const RT_Node *n = (const RT_Node *)item.node;
+		int count = MIN(n->count, RT_MAXNODES);
+		for (i = 0; i < count; ++i) {
+			RT_HeapItem sub;
+			RT_Rect r;
+			__branch_rect(tree, item.node, i, &r);
+			sub.dist2 = __point_dist2(&r, x, y);
+			if (nbest == k && sub.dist2 >= best[k - 1].dist2)
+				continue;
+
+			/* this is an internal node in the tree */
+			if (n->level > 0) {
+				sub.node = __child_node(tree, item.node, i);
+				sub.data = NULL;
+				if (sub.node != NULL)
+					__heap_push(&heap, &sub);
+			}
+			/* this is a leaf node */
+			else {
+				sub.node = NULL;
+				sub.data = __branch_data(tree, item.node, i);
+				if (nbest < k)
+					++nbest;
+				for (j = nbest - 1; j > 0 && best[j - 1].dist2 > sub.dist2; --j)
+					best[j] = best[j - 1];
+				best[j] = sub;
+			}
+		}
+	}
+
+	for (i = 0; i < nbest; ++i) {
+		if (data != NULL)
+			data[i] = best[i].data;
+		if (dist2 != NULL)
+			dist2[i] = best[i].dist2;
+	}
+
+	FREE(heap.items);
+	FREE(best);
+
+	return nbest;
 }
 
 /*
@@ -559,6 +1019,18 @@ void __write_node(RT_Node *n, FILE *fp)
 			__write_node(n->branches[i].child, fp);
 }
 
+size_t __count_nodes(RT_Node *n)
+{
+	size_t res = 1;
+	int i;
+
+	if (n->level != 0)
+		for (i = 0; i < n->count; ++i)
+			res += __count_nodes(n->branches[i].child);
+
+	return res;
+}
+
 void __link_node(RT_Node **np, RT_Node **next_node)
 {
 	int i;
@@ -589,6 +1061,7 @@ RTree *rtreeRejoint(void *treeImage)
 	tree->root = NULL;
 	tree->split = NULL;
 	tree->isdummy = TRUE;
+	tree->image = NULL;
 	tree->filter = NULL;
 	tree->cb_arg = NULL;
 
@@ -599,6 +1072,122 @@ RTree *rtreeRejoint(void *treeImage)
 	return tree;
 }
 
+// Checks the node at *next and its descendants lie in the count nodes of
+// the image, in the order __link_node() takes them.
+static BOOL __check_node(const RT_Node *image, size_t count, size_t *next, int level)
+{
+	const RT_Node *n;
+	int i;
+
+	if (*next >= count)
+		return FALSE;
+	n = image + (*next)++;
+	if (n->count < 0 || n->count > RT_MAXNODES || n->level < 0
+			|| (level >= 0 && n->level != level))
+		return FALSE;
+
+	if (n->level != 0)
+		for (i = 0; i < n->count; ++i)
+			if (!__check_node(image, count, next, n->level - 1))
+				return FALSE;
+
+	return TRUE;
+}
+
+RTree *rtreeRejointImage(void *treeImage, size_t size)
+{
+	size_t next = 0;
+
+	if (!__check_node((const RT_Node *)treeImage, size / sizeof(RT_Node), &next, -1))
+		return NULL;
+	return rtreeRejoint(treeImage);
+}
+
+/*
+ * Flat image serialization
+ *
+ * The nodes are stored breadth first from the root, so the upper levels,
+ * which every search passes through, share the first pages of the image.
+ */
+
+size_t rtreeFlatImageSize(RTree *tree)
+{
+	return sizeof(RT_ImageHeader) + __count_nodes(tree->root) * sizeof(RT_FlatNode);
+}
+
+void rtreeSaveFlatImage(RTree *tree, void *buf)
+{
+	RT_ImageHeader *header = (RT_ImageHeader *)buf;
+	RT_FlatNode *flat = (RT_FlatNode *)((char *)buf + sizeof(RT_ImageHeader));
+	size_t count = __count_nodes(tree->root);
+	size_t head, tail;
+	int i;
+
+	assert(tree->image == NULL);
+
+	RT_Node **queue = (RT_Node **)MALLOC(count * sizeof(RT_Node *));
+	if (queue == NULL) {
+		fprintf(stderr, "***[RTree] Lack of memory.\n");
+		exit(1);
+	}
+
+	memset(header, 0, sizeof(RT_ImageHeader));
+	memcpy(header->magic, "RTI", 4);
+	header->version = RT_IMAGE_VERSION;
+	header->node_count = (uint32_t)count;
+
+	queue[0] = tree->root;
+	tail = 1;
+	for (head = 0; head < count; ++head) {
+		RT_Node *n = queue[head];
+		RT_FlatNode *f = flat + head;
+
+		memset(f, 0, sizeof(RT_FlatNode));
+		f->count = n->count;
+		f->level = n->level;
+		for (i = 0; i < n->count; ++i) {
+			RT_Branch *b = n->branches + i;
+			f->branches[i].x1 = (int32_t)b->mbr.x1;
+			f->branches[i].y1 = (int32_t)b->mbr.y1;
+			f->branches[i].x2 = (int32_t)b->mbr.x2;
+			f->branches[i].y2 = (int32_t)b->mbr.y2;
+			if (n->level > 0) {
+				f->branches[i].child = tail;
+				queue[tail++] = b->child;
+			}
+			else
+				f->branches[i].child = (uint64_t)(uintptr_t)b->child;
+		}
+	}
+	assert(tail == count);
+
+	FREE(queue);
+}
+
+RTree *rtreeAttachImage(const void *image, size_t size)
+{
+	const RT_ImageHeader *header = (const RT_ImageHeader *)image;
+
+	if (size < sizeof(RT_ImageHeader) || ((uintptr_t)image % RT_IMAGE_ALIGN) != 0
+			|| memcmp(header->magic, "RTI", 4) != 0
+			|| header->version != RT_IMAGE_VERSION
+			|| header->node_count > (size - sizeof(RT_ImageHeader)) / sizeof(RT_FlatNode))
+		return NULL;
+
+	RTree *tree = (RTree *)MALLOC(sizeof(RTree));
+	if (tree == NULL)
+		return NULL;
+
+	tree->root = NULL;
+	tree->split = NULL;
+	tree->isdummy = TRUE;
+	tree->image = image;
+	tree->filter = NULL;
+	tree->cb_arg = NULL;
+
+	return tree;
+}
+
 /*
  * Testing
  */
@@ -681,3 +1270,151 @@ int main()
 	return 0;
 }
 #endif
+
+#ifdef RTREE_BENCHMARK
+#include <time.h>
+
+#define BM_WORLD 1000000
+#define BM_ITEMS 200000
+#define BM_QUERIES 20000
+#define BM_BATCH 64
+#define BM_K 10
+
+static int __bm_rand(int n)
+{
+	return (int)(((unsigned)rand() << 15 ^ (unsigned)rand()) % (unsigned)n);
+}
+
+static int __bm_count(void *data, void *arg)
+{
+	data = data;
+	++*(long *)arg;
+	return 1;
+}
+
+static int __bm_count_batch(void *data, int window, void *arg)
+{
+	data = data;
+	window = window;
+	++*(long *)arg;
+	return 1;
+}
+
+static double __bm_secs(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+// Benchmarks the queries on the trees built by insertion and by bulk
+// loading, on the flat images, and the nearest search against finding
+// the k nearest items by growing windows with rtreeSearch().
+int main()
+{
+	RT_Item *items = (RT_Item *)malloc(sizeof(RT_Item) * BM_ITEMS);
+	RT_Window *windows = (RT_Window *)malloc(sizeof(RT_Window) * BM_QUERIES);
+	RTree *trees[3];
+	const char *names[3] = { "insert", "bulk", "flat" };
+	char *image;
+	clock_t start;
+	long hits;
+	int i, j, t;
+
+	srand(1);
+	for (i = 0; i < BM_ITEMS; ++i) {
+		items[i].minX = __bm_rand(BM_WORLD);
+		items[i].minY = __bm_rand(BM_WORLD);
+		items[i].maxX = items[i].minX + __bm_rand(2000);
+		items[i].maxY = items[i].minY + __bm_rand(2000);
+		items[i].data = (void *)(uintptr_t)(i + 1);
+	}
+	for (i = 0; i < BM_QUERIES; ++i) {
+		windows[i].minX = __bm_rand(BM_WORLD);
+		windows[i].minY = __bm_rand(BM_WORLD);
+		windows[i].maxX = windows[i].minX + 5000;
+		windows[i].maxY = windows[i].minY + 5000;
+	}
+
+	start = clock();
+	trees[0] = rtreeCreate();
+	for (i = 0; i < BM_ITEMS; ++i)
+		rtreeInsert(trees[0], items[i].minX, items[i].minY, 
+				items[i].maxX, items[i].maxY, items[i].data);
+	printf("build  insert %8.3fs %6lu nodes\n", __bm_secs(start), (unsigned long)__count_nodes(trees[0]->root));
+
+	start = clock();
+	trees[1] = rtreeBulkLoad(items, BM_ITEMS);
+	printf("build  bulk   %8.3fs %6lu nodes\n", __bm_secs(start), (unsigned long)__count_nodes(trees[1]->root));
+
+	image = (char *)malloc(rtreeFlatImageSize(trees[1]));
+	rtreeSaveFlatImage(trees[1], image);
+	trees[2] = rtreeAttachImage(image, rtreeFlatImageSize(trees[1]));
+
+	for (t = 0; t < 3; ++t) {
+		hits = 0;
+		start = clock();
+		rtreeSetFilter(trees[t], __bm_count, &hits);
+		for (i = 0; i < BM_QUERIES; ++i)
+			rtreeSearch(trees[t], windows[i].minX, windows[i].minY, windows[i].maxX, windows[i].maxY);
+		printf("search %-6s %8.3fs %8ld hits\n", names[t], __bm_secs(start), hits);
+
+		hits = 0;
+		start = clock();
+		for (i = 0; i < BM_QUERIES; ++i)
+			rtreeSearchWith(trees[t], windows[i].minX, windows[i].minY, windows[i].maxX, windows[i].maxY, 
+					__bm_count, &hits);
+		printf("with   %-6s %8.3fs %8ld hits\n", names[t], __bm_secs(start), hits);
+
+		/* the windows of a batch are near each other, as when picking */
+		hits = 0;
+		start = clock();
+		for (i = 0; i < BM_QUERIES; i += BM_BATCH) {
+			RT_Window batch[BM_BATCH];
+			for (j = 0; j < BM_BATCH; ++j) {
+				batch[j] = windows[i];
+				batch[j].minX += j * 100;
+				batch[j].maxX += j * 100;
+			}
+			rtreeSearchBatch(trees[t], batch, BM_BATCH, __bm_count_batch, &hits);
+		}
+		printf("batch  %-6s %8.3fs %8ld hits\n", names[t], __bm_secs(start), hits);
+
+		hits = 0;
+		start = clock();
+		for (i = 0; i < BM_QUERIES; i += BM_BATCH) {
+			for (j = 0; j < BM_BATCH; ++j)
+				rtreeSearchWith(trees[t], windows[i].minX + j * 100, windows[i].minY, 
+						windows[i].maxX + j * 100, windows[i].maxY, __bm_count, &hits);
+		}
+		printf("single %-6s %8.3fs %8ld hits\n", names[t], __bm_secs(start), hits);
+
+		hits = 0;
+		start = clock();
+		for (i = 0; i < BM_QUERIES; ++i)
+			hits += rtreeNearest(trees[t], windows[i].minX, windows[i].minY, BM_K, NULL, NULL);
+		printf("knn    %-6s %8.3fs %8ld found\n", names[t], __bm_secs(start), hits);
+
+		/* grows the window until it holds k items, the way without rtreeNearest() */
+		hits = 0;
+		start = clock();
+		for (i = 0; i < BM_QUERIES; ++i) {
+			int x = windows[i].minX, y = windows[i].minY, d = 500;
+			long n;
+			do {
+				n = 0;
+				rtreeSearchWith(trees[t], x - d, y - d, x + d, y + d, __bm_count, &n);
+				d *= 2;
+			} while (n < BM_K);
+			hits += n;
+		}
+		printf("window %-6s %8.3fs %8ld found\n", names[t], __bm_secs(start), hits);
+	}
+
+	for (t = 0; t < 3; ++t)
+		rtreeDestroy(trees[t]);
+	free(image);
+	free(windows);
+	free(items);
+
+	return 0;
+}
+#endif
@@ -33,6 +33,7 @@ typedef struct RTree
 	struct RT_Node *root;
 	struct RT_Split *split;
 	BOOL isdummy;
+	const void *image; // The flat image searched in place, if attached
 
 	RT_SearchFilter filter;
 	void *cb_arg;
@@ -40,6 +41,19 @@ typedef struct RTree
 
 GEO_EXPORT RTree *rtreeCreate();
 
+typedef struct RT_Item
+{
+	int minX, minY;
+	int maxX, maxY;
+	void *data;
+} RT_Item;
+
+// Creates a tree from all the items at once by Sort-Tile-Recursive packing.
+// The nodes are filled up, so the tree is smaller and searched faster than
+// one built by insertion.
+// NOTE: The data cann't be empty as rtreeInsert().
+GEO_EXPORT RTree *rtreeBulkLoad(const RT_Item *items, size_t count);
+
 GEO_EXPORT void rtreeDestroy(RTree *);
 
 // Inserts a rectangle to the tree. 
@@ -48,10 +62,61 @@ GEO_EXPORT void rtreeInsert(RTree *, int minX, int minY, int maxX, int maxY, voi
 
 GEO_EXPORT void rtreeSetFilter(RTree *, RT_SearchFilter filter, void *arg);
 
+// Searches with the filter set by rtreeSetFilter(), which is shared by
+// all the searches on the tree, see rtreeSearchWith() for concurrent ones.
 GEO_EXPORT int rtreeSearch(RTree *, int minX, int minY, int maxX, int maxY);
 
+// Same as rtreeSearch(), but the callback is passed per call, so the tree
+// can be searched by several threads at the same time.
+GEO_EXPORT int rtreeSearchWith(const RTree *, int minX, int minY, int maxX, int maxY, 
+		RT_SearchFilter filter, void *arg);
+
+typedef struct RT_Window
+{
+	int minX, minY;
+	int maxX, maxY;
+} RT_Window;
+
+/*
+ * Called with the data of each data mbr that overlaps a window of a batched
+ * search, the index of the window and the user pointer. Returning 0 
+ * terminates the whole search.
+ */
+typedef int (*RT_BatchFilter)(void *data, int window, void *arg);
+
+// Searches several windows in one traversal, a node is visited once for all
+// the windows overlapping it. Returns the total number of hits.
+GEO_EXPORT int rtreeSearchBatch(const RTree *, const RT_Window *windows, int count, 
+		RT_BatchFilter filter, void *arg);
+
+// Finds the k items nearest to the point by the distance to their mbrs,
+// the nearest first. The data and the squared distances are stored to
+// data and dist2, which may be NULL. Returns the number of items found.
+GEO_EXPORT int rtreeNearest(const RTree *, int x, int y, int k, void **data, double *dist2);
+
 GEO_EXPORT void rtreeSave(RTree *, FILE *fp);
 GEO_EXPORT RTree *rtreeRejoint(void *treeImage);
+// Same as rtreeRejoint(), but checks the nodes lie in the size bytes of
+// the image first. Returns NULL if the image is bad.
+GEO_EXPORT RTree *rtreeRejointImage(void *treeImage, size_t size);
+
+/*
+ * Flat image of the tree. The child links are stored as node indices
+ * instead of pointers, so the image is position-independent and can be
+ * searched in place, e.g. on a read-only mapping shared by processes.
+ * The image starts with a versioned header and must be aligned to
+ * RT_IMAGE_ALIGN bytes.
+ */
+#define RT_IMAGE_VERSION 1
+#define RT_IMAGE_ALIGN   8
+
+// Returns the size in bytes of the flat image.
+GEO_EXPORT size_t rtreeFlatImageSize(RTree *);
+// Saves the flat image to the buffer, which holds rtreeFlatImageSize() bytes.
+GEO_EXPORT void rtreeSaveFlatImage(RTree *, void *buf);
+// Attaches a tree to the flat image of size bytes without copying it.
+// The image must outlive the tree. Returns NULL if the image is bad.
+GEO_EXPORT RTree *rtreeAttachImage(const void *image, size_t size);
 
 #ifdef __cplusplus
 }
@@ -1,7 +1,15 @@
 #include <math.h>
 #include <assert.h>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include <thread>
+#include <vector>
+
 #include "utmproject.h"
+#include "utmproject_simd.h"
 
 using namespace Geo;
 
@@ -95,6 +103,72 @@ void Mercator::project(double lon, double lat, double *x, double *y) const
 			* pow((1 - _E1 * sin_lat) / (1 + _E1 * sin_lat), _E1_2));
 }
 
+#ifndef MERCATOR_SSE2
+// Without vectors the haversine kernel is slower than distance(),
+// so the batch distances fall back to distance() point by point.
+static void distanceToScalar(double lon0, double lat0, const double *lon, const double *lat, 
+				double *d, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		d[i] = Geo::distance(lon0, lat0, lon[i], lat[i]);
+}
+
+static void distancePairScalar(const double *lon1, const double *lat1, 
+				const double *lon2, const double *lat2, double *d, size_t n)
+{
+	for (size_t i = 0; i < n; ++i)
+		d[i] = Geo::distance(lon1[i], lat1[i], lon2[i], lat2[i]);
+}
+#endif
+
+// Returns the kernels of the batch projections for the CPU.
+static GeoKernels selectKernels()
+{
+	GeoKernels kernels;
+#ifdef MERCATOR_SSE2
+	bool hasAvx2 = false;
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] >= 7) {
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0;
+		__cpuidex(info, 7, 0);
+		hasAvx2 = osxsave && (info[1] & (1 << 5)) != 0 && (_xgetbv(0) & 6) == 6;
+	}
+#else
+	hasAvx2 = __builtin_cpu_supports("avx2");
+#endif
+	if (hasAvx2 && geoAvx2Kernels(&kernels))
+		return kernels;
+	kernels.project = mercatorProjectDm<MercatorSse2Ops>;
+	kernels.aproject = mercatorAprojectDm<MercatorSse2Ops>;
+	kernels.distanceTo = sphereDistanceTo<MercatorSse2Ops>;
+	kernels.distancePair = sphereDistancePair<MercatorSse2Ops>;
+#else
+	kernels.project = mercatorProjectDm<MercatorScalarOps>;
+	kernels.aproject = mercatorAprojectDm<MercatorScalarOps>;
+	kernels.distanceTo = distanceToScalar;
+	kernels.distancePair = distancePairScalar;
+#endif
+	return kernels;
+}
+
+static const GeoKernels &kernels()
+{
+	static const GeoKernels k = selectKernels();
+	return k;
+}
+
+void Mercator::projectDm(const double *lon, const double *lat, int32_t *x, int32_t *y, size_t n) const
+{
+	MercatorConst c;
+	c.k = _K;
+	c.origLon = _origLon;
+	c.e = _E1;
+	kernels().project(c, lon, lat, x, y, n);
+}
+
 void Mercator::aproject(double x, double y, double *lon, double *lat) const
 {
 	double rlon = x / _K + _origLon;
@@ -110,6 +184,15 @@ void Mercator::aproject(double x, double y, double *lon, double *lat) const
 	*lat = RAD2DEGREE(rlat);
 }
 
+void Mercator::aprojectDm(const int32_t *x, const int32_t *y, double *lon, double *lat, size_t n) const
+{
+	MercatorConst c;
+	c.k = _K;
+	c.origLon = _origLon;
+	c.e = _E1;
+	kernels().aproject(c, x, y, lon, lat, n);
+}
+
 #define CMF 111319.4907932735683082883485 // circumference factor (2πr/360)
 
 double Geo::distance(double x1, double y1, double x2, double y2)
@@ -121,3 +204,257 @@ double Geo::distance(double x1, double y1, double x2, double y2)
 	double alpha = acos(cos(y1) * cos(y2) * cos(x1 - x2) + sin(y1) * sin(y2));
 	return RAD2DEGREE(alpha) * CMF;
 }
+
+void Geo::distances(double x0, double y0, const double *x, const double *y, double *d, size_t n)
+{
+	kernels().distanceTo(x0, y0, x, y, d, n);
+}
+
+void Geo::pathDistances(const double *x, const double *y, double *d, size_t n)
+{
+	if (n > 1)
+		kernels().distancePair(x, y, x + 1, y + 1, d, n - 1);
+}
+
+static void distanceRows(const double *x1, const double *y1, size_t begin, size_t end, 
+		const double *x2, const double *y2, size_t n2, double *d)
+{
+	DistanceToKernel distanceTo = kernels().distanceTo;
+	for (size_t i = begin; i < end; ++i)
+		distanceTo(x1[i], y1[i], x2, y2, d + i * n2, n2);
+}
+
+void Geo::distanceMatrix(const double *x1, const double *y1, size_t n1, 
+		const double *x2, const double *y2, size_t n2, double *d, int threadCount)
+{
+	// Threads pay off only for a matrix of some millions of distances
+	const size_t minPerThread = 1 << 18;
+
+	size_t nthreads = threadCount > 0 ? threadCount : std::thread::hardware_concurrency();
+	if (nthreads > n1)
+		nthreads = n1;
+	if (nthreads > n1 * n2 / minPerThread)
+		nthreads = n1 * n2 / minPerThread;
+
+	if (nthreads <= 1) {
+		distanceRows(x1, y1, 0, n1, x2, y2, n2, d);
+		return;
+	}
+
+	std::vector<std::thread> threads;
+	size_t rows = (n1 + nthreads - 1) / nthreads;
+	for (size_t begin = 0; begin < n1; begin += rows) {
+		size_t end = begin + rows < n1 ? begin + rows : n1;
+		threads.emplace_back(distanceRows, x1, y1, begin, end, x2, y2, n2, d);
+	}
+	for (size_t i = 0; i < threads.size(); ++i)
+		threads[i].join();
+}
+
+#ifdef GEO_BENCHMARK
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <chrono>
+#include <vector>
+
+// Reference haversine distance in long double
+static double referenceDistance(double x1, double y1, double x2, double y2)
+{
+	long double f = 0.01745329251994329576923690768489L;
+	long double sy = sinl((y2 - y1) * f / 2), sx = sinl((x2 - x1) * f / 2);
+	long double h = sy * sy + cosl(y1 * f) * cosl(y2 * f) * sx * sx;
+	return (double)(2 * 6378137.0L * atan2l(sqrtl(h), sqrtl(1 - h)));
+}
+
+// Checks the distance kernels and distance() against the reference at
+// several ranges, and times them.
+static void benchmarkDistance(const GeoKernels *kernels, const char **names, size_t nkernels)
+{
+	const size_t n = 1000000;
+	const double ranges[] = { 1.0, 100.0, 10000.0, 1000000.0, 20000000.0 };
+	std::vector<double> lon(n), lat(n), d(n), ref(n);
+	size_t i, k, r;
+
+	printf("distance error in meters, of distance() and the kernels\n");
+	for (r = 0; r < sizeof(ranges) / sizeof(ranges[0]); ++r) {
+		// pairs of points about ranges[r] apart
+		std::vector<double> lon2(n), lat2(n);
+		double deg = ranges[r] / 111319.49;
+		for (i = 0; i < n; ++i) {
+			lon[i] = -179.0 + 358.0 * ((i * 7919) % n) / n;
+			lat[i] = -80.0 + 160.0 * ((i * 104729) % n) / n;
+			double a = 6.283185307179586 * (i % 360) / 360;
+			lat2[i] = lat[i] + deg * sin(a) * (ranges[r] > 1e7 ? 0.3 : 1.0);
+			lon2[i] = lon[i] + deg * cos(a);
+			if (lon2[i] > 180.0)
+				lon2[i] -= 360.0;
+			if (lon2[i] < -180.0)
+				lon2[i] += 360.0;
+			ref[i] = referenceDistance(lon[i], lat[i], lon2[i], lat2[i]);
+		}
+
+		double maxErr = 0;
+		for (i = 0; i < n; ++i) {
+			double err = fabs(distance(lon[i], lat[i], lon2[i], lat2[i]) - ref[i]);
+			if (err > maxErr)
+				maxErr = err;
+		}
+		printf("  %9.0f m: distance() %.2e", ranges[r], maxErr);
+
+		for (k = 0; k < nkernels; ++k) {
+			if (kernels[k].distancePair == NULL)
+				continue;
+			kernels[k].distancePair(lon.data(), lat.data(), lon2.data(), lat2.data(), d.data(), n);
+			maxErr = 0;
+			for (i = 0; i < n; ++i) {
+				double err = fabs(d[i] - ref[i]);
+				if (err > maxErr)
+					maxErr = err;
+			}
+			printf(", %s %.2e", names[k], maxErr);
+		}
+		printf("\n");
+	}
+
+	clock_t start = clock();
+	double sum = 0;
+	for (i = 0; i < n; ++i)
+		sum += distance(lon[0], lat[0], lon[i], lat[i]);
+	double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("distance()      %8.3fs %6.1f Mpts/s (%g)\n", secs, n / secs / 1e6, sum);
+
+	for (k = 0; k < nkernels; ++k) {
+		if (kernels[k].distanceTo == NULL)
+			continue;
+		start = clock();
+		kernels[k].distanceTo(lon[0], lat[0], lon.data(), lat.data(), d.data(), n);
+		secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+		printf("%-15s %8.3fs %6.1f Mpts/s\n", names[k], secs, n / secs / 1e6);
+	}
+
+	start = clock();
+	pathDistances(lon.data(), lat.data(), d.data(), n);
+	secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("pathDistances() %8.3fs %6.1f Mpts/s\n", secs, n / secs / 1e6);
+
+	// 2000 x 20000 matrix, clock() counts all threads, so the wall time
+	const size_t n1 = 2000, n2 = 20000;
+	std::vector<double> m(n1 * n2);
+	for (int threads = 1; threads >= 0; --threads) {
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		distanceMatrix(lon.data(), lat.data(), n1, lon.data() + n1, lat.data() + n1, n2, m.data(), threads);
+		secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		printf("distanceMatrix(%d threads) %8.3fs %6.1f Mpts/s\n", threads, secs, n1 * n2 / secs / 1e6);
+	}
+}
+
+// Checks the kernels against project() rounded as the casting does,
+// on a grid to +-85 degrees, and times them.
+int main()
+{
+	const size_t n = 4000000;
+	std::vector<double> lon(n), lat(n);
+	std::vector<int32_t> ex(n), ey(n), x(n), y(n);
+	Mercator mer(Mercator::WGS84);
+	clock_t start;
+	size_t i, k;
+
+	for (i = 0; i < n; ++i) {
+		lon[i] = -180.0 + 360.0 * (i % 2000) / 2000 + 1e-7 * (i % 7);
+		lat[i] = -85.0 + 170.0 * (i / 2000) / 2000 + 1e-7 * (i % 11);
+	}
+
+	start = clock();
+	for (i = 0; i < n; ++i) {
+		double px, py;
+		mer.project(lon[i], lat[i], &px, &py);
+		px += (signbit(px) ? -0.05 : 0.05);
+		py += (signbit(py) ? -0.05 : 0.05);
+		ex[i] = static_cast<int32_t>(px * 10.0);
+		ey[i] = static_cast<int32_t>(py * 10.0);
+	}
+	printf("project  %8.3fs\n", (double)(clock() - start) / CLOCKS_PER_SEC);
+
+	// The constants of WGS84 at the standard latitude 0, as initConst()
+	const double a = 6378137.0, b = 6356752.3142;
+	MercatorConst c;
+	c.e = sqrt(1 - (b / a) * (b / a));
+	c.k = (a * a / b) / sqrt(1 + ((a / b) * (a / b) - 1));
+	c.origLon = 0.0;
+
+	GeoKernels avx2 = { NULL, NULL, NULL, NULL };
+	geoAvx2Kernels(&avx2);
+
+	struct {
+		const char *name;
+		GeoKernels kernels;
+	} kernels[] = {
+		{ "scalar", { mercatorProjectDm<MercatorScalarOps>, mercatorAprojectDm<MercatorScalarOps>, 
+				sphereDistanceTo<MercatorScalarOps>, sphereDistancePair<MercatorScalarOps> } },
+#ifdef MERCATOR_SSE2
+		{ "sse2", { mercatorProjectDm<MercatorSse2Ops>, mercatorAprojectDm<MercatorSse2Ops>, 
+				sphereDistanceTo<MercatorSse2Ops>, sphereDistancePair<MercatorSse2Ops> } },
+		{ "avx2", avx2 },
+#endif
+	};
+
+	for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+		if (kernels[k].kernels.project == NULL)
+			continue;
+
+		start = clock();
+		kernels[k].kernels.project(c, lon.data(), lat.data(), x.data(), y.data(), n);
+		double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		size_t ndiff = 0;
+		long maxDiff = 0;
+		for (i = 0; i < n; ++i) {
+			long d = labs((long)x[i] - ex[i]) + labs((long)y[i] - ey[i]);
+			if (d != 0)
+				++ndiff;
+			if (d > maxDiff)
+				maxDiff = d;
+		}
+		printf("%-8s %8.3fs %lu of %lu differ, max %ld dm\n", kernels[k].name, secs, 
+				(unsigned long)ndiff, (unsigned long)n, maxDiff);
+	}
+
+	// The inverse, of the projected grid
+	std::vector<double> elon(n), elat(n), ilon(n), ilat(n);
+	start = clock();
+	for (i = 0; i < n; ++i)
+		mer.aproject(ex[i] / 10.0, ey[i] / 10.0, &elon[i], &elat[i]);
+	double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+	printf("aproject %8.3fs %6.1f Mpts/s\n", secs, n / secs / 1e6);
+
+	for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+		if (kernels[k].kernels.aproject == NULL)
+			continue;
+
+		start = clock();
+		kernels[k].kernels.aproject(c, ex.data(), ey.data(), ilon.data(), ilat.data(), n);
+		secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+		double maxErr = 0;
+		for (i = 0; i < n; ++i) {
+			double dy = (ilat[i] - elat[i]) * 111319.49;
+			double dx = (ilon[i] - elon[i]) * 111319.49 * cos(DEGREE2RAD(elat[i]));
+			double err = sqrt(dx * dx + dy * dy);
+			if (err > maxErr)
+				maxErr = err;
+		}
+		printf("%-8s %8.3fs %6.1f Mpts/s, max error %.2e m\n", kernels[k].name, secs, n / secs / 1e6, maxErr);
+	}
+
+	GeoKernels ks[sizeof(kernels) / sizeof(kernels[0])];
+	const char *names[sizeof(kernels) / sizeof(kernels[0])];
+	for (k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+		ks[k] = kernels[k].kernels;
+		names[k] = kernels[k].name;
+	}
+	benchmarkDistance(ks, names, k);
+
+	return 0;
+}
+#endif
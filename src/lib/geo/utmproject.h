@@ -1,6 +1,9 @@
 #ifndef UTMPROJECT_H
 #define UTMPROJECT_H
 
+#include <stddef.h>
+#include <stdint.h>
+
 #include "geo_gloabal.h"
 
 namespace Geo {
@@ -51,9 +54,21 @@ public:
     // cartesian coordinate (meter).
     void project(double lon, double lat, double * x, double * y) const;
 
+    // Projects n points from geodetic coordinates (decimal degree) to
+    // cartesian coordinates in decimeters, rounded half away from zero.
+    // The points are projected by vectorized kernels where the CPU has
+    // them, the results are the ones of project() but for points within
+    // about 1e-8 meters of a rounding boundary.
+    void projectDm(const double * lon, const double * lat, int32_t * x, int32_t * y, size_t n) const;
+
     // Do anti-projection from cartesian coordinate (meter) to
     // geodetic coordinate (decimal degree).
     void aproject(double x, double y, double * lon, double * lat) const;
+
+    // Anti-projects n points from cartesian coordinates in decimeters to
+    // geodetic coordinates (decimal degree), by vectorized kernels where
+    // the CPU has them. The error is below a millimeter.
+    void aprojectDm(const int32_t * x, const int32_t * y, double * lon, double * lat, size_t n) const;
 };
 
 // Mercator inline functions
@@ -68,6 +83,24 @@ inline Mercator::DatumType Mercator::datumType() const
 // Returns spherical distance meters between two points.
 // The two points represented by geodetic coordinate (decimal degree).
 GEO_EXPORT double distance(double x1, double y1, double x2, double y2);
+
+// Batch spherical distances in meters, on the sphere of distance(), by the
+// haversine formula, which keeps its accuracy at short ranges. Without SSE2
+// they are computed by distance() instead. The points are geodetic
+// coordinates (decimal degree) of longitudes in [-180, 180].
+
+// Distances from (x0, y0) to the n points, to d[0 .. n-1].
+GEO_EXPORT void distances(double x0, double y0, const double * x, const double * y, double * d, size_t n);
+
+// Distances between the consecutive vertices of a polyline of n points,
+// d[i] is the one of vertices i and i+1, to d[0 .. n-2].
+GEO_EXPORT void pathDistances(const double * x, const double * y, double * d, size_t n);
+
+// Distance matrix of n1 points to n2 points, d[i * n2 + j] is the distance
+// of point i of the first set to point j of the second. Large matrices are
+// split by rows to threadCount threads, 0 means the number of CPU cores.
+GEO_EXPORT void distanceMatrix(const double * x1, const double * y1, size_t n1, const double * x2,
+                               const double * y2, size_t n2, double * d, int threadCount = 1);
 }; // namespace Geo
 
 #endif
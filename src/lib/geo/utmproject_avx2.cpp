@@ -0,0 +1,98 @@
+// AVX2 kernels of the batch projection and distance. This file is built with
+// AVX2 enabled, see CMakeLists.txt, and only called if the CPU has it.
+
+#include "utmproject_simd.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace Geo;
+
+#ifdef __AVX2__
+
+struct MercatorAvx2Ops
+{
+	typedef __m256d V;
+	enum { N = 4 };
+
+	static V set1(double a) { return _mm256_set1_pd(a); }
+	static V load(const double *p) { return _mm256_loadu_pd(p); }
+	static V loadInt32(const int32_t *p) { return _mm256_cvtepi32_pd(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))); }
+	static void store(double *p, V a) { _mm256_storeu_pd(p, a); }
+	static V add(V a, V b) { return _mm256_add_pd(a, b); }
+	static V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+	static V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+	static V div(V a, V b) { return _mm256_div_pd(a, b); }
+	static V sqrt(V a) { return _mm256_sqrt_pd(a); }
+	static V andv(V a, V b) { return _mm256_and_pd(a, b); }
+	static V orv(V a, V b) { return _mm256_or_pd(a, b); }
+	static V andnot(V a, V b) { return _mm256_andnot_pd(a, b); }
+	static V cmpgt(V a, V b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+
+	static V split(V a, V *exponent)
+	{
+		__m256i u = _mm256_castpd_si256(a);
+		__m256i eb = _mm256_or_si256(_mm256_srli_epi64(u, 52), 
+				_mm256_set1_epi64x(0x4330000000000000LL));
+		*exponent = _mm256_sub_pd(_mm256_castsi256_pd(eb), 
+				_mm256_set1_pd(4503599627370496.0 + 1023.0));
+		__m256i m = _mm256_or_si256(_mm256_and_si256(u, _mm256_set1_epi64x(0x000FFFFFFFFFFFFFLL)), 
+				_mm256_set1_epi64x(0x3FF0000000000000LL));
+		return _mm256_castsi256_pd(m);
+	}
+
+	static V pow2n(V n)
+	{
+		__m256i u = _mm256_castpd_si256(_mm256_add_pd(n, _mm256_set1_pd(6755399441055744.0)));
+		u = _mm256_sub_epi64(u, _mm256_set1_epi64x(0x4338000000000000LL - 1023));
+		return _mm256_castsi256_pd(_mm256_slli_epi64(u, 52));
+	}
+
+	static void storeInt32(int32_t *p, V a)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_cvttpd_epi32(a));
+	}
+};
+
+static void projectDmAvx2(const MercatorConst &c, const double *lon, const double *lat, 
+		int32_t *x, int32_t *y, size_t n)
+{
+	mercatorProjectDm<MercatorAvx2Ops>(c, lon, lat, x, y, n);
+}
+
+static void aprojectDmAvx2(const MercatorConst &c, const int32_t *x, const int32_t *y, 
+		double *lon, double *lat, size_t n)
+{
+	mercatorAprojectDm<MercatorAvx2Ops>(c, x, y, lon, lat, n);
+}
+
+static void distanceToAvx2(double lon0, double lat0, const double *lon, const double *lat, 
+		double *d, size_t n)
+{
+	sphereDistanceTo<MercatorAvx2Ops>(lon0, lat0, lon, lat, d, n);
+}
+
+static void distancePairAvx2(const double *lon1, const double *lat1, 
+		const double *lon2, const double *lat2, double *d, size_t n)
+{
+	sphereDistancePair<MercatorAvx2Ops>(lon1, lat1, lon2, lat2, d, n);
+}
+
+bool Geo::geoAvx2Kernels(GeoKernels *kernels)
+{
+	kernels->project = projectDmAvx2;
+	kernels->aproject = aprojectDmAvx2;
+	kernels->distanceTo = distanceToAvx2;
+	kernels->distancePair = distancePairAvx2;
+	return true;
+}
+
+#else
+
+bool Geo::geoAvx2Kernels(GeoKernels *)
+{
+	return false;
+}
+
+#endif
@@ -0,0 +1,530 @@
+#ifndef UTMPROJECT_SIMD_H
+#define UTMPROJECT_SIMD_H
+
+// Batch kernels of the Mercator projection and the spherical distance,
+// internal to the geo library.
+//
+// The projection is rewritten as
+//   y = K * (atanh(sin(lat)) - e * atanh(e * sin(lat)))
+// which is the same as the log(tan() * pow()) form of Mercator::project(),
+// and only needs sine and logarithm. Both are evaluated by polynomials on
+// the lanes of a vector type, the kernel is written once for the ops of
+// each instruction set.
+//
+// The inverse goes through the conformal latitude, chi = atan(sinh(y/K)),
+// and the series of the latitude in sin(2 chi) .. sin(8 chi) to e^8, whose
+// error is below 1e-10 radian, i.e. below a millimeter.
+//
+// The distance is the haversine one on the sphere of Geo::distance(),
+// 2R * atan(sqrt(h / (1 - h))), which is accurate at short ranges, where
+// the acos() of the cosine law loses the most.
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MERCATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace Geo {
+
+// Constants of a Mercator projection used by the kernel.
+struct MercatorConst
+{
+    double k;       // Mercator::_K
+    double origLon; // radian value of original longitude
+    double e;       // Mercator::_E1
+};
+
+typedef void (*MercatorKernel)(const MercatorConst & c, const double * lon, const double * lat,
+                               int32_t * x, int32_t * y, size_t n);
+typedef void (*MercatorInverseKernel)(const MercatorConst & c, const int32_t * x, const int32_t * y,
+                                      double * lon, double * lat, size_t n);
+
+// Distances from (lon0, lat0) to n points
+typedef void (*DistanceToKernel)(double lon0, double lat0, const double * lon, const double * lat,
+                                 double * d, size_t n);
+// Distances between the points of the same index in two arrays
+typedef void (*DistancePairKernel)(const double * lon1, const double * lat1, const double * lon2,
+                                   const double * lat2, double * d, size_t n);
+
+struct GeoKernels
+{
+    MercatorKernel        project;
+    MercatorInverseKernel aproject;
+    DistanceToKernel      distanceTo;
+    DistancePairKernel    distancePair;
+};
+
+// Gets the AVX2 kernels, returns false if the library is built without them.
+bool geoAvx2Kernels(GeoKernels * kernels);
+
+// Ops of plain doubles
+struct MercatorScalarOps
+{
+    typedef double V;
+    enum
+    {
+        N = 1
+    };
+
+    static V set1(double a) { return a; }
+    static V load(const double * p) { return *p; }
+    static V loadInt32(const int32_t * p) { return *p; }
+    static void store(double * p, V a) { *p = a; }
+    static V add(V a, V b) { return a + b; }
+    static V sub(V a, V b) { return a - b; }
+    static V mul(V a, V b) { return a * b; }
+    static V div(V a, V b) { return a / b; }
+    static V sqrt(V a) { return ::sqrt(a); }
+
+    static uint64_t bits(V a)
+    {
+        uint64_t u;
+        memcpy(&u, &a, sizeof(u));
+        return u;
+    }
+    static V fromBits(uint64_t u)
+    {
+        V a;
+        memcpy(&a, &u, sizeof(a));
+        return a;
+    }
+
+    static V andv(V a, V b) { return fromBits(bits(a) & bits(b)); }
+    static V orv(V a, V b) { return fromBits(bits(a) | bits(b)); }
+    static V andnot(V a, V b) { return fromBits(~bits(a) & bits(b)); }
+    static V cmpgt(V a, V b) { return fromBits(a > b ? ~0ULL : 0); }
+
+    // Splits a positive normal number to the mantissa in [1, 2)
+    // and the unbiased exponent.
+    static V split(V a, V * exponent)
+    {
+        uint64_t u = bits(a);
+        *exponent = static_cast<double>(static_cast<int>(u >> 52) - 1023);
+        return fromBits((u & 0x000FFFFFFFFFFFFFULL) | 0x3FF0000000000000ULL);
+    }
+
+    // Returns 2^n of the integral n.
+    static V pow2n(V n) { return fromBits(static_cast<uint64_t>(static_cast<int64_t>(n) + 1023) << 52); }
+
+    static void storeInt32(int32_t * p, V a) { *p = static_cast<int32_t>(a); }
+};
+
+#ifdef MERCATOR_SSE2
+// Ops of SSE2, the baseline of x86-64
+struct MercatorSse2Ops
+{
+    typedef __m128d V;
+    enum
+    {
+        N = 2
+    };
+
+    static V set1(double a) { return _mm_set1_pd(a); }
+    static V load(const double * p) { return _mm_loadu_pd(p); }
+    static V loadInt32(const int32_t * p) { return _mm_cvtepi32_pd(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))); }
+    static void store(double * p, V a) { _mm_storeu_pd(p, a); }
+    static V add(V a, V b) { return _mm_add_pd(a, b); }
+    static V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    static V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    static V div(V a, V b) { return _mm_div_pd(a, b); }
+    static V sqrt(V a) { return _mm_sqrt_pd(a); }
+    static V andv(V a, V b) { return _mm_and_pd(a, b); }
+    static V orv(V a, V b) { return _mm_or_pd(a, b); }
+    static V andnot(V a, V b) { return _mm_andnot_pd(a, b); }
+    static V cmpgt(V a, V b) { return _mm_cmpgt_pd(a, b); }
+
+    static V split(V a, V * exponent)
+    {
+        // The biased exponent is put in the mantissa of 2^52 to convert it.
+        __m128i u = _mm_castpd_si128(a);
+        __m128i eb = _mm_or_si128(_mm_srli_epi64(u, 52), _mm_set1_epi64x(0x4330000000000000LL));
+        *exponent = _mm_sub_pd(_mm_castsi128_pd(eb), _mm_set1_pd(4503599627370496.0 + 1023.0));
+        __m128i m = _mm_or_si128(_mm_and_si128(u, _mm_set1_epi64x(0x000FFFFFFFFFFFFFLL)),
+                                 _mm_set1_epi64x(0x3FF0000000000000LL));
+        return _mm_castsi128_pd(m);
+    }
+
+    static V pow2n(V n)
+    {
+        // The integer is taken from the mantissa of n + 1.5 * 2^52.
+        __m128i u = _mm_castpd_si128(_mm_add_pd(n, _mm_set1_pd(6755399441055744.0)));
+        u = _mm_sub_epi64(u, _mm_set1_epi64x(0x4338000000000000LL - 1023));
+        return _mm_castsi128_pd(_mm_slli_epi64(u, 52));
+    }
+
+    static void storeInt32(int32_t * p, V a) { _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_cvttpd_epi32(a)); }
+};
+#endif
+
+template <class Ops>
+inline typename Ops::V mercatorSelect(typename Ops::V mask, typename Ops::V a, typename Ops::V b)
+{
+    return Ops::orv(Ops::andv(mask, a), Ops::andnot(mask, b));
+}
+
+// Natural logarithm of positive normal numbers.
+template <class Ops>
+inline typename Ops::V mercatorLog(typename Ops::V a)
+{
+    typedef typename Ops::V V;
+
+    V e;
+    V m = Ops::split(a, &e);
+
+    // Takes the mantissa to [sqrt(1/2), sqrt(2)), so |f| < 0.172 below.
+    V big = Ops::cmpgt(m, Ops::set1(1.41421356237309504880));
+    m = mercatorSelect<Ops>(big, Ops::mul(m, Ops::set1(0.5)), m);
+    e = Ops::add(e, Ops::andv(big, Ops::set1(1.0)));
+
+    // log(m) = 2 * atanh(f) = 2 * (f + f^3/3 + f^5/5 + ...), f = (m-1)/(m+1)
+    V f = Ops::div(Ops::sub(m, Ops::set1(1.0)), Ops::add(m, Ops::set1(1.0)));
+    V f2 = Ops::mul(f, f);
+    V p = Ops::set1(1.0 / 23);
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 21));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 19));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 17));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 15));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 13));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 11));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 9));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 7));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 5));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0 / 3));
+    p = Ops::add(Ops::mul(p, f2), Ops::set1(1.0));
+    V lm = Ops::mul(Ops::add(f, f), p);
+
+    // ln(2) split to a high part exact in multiples of the exponent
+    return Ops::add(Ops::mul(e, Ops::set1(6.93147180369123816490e-01)),
+                    Ops::add(lm, Ops::mul(e, Ops::set1(1.90821492927058770002e-10))));
+}
+
+// Sine of [-pi/2, pi/2], by the Taylor series to x^25.
+template <class Ops>
+inline typename Ops::V mercatorSin(typename Ops::V x)
+{
+    typedef typename Ops::V V;
+
+    V x2 = Ops::mul(x, x);
+    V p = Ops::set1(6.446950284384473e-26);                  //  1/25!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(-3.868170170630684e-23)); // -1/23!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(1.9572941063391263e-20)); //  1/21!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(-8.220635246624329e-18)); // -1/19!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(2.8114572543455206e-15)); //  1/17!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(-7.647163731819816e-13)); // -1/15!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(1.6059043836821613e-10)); //  1/13!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(-2.505210838544172e-08)); // -1/11!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(2.7557319223985893e-06)); //  1/9!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(-1.984126984126984e-04)); // -1/7!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(8.333333333333333e-03));  //  1/5!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(-1.6666666666666666e-01)); // -1/3!
+    p = Ops::add(Ops::mul(p, x2), Ops::set1(1.0));
+    return Ops::mul(x, p);
+}
+
+// Exponential of [-700, 700].
+template <class Ops>
+inline typename Ops::V mercatorExp(typename Ops::V a)
+{
+    typedef typename Ops::V V;
+
+    // a = n * ln(2) + r, |r| <= ln(2) / 2, n rounded by the 1.5 * 2^52 trick
+    const V magic = Ops::set1(6755399441055744.0);
+    V n = Ops::sub(Ops::add(Ops::mul(a, Ops::set1(1.44269504088896340736)), magic), magic);
+    V r = Ops::sub(Ops::sub(a, Ops::mul(n, Ops::set1(6.93147180369123816490e-01))),
+                   Ops::mul(n, Ops::set1(1.90821492927058770002e-10)));
+
+    // Taylor series to r^14
+    V p = Ops::set1(1.0 / 87178291200.0);
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 6227020800.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 479001600.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 39916800.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 3628800.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 362880.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 40320.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 5040.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 720.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 120.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 24.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0 / 6.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(0.5));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0));
+    p = Ops::add(Ops::mul(p, r), Ops::set1(1.0));
+    return Ops::mul(p, Ops::pow2n(n));
+}
+
+// Arc tangent.
+template <class Ops>
+inline typename Ops::V mercatorAtan(typename Ops::V a)
+{
+    typedef typename Ops::V V;
+
+    const V one = Ops::set1(1.0);
+    V sign = Ops::andv(a, Ops::set1(-0.0));
+    V t = Ops::andnot(Ops::set1(-0.0), a);
+
+    // atan(t) = pi/2 - atan(1/t), and atan(t) = pi/4 + atan((t-1)/(t+1)),
+    // takes t to [-tan(pi/8), tan(pi/8)]
+    V inv = Ops::cmpgt(t, one);
+    t = mercatorSelect<Ops>(inv, Ops::div(one, t), t);
+    V mid = Ops::cmpgt(t, Ops::set1(0.41421356237309504880));
+    t = mercatorSelect<Ops>(mid, Ops::div(Ops::sub(t, one), Ops::add(t, one)), t);
+
+    // Taylor series to t^43
+    V t2 = Ops::mul(t, t);
+    V p = Ops::set1(-1.0 / 43);
+    for (int k = 20; k >= 0; --k)
+        p = Ops::add(Ops::mul(p, t2), Ops::set1((k % 2 ? -1.0 : 1.0) / (2 * k + 1)));
+    V r = Ops::mul(t, p);
+
+    r = Ops::add(r, Ops::andv(mid, Ops::set1(0.78539816339744830962)));
+    r = mercatorSelect<Ops>(inv, Ops::sub(Ops::set1(1.57079632679489661923), r), r);
+    return Ops::orv(r, sign);
+}
+
+// Rounds meters to decimeters half away from zero, as the casting does.
+template <class Ops>
+inline typename Ops::V mercatorToDm(typename Ops::V a)
+{
+    typename Ops::V sign = Ops::andv(a, Ops::set1(-0.0));
+    return Ops::mul(Ops::add(a, Ops::orv(sign, Ops::set1(0.05))), Ops::set1(10.0));
+}
+
+template <class Ops>
+inline void mercatorProjectBlock(const MercatorConst & c, const double * lon, const double * lat,
+                                 int32_t * x, int32_t * y)
+{
+    typedef typename Ops::V V;
+
+    const V radFactor = Ops::set1(0.01745329251994329509);
+    const V one = Ops::set1(1.0);
+    const V half = Ops::set1(0.5);
+    const V k = Ops::set1(c.k);
+    const V e = Ops::set1(c.e);
+
+    V rlon = Ops::mul(Ops::load(lon), radFactor);
+    V mx = Ops::mul(k, Ops::sub(rlon, Ops::set1(c.origLon)));
+
+    V s = mercatorSin<Ops>(Ops::mul(Ops::load(lat), radFactor));
+    V es = Ops::mul(e, s);
+    V t0 = mercatorLog<Ops>(Ops::div(Ops::add(one, s), Ops::sub(one, s)));
+    V t1 = mercatorLog<Ops>(Ops::div(Ops::add(one, es), Ops::sub(one, es)));
+    V my = Ops::mul(k, Ops::mul(half, Ops::sub(t0, Ops::mul(e, t1))));
+
+    Ops::storeInt32(x, mercatorToDm<Ops>(mx));
+    Ops::storeInt32(y, mercatorToDm<Ops>(my));
+}
+
+// Projects n points. The last block is padded to the vector width, so a
+// point is projected by the same instructions whatever n is.
+template <class Ops>
+void mercatorProjectDm(const MercatorConst & c, const double * lon, const double * lat,
+                       int32_t * x, int32_t * y, size_t n)
+{
+    size_t i = 0;
+    for (; i + Ops::N <= n; i += Ops::N)
+        mercatorProjectBlock<Ops>(c, lon + i, lat + i, x + i, y + i);
+
+    if (i < n) {
+        double plon[Ops::N], plat[Ops::N];
+        int32_t px[Ops::N], py[Ops::N];
+        size_t j;
+        for (j = 0; j < static_cast<size_t>(Ops::N); ++j) {
+            plon[j] = i + j < n ? lon[i + j] : 0.0;
+            plat[j] = i + j < n ? lat[i + j] : 0.0;
+        }
+        mercatorProjectBlock<Ops>(c, plon, plat, px, py);
+        for (j = 0; i + j < n; ++j) {
+            x[i + j] = px[j];
+            y[i + j] = py[j];
+        }
+    }
+}
+
+// Coefficients of the latitude in sin(2 chi) .. sin(8 chi)
+template <class Ops>
+struct MercatorInverseSeries
+{
+    typename Ops::V a2, a4, a6, a8;
+
+    MercatorInverseSeries(double e)
+    {
+        double e2 = e * e, e4 = e2 * e2, e6 = e4 * e2, e8 = e4 * e4;
+        a2 = Ops::set1(e2 / 2 + 5 * e4 / 24 + e6 / 12 + 13 * e8 / 360);
+        a4 = Ops::set1(7 * e4 / 48 + 29 * e6 / 240 + 811 * e8 / 11520);
+        a6 = Ops::set1(7 * e6 / 120 + 81 * e8 / 1120);
+        a8 = Ops::set1(4279 * e8 / 161280);
+    }
+};
+
+template <class Ops>
+inline void mercatorAprojectBlock(const MercatorConst & c, const MercatorInverseSeries<Ops> & ser,
+                                  const int32_t * x, const int32_t * y, double * lon, double * lat)
+{
+    typedef typename Ops::V V;
+
+    const V degFactor = Ops::set1(57.29577951308232311);
+    const V one = Ops::set1(1.0);
+    const V half = Ops::set1(0.5);
+    const V two = Ops::set1(2.0);
+    const V invK = Ops::set1(1.0 / (c.k * 10.0)); // of decimeters
+
+    V rlon = Ops::add(Ops::mul(Ops::loadInt32(x), invK), Ops::set1(c.origLon));
+    Ops::store(lon, Ops::mul(rlon, degFactor));
+
+    // sin(chi) = tanh(q), cos(chi) = 1 / cosh(q), chi = atan(sinh(q))
+    V ex = mercatorExp<Ops>(Ops::mul(Ops::loadInt32(y), invK));
+    V rex = Ops::div(one, ex);
+    V sh = Ops::mul(half, Ops::sub(ex, rex));
+    V ch = Ops::mul(half, Ops::add(ex, rex));
+    V sinChi = Ops::div(sh, ch);
+    V cosChi = Ops::div(one, ch);
+    V chi = mercatorAtan<Ops>(sh);
+
+    V s2 = Ops::mul(two, Ops::mul(sinChi, cosChi));
+    V c2 = Ops::sub(Ops::mul(cosChi, cosChi), Ops::mul(sinChi, sinChi));
+    V s4 = Ops::mul(two, Ops::mul(s2, c2));
+    V c4 = Ops::sub(Ops::mul(c2, c2), Ops::mul(s2, s2));
+    V s6 = Ops::add(Ops::mul(s4, c2), Ops::mul(c4, s2));
+    V s8 = Ops::mul(two, Ops::mul(s4, c4));
+
+    V rlat = Ops::add(Ops::add(Ops::mul(ser.a8, s8), Ops::mul(ser.a6, s6)),
+                      Ops::add(Ops::mul(ser.a4, s4), Ops::mul(ser.a2, s2)));
+    Ops::store(lat, Ops::mul(Ops::add(chi, rlat), degFactor));
+}
+
+// Unprojects n points of decimeters, the last block padded as above.
+template <class Ops>
+void mercatorAprojectDm(const MercatorConst & c, const int32_t * x, const int32_t * y,
+                        double * lon, double * lat, size_t n)
+{
+    MercatorInverseSeries<Ops> ser(c.e);
+
+    size_t i = 0;
+    for (; i + Ops::N <= n; i += Ops::N)
+        mercatorAprojectBlock<Ops>(c, ser, x + i, y + i, lon + i, lat + i);
+
+    if (i < n) {
+        int32_t px[Ops::N], py[Ops::N];
+        double plon[Ops::N], plat[Ops::N];
+        size_t j;
+        for (j = 0; j < static_cast<size_t>(Ops::N); ++j) {
+            px[j] = i + j < n ? x[i + j] : 0;
+            py[j] = i + j < n ? y[i + j] : 0;
+        }
+        mercatorAprojectBlock<Ops>(c, ser, px, py, plon, plat);
+        for (j = 0; i + j < n; ++j) {
+            lon[i + j] = plon[j];
+            lat[i + j] = plat[j];
+        }
+    }
+}
+
+// Squared sine of [-pi, pi]
+template <class Ops>
+inline typename Ops::V sphereSin2(typename Ops::V a)
+{
+    typedef typename Ops::V V;
+
+    const V pi_2 = Ops::set1(1.57079632679489661923);
+    V t = Ops::andnot(Ops::set1(-0.0), a);
+    t = mercatorSelect<Ops>(Ops::cmpgt(t, pi_2), Ops::sub(Ops::set1(3.14159265358979323846), t), t);
+    V s = mercatorSin<Ops>(t);
+    return Ops::mul(s, s);
+}
+
+// Cosine of the latitude of [-pi/2, pi/2]
+template <class Ops>
+inline typename Ops::V sphereCosLat(typename Ops::V lat)
+{
+    return mercatorSin<Ops>(Ops::sub(Ops::set1(1.57079632679489661923), Ops::andnot(Ops::set1(-0.0), lat)));
+}
+
+// Haversine distance of points in radians, the cosines of the latitudes given
+template <class Ops>
+inline typename Ops::V sphereDistance(typename Ops::V lon1, typename Ops::V lat1, typename Ops::V cos1,
+                                      typename Ops::V lon2, typename Ops::V lat2)
+{
+    typedef typename Ops::V V;
+
+    const V half = Ops::set1(0.5);
+    V h = Ops::add(sphereSin2<Ops>(Ops::mul(Ops::sub(lat2, lat1), half)),
+                   Ops::mul(Ops::mul(cos1, sphereCosLat<Ops>(lat2)),
+                            sphereSin2<Ops>(Ops::mul(Ops::sub(lon2, lon1), half))));
+    V one = Ops::set1(1.0);
+    h = mercatorSelect<Ops>(Ops::cmpgt(h, one), one, h);
+    V a = mercatorAtan<Ops>(Ops::div(Ops::sqrt(h), Ops::sqrt(Ops::sub(one, h))));
+    return Ops::mul(a, Ops::set1(2 * 6378137.0));
+}
+
+template <class Ops>
+void sphereDistanceTo(double lon0, double lat0, const double * lon, const double * lat, double * d, size_t n)
+{
+    typedef typename Ops::V V;
+
+    const V radFactor = Ops::set1(0.01745329251994329509);
+    V lon1 = Ops::set1(lon0 * 0.01745329251994329509);
+    V lat1 = Ops::set1(lat0 * 0.01745329251994329509);
+    V cos1 = sphereCosLat<Ops>(lat1);
+
+    size_t i = 0;
+    for (; i + Ops::N <= n; i += Ops::N)
+        Ops::store(d + i, sphereDistance<Ops>(lon1, lat1, cos1, Ops::mul(Ops::load(lon + i), radFactor),
+                                              Ops::mul(Ops::load(lat + i), radFactor)));
+
+    if (i < n) {
+        double plon[Ops::N], plat[Ops::N], pd[Ops::N];
+        size_t j;
+        for (j = 0; j < static_cast<size_t>(Ops::N); ++j) {
+            plon[j] = i + j < n ? lon[i + j] : lon0;
+            plat[j] = i + j < n ? lat[i + j] : lat0;
+        }
+        Ops::store(pd, sphereDistance<Ops>(lon1, lat1, cos1, Ops::mul(Ops::load(plon), radFactor),
+                                           Ops::mul(Ops::load(plat), radFactor)));
+        for (j = 0; i + j < n; ++j)
+            d[i + j] = pd[j];
+    }
+}
+
+template <class Ops>
+inline typename Ops::V sphereDistancePairBlock(const double * lon1, const double * lat1, const double * lon2,
+                                               const double * lat2)
+{
+    typedef typename Ops::V V;
+
+    const V radFactor = Ops::set1(0.01745329251994329509);
+    V rlat1 = Ops::mul(Ops::load(lat1), radFactor);
+    return sphereDistance<Ops>(Ops::mul(Ops::load(lon1), radFactor), rlat1, sphereCosLat<Ops>(rlat1),
+                               Ops::mul(Ops::load(lon2), radFactor), Ops::mul(Ops::load(lat2), radFactor));
+}
+
+template <class Ops>
+void sphereDistancePair(const double * lon1, const double * lat1, const double * lon2, const double * lat2,
+                        double * d, size_t n)
+{
+    size_t i = 0;
+    for (; i + Ops::N <= n; i += Ops::N)
+        Ops::store(d + i, sphereDistancePairBlock<Ops>(lon1 + i, lat1 + i, lon2 + i, lat2 + i));
+
+    if (i < n) {
+        double p[4][Ops::N], pd[Ops::N];
+        size_t j;
+        for (j = 0; j < static_cast<size_t>(Ops::N); ++j) {
+            p[0][j] = i + j < n ? lon1[i + j] : 0.0;
+            p[1][j] = i + j < n ? lat1[i + j] : 0.0;
+            p[2][j] = i + j < n ? lon2[i + j] : 0.0;
+            p[3][j] = i + j < n ? lat2[i + j] : 0.0;
+        }
+        Ops::store(pd, sphereDistancePairBlock<Ops>(p[0], p[1], p[2], p[3]));
+        for (j = 0; i + j < n; ++j)
+            d[i + j] = pd[j];
+    }
+}
+
+} // namespace Geo
+
+#endif
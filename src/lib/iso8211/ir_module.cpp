@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <new>
+
+#include "../geo/R-tree.h"
+
+#include "ir_module.h"
+
+using namespace std;
+
+// Returns the leader of the data area at pos if it's valid, otherwise NULL.
+static const IR_DataAreaLeader *areaLeader(const MappedFile *map, size_t pos, char identifier)
+{
+	if (pos > map->size() || map->size() - pos < sizeof(IR_DataAreaLeader)) {
+		fprintf(stderr, "IR module: area '%c' missing\n", identifier);
+		return NULL;
+	}
+
+	const IR_DataAreaLeader *leader =
+			reinterpret_cast<const IR_DataAreaLeader *>(map->data() + pos);
+	if (leader->dataIdentifier != identifier
+			|| leader->areaLength > map->size() - pos
+			|| leader->dataOffset > leader->areaLength
+			|| leader->dataOffset < sizeof(IR_DataAreaLeader)) {
+		fprintf(stderr, "IR module: bad area '%c'\n", identifier);
+		return NULL;
+	}
+
+	return leader;
+}
+
+// Checks if count records of recSize at pos fit in total bytes.
+static bool fits(size_t pos, size_t count, size_t recSize, size_t total)
+{
+	return pos <= total && count <= (total - pos) / recSize;
+}
+
+// IrModule members
+
+void IrModule::init()
+{
+	_major = 0;
+	_minor = 0;
+	_param = NULL;
+	_ffpts = NULL;
+	_ffptCount = 0;
+	_fspts = NULL;
+	_fsptCount = 0;
+	_features = NULL;
+	_grCount = 0;
+	_mrCount = 0;
+	_lrCount = 0;
+	_spatials = NULL;
+	_spatialCount = 0;
+	_attrDir = NULL;
+	_attrCount = 0;
+	_attrData = NULL;
+	_attrDataSize = 0;
+	_coords = NULL;
+	_coordCount = 0;
+	_tree = NULL;
+	_treeBuf = NULL;
+}
+
+bool IrModule::readRecordArea(size_t pos, size_t *next)
+{
+	const IR_DataAreaLeader *leader = areaLeader(_map.getPtr(), pos, 'R');
+	if (leader == NULL)
+		return false;
+
+	size_t headerSize = sizeof(IR_DataAreaLeader) + sizeof(IR_DirEntry) * 6;
+	if (leader->dirSize < 6 || leader->dataOffset < headerSize) {
+		fprintf(stderr, "IR module: bad record area directory\n");
+		return false;
+	}
+
+	const IR_DirEntry *dir = reinterpret_cast<const IR_DirEntry *>(
+			_map->data() + pos + sizeof(IR_DataAreaLeader));
+	const char *contents = _map->data() + pos + leader->dataOffset;
+	size_t contentsSize = leader->areaLength - leader->dataOffset;
+
+	// The geo, meta and collection features are stored in order,
+	// from the start given by the geo directory.
+	size_t nfrs = 0;
+	bool featuresFit = true;
+	for (int k = 2; k <= 4 && featuresFit; ++k) {
+		featuresFit = fits(dir[k].pos, dir[k].size, sizeof(IR_FeatureRec), contentsSize)
+				&& dir[k].size <= SIZE_MAX - nfrs;
+		if (featuresFit)
+			nfrs += dir[k].size;
+	}
+	if (!featuresFit
+			|| !fits(dir[0].pos, dir[0].size, sizeof(IR_FFPtrRec), contentsSize)
+			|| !fits(dir[1].pos, dir[1].size, sizeof(IR_FSPtrRec), contentsSize)
+			|| !fits(dir[2].pos, nfrs, sizeof(IR_FeatureRec), contentsSize)
+			|| !fits(dir[5].pos, dir[5].size, sizeof(IR_SpatialRec), contentsSize)) {
+		fprintf(stderr, "IR module: record area overflow\n");
+		return false;
+	}
+
+	_ffpts = reinterpret_cast<const IR_FFPtrRec *>(contents + dir[0].pos);
+	_ffptCount = dir[0].size;
+	_fspts = reinterpret_cast<const IR_FSPtrRec *>(contents + dir[1].pos);
+	_fsptCount = dir[1].size;
+	_features = reinterpret_cast<const IR_FeatureRec *>(contents + dir[2].pos);
+	_grCount = dir[2].size;
+	_mrCount = dir[3].size;
+	_lrCount = dir[4].size;
+	_spatials = reinterpret_cast<const IR_SpatialRec *>(contents + dir[5].pos);
+	_spatialCount = dir[5].size;
+
+	*next = pos + leader->areaLength;
+	return true;
+}
+
+bool IrModule::readAttributeArea(size_t pos, size_t *next)
+{
+	const IR_DataAreaLeader *leader = areaLeader(_map.getPtr(), pos, 'A');
+	if (leader == NULL)
+		return false;
+
+	if (!fits(sizeof(IR_DataAreaLeader), leader->dirSize, sizeof(IR_DirEntry), leader->dataOffset)) {
+		fprintf(stderr, "IR module: bad attribute area directory\n");
+		return false;
+	}
+
+	_attrDir = reinterpret_cast<const IR_DirEntry *>(
+			_map->data() + pos + sizeof(IR_DataAreaLeader));
+	_attrCount = leader->dirSize;
+	_attrData = _map->data() + pos + leader->dataOffset;
+	_attrDataSize = leader->areaLength - leader->dataOffset;
+
+	*next = pos + leader->areaLength;
+	return true;
+}
+
+bool IrModule::readCoordinateArea(size_t pos, size_t *next)
+{
+	const IR_DataAreaLeader *leader = areaLeader(_map.getPtr(), pos, 'C');
+	if (leader == NULL)
+		return false;
+
+	_coords = reinterpret_cast<const Int32 *>(_map->data() + pos + leader->dataOffset);
+	_coordCount = (leader->areaLength - leader->dataOffset) / sizeof(Int32);
+
+	*next = pos + leader->areaLength;
+	return true;
+}
+
+bool IrModule::readRTreeArea(size_t pos, size_t *next)
+{
+	const IR_DataAreaLeader *leader = areaLeader(_map.getPtr(), pos, 'Q');
+	if (leader == NULL)
+		return false;
+
+	size_t imageSize = leader->areaLength - leader->dataOffset;
+	if (imageSize > 0) {
+		const char *image = _map->data() + pos + leader->dataOffset;
+
+		// The flat image is searched in place, so the tree costs nothing
+		// to load and its pages are shared. An image not aligned, or
+		// one of the older modules holding pointers, is copied first.
+		bool isFlat = leader->dataVersion >= IR_RTREE_FLAT;
+		if (!isFlat || reinterpret_cast<uintptr_t>(image) % RT_IMAGE_ALIGN != 0) {
+			_treeBuf = new (std::nothrow) char[imageSize];
+			if (_treeBuf == NULL) {
+				fprintf(stderr, "Lack of memory.\n");
+				exit(1);
+			}
+			memcpy(_treeBuf, image, imageSize);
+			image = _treeBuf;
+		}
+
+		_tree = isFlat ? rtreeAttachImage(image, imageSize) : rtreeRejointImage(_treeBuf, imageSize);
+		if (_tree == NULL) {
+			fprintf(stderr, "IR module: fail to load R-tree\n");
+			return false;
+		}
+	}
+
+	*next = pos + leader->areaLength;
+	return true;
+}
+
+const Int32 *IrModule::coords(const IR_SpatialRec &r) const
+{
+	if (r.coordPos > _coordCount || r.coordCount > _coordCount - r.coordPos) {
+		fprintf(stderr, "IR module: coordinates of %u out of range\n",
+				static_cast<unsigned>(r.rcid));
+		return NULL;
+	}
+	return _coords + r.coordPos;
+}
+
+IrModule::IrModule()
+	: AtomicRefBase()
+{
+	init();
+}
+
+IrModule::IrModule(string fileName)
+	: AtomicRefBase()
+{
+	init();
+	open(fileName);
+}
+
+IrModule::~IrModule()
+{
+	close();
+}
+
+bool IrModule::open(string fileName)
+{
+	if (isOpen())
+		close();
+
+	_map = new MappedFile;
+	if (!_map->open(fileName)) {
+		close();
+		return false;
+	}
+
+	size_t headerSize = 2 + sizeof(UInt16) * 2 + sizeof(IR_DatasetParam);
+	if (_map->size() < headerSize || _map->data()[0] != 'L' || _map->data()[1] != 'H') {
+		fprintf(stderr, "%s: seems not a IR module file.\n", fileName.c_str());
+		close();
+		return false;
+	}
+
+	UInt16 ma, mi;
+	memcpy(&ma, _map->data() + 2, sizeof(UInt16));
+	memcpy(&mi, _map->data() + 2 + sizeof(UInt16), sizeof(UInt16));
+	if (ma != IRV_MAJOR) {
+		fprintf(stderr, "%s: unsupported IR version %d.%d\n", fileName.c_str(), ma, mi);
+		close();
+		return false;
+	}
+
+	size_t pos = headerSize;
+	if (!readRecordArea(pos, &pos)
+			|| !readAttributeArea(pos, &pos)
+			|| !readCoordinateArea(pos, &pos)
+			|| !readRTreeArea(pos, &pos)) {
+		fprintf(stderr, "%s: bad IR module file.\n", fileName.c_str());
+		close();
+		return false;
+	}
+
+	_major = ma;
+	_minor = mi;
+	_param = reinterpret_cast<const IR_DatasetParam *>(_map->data() + 2 + sizeof(UInt16) * 2);
+
+	return true;
+}
+
+void IrModule::close()
+{
+	if (_tree != NULL)
+		rtreeDestroy(_tree);
+	if (_treeBuf != NULL)
+		delete[] _treeBuf;
+	_map.release();
+
+	init();
+}
+
+// ~
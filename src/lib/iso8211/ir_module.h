@@ -0,0 +1,242 @@
+#ifndef IR_MODULE_H
+#define IR_MODULE_H
+
+#include <stddef.h>
+
+#include <string>
+#include <string_view>
+
+#include "ir_struct.h"
+#include "mapped_file.h"
+#include "s57_utils.h"
+#include "iso8211_gloabal.h"
+
+struct RTree;
+
+/*
+ * Reader of a IR module casted by S57CastScanner.
+ * The module file is mapped read-only, all the records are viewed and
+ * the R-tree is searched in place, so opening a module costs no parsing.
+ * The views are valid until the module is closed.
+ */
+class ISO8211_EXPORT IrModule : public AtomicRefBase
+{
+private:
+    MappedFileRef _map;
+    int           _major;
+    int           _minor;
+
+    const IR_DatasetParam * _param;
+
+    // Record area
+    const IR_FFPtrRec *   _ffpts;
+    size_t                _ffptCount;
+    const IR_FSPtrRec *   _fspts;
+    size_t                _fsptCount;
+    const IR_FeatureRec * _features;
+    size_t                _grCount;
+    size_t                _mrCount;
+    size_t                _lrCount;
+    const IR_SpatialRec * _spatials;
+    size_t                _spatialCount;
+
+    // Attribute area
+    const IR_DirEntry * _attrDir;
+    size_t              _attrCount;
+    const char *        _attrData;
+    size_t              _attrDataSize;
+
+    // Coordinate area
+    const Int32 * _coords;
+    size_t        _coordCount;
+
+    // R-tree area
+    RTree * _tree;
+    char *  _treeBuf; // Copy of the image, if it cannot be used in place
+
+private:
+    void init();
+
+    bool readRecordArea(size_t pos, size_t * next);
+    bool readAttributeArea(size_t pos, size_t * next);
+    bool readCoordinateArea(size_t pos, size_t * next);
+    bool readRTreeArea(size_t pos, size_t * next);
+
+    IrModule(const IrModule &);
+    IrModule & operator=(const IrModule &);
+
+public:
+    IrModule();
+    IrModule(std::string fileName);
+    ~IrModule();
+
+    bool open(std::string fileName);
+    void close();
+
+    bool isOpen() const;
+
+    int majorVersion() const;
+    int minorVersion() const;
+
+    const IR_DatasetParam & datasetParam() const;
+
+    // All feature records, geo features first, then meta features
+    // and collection features.
+    size_t                featureCount() const;
+    size_t                geoFeatureCount() const;
+    size_t                metaFeatureCount() const;
+    size_t                collectionFeatureCount() const;
+    const IR_FeatureRec * features() const;
+    const IR_FeatureRec & feature(size_t i) const;
+
+    size_t                spatialCount() const;
+    const IR_SpatialRec * spatials() const;
+    const IR_SpatialRec & spatial(size_t i) const;
+
+    size_t              ffptCount() const;
+    const IR_FFPtrRec * ffpts() const;
+    size_t              fsptCount() const;
+    const IR_FSPtrRec * fspts() const;
+
+    // Attribute entries, the label and the value
+    size_t              attrCount() const;
+    const IR_DirEntry * attrEntries() const;
+    // Returns the value of the attribute entry, clipped to the attribute area
+    std::string_view attrValue(const IR_DirEntry &) const;
+
+    size_t        coordCount() const;
+    const Int32 * coords() const;
+    // Returns the coordinates of the spatial record, NULL if they are
+    // out of the coordinate area
+    const Int32 * coords(const IR_SpatialRec &) const;
+
+    // Returns the R-tree of the geo features, the data of each item is
+    // the index of the feature plus 1.
+    RTree * rtree() const;
+};
+
+typedef Ref<IrModule> IrModuleRef;
+
+// IrModule inline functions
+
+inline bool IrModule::isOpen() const
+{
+    return _param != NULL;
+}
+
+inline int IrModule::majorVersion() const
+{
+    return _major;
+}
+
+inline int IrModule::minorVersion() const
+{
+    return _minor;
+}
+
+inline const IR_DatasetParam & IrModule::datasetParam() const
+{
+    return *_param;
+}
+
+inline size_t IrModule::featureCount() const
+{
+    return _grCount + _mrCount + _lrCount;
+}
+
+inline size_t IrModule::geoFeatureCount() const
+{
+    return _grCount;
+}
+
+inline size_t IrModule::metaFeatureCount() const
+{
+    return _mrCount;
+}
+
+inline size_t IrModule::collectionFeatureCount() const
+{
+    return _lrCount;
+}
+
+inline const IR_FeatureRec * IrModule::features() const
+{
+    return _features;
+}
+
+inline const IR_FeatureRec & IrModule::feature(size_t i) const
+{
+    return _features[i];
+}
+
+inline size_t IrModule::spatialCount() const
+{
+    return _spatialCount;
+}
+
+inline const IR_SpatialRec * IrModule::spatials() const
+{
+    return _spatials;
+}
+
+inline const IR_SpatialRec & IrModule::spatial(size_t i) const
+{
+    return _spatials[i];
+}
+
+inline size_t IrModule::ffptCount() const
+{
+    return _ffptCount;
+}
+
+inline const IR_FFPtrRec * IrModule::ffpts() const
+{
+    return _ffpts;
+}
+
+inline size_t IrModule::fsptCount() const
+{
+    return _fsptCount;
+}
+
+inline const IR_FSPtrRec * IrModule::fspts() const
+{
+    return _fspts;
+}
+
+inline size_t IrModule::attrCount() const
+{
+    return _attrCount;
+}
+
+inline const IR_DirEntry * IrModule::attrEntries() const
+{
+    return _attrDir;
+}
+
+inline std::string_view IrModule::attrValue(const IR_DirEntry & ent) const
+{
+    if (ent.pos >= _attrDataSize)
+        return std::string_view();
+    size_t len = ent.size < _attrDataSize - ent.pos ? ent.size : _attrDataSize - ent.pos;
+    return std::string_view(_attrData + ent.pos, len);
+}
+
+inline size_t IrModule::coordCount() const
+{
+    return _coordCount;
+}
+
+inline const Int32 * IrModule::coords() const
+{
+    return _coords;
+}
+
+inline RTree * IrModule::rtree() const
+{
+    return _tree;
+}
+
+// ~
+
+#endif
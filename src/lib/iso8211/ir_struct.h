@@ -14,7 +14,12 @@ typedef unsigned long  UInt32;
 typedef long           Int32;
 
 #define IRV_MAJOR 1
-#define IRV_MINOR 1
+#define IRV_MINOR 2
+
+// Data versions of the R-tree area, the flat image is position-independent
+// and searched in place, see rtreeAttachImage(). Since IR version 1.2.
+#define IR_RTREE_POINTERS 1
+#define IR_RTREE_FLAT     2
 
 #pragma pack(2)
 typedef struct IR_DataAreaLeader
@@ -0,0 +1,154 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.h"
+
+using namespace std;
+
+// MappedFile members
+
+void MappedFile::init()
+{
+	_data = NULL;
+	_size = 0;
+	_isOpen = false;
+	_isCopyOnWrite = false;
+#ifdef _WIN32
+	_hFile = INVALID_HANDLE_VALUE;
+	_hMap = NULL;
+#endif
+}
+
+MappedFile::MappedFile()
+	: AtomicRefBase()
+{
+	init();
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const string &fileName, bool copyOnWrite)
+{
+	if (isOpen())
+		close();
+
+	_hFile = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (_hFile == INVALID_HANDLE_VALUE) {
+		fprintf(stderr, "%s: cannot open file (%lu)\n", fileName.c_str(), GetLastError());
+		return false;
+	}
+
+	LARGE_INTEGER fsz;
+	if (!GetFileSizeEx(_hFile, &fsz)) {
+		fprintf(stderr, "%s: cannot get file size (%lu)\n", fileName.c_str(), GetLastError());
+		close();
+		return false;
+	}
+
+	// an empty file can not be mapped, but is still a valid (empty) mapping
+	_isOpen = true;
+	if (fsz.QuadPart == 0)
+		return true;
+
+	_hMap = CreateFileMappingA(_hFile, NULL, 
+			copyOnWrite ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, NULL);
+	if (_hMap == NULL) {
+		fprintf(stderr, "%s: cannot map file (%lu)\n", fileName.c_str(), GetLastError());
+		close();
+		return false;
+	}
+
+	_data = static_cast<const char *>(MapViewOfFile(_hMap, 
+				copyOnWrite ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+	if (_data == NULL) {
+		fprintf(stderr, "%s: cannot map file (%lu)\n", fileName.c_str(), GetLastError());
+		close();
+		return false;
+	}
+	_size = static_cast<size_t>(fsz.QuadPart);
+	_isCopyOnWrite = copyOnWrite;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (_data != NULL)
+		UnmapViewOfFile(_data);
+	if (_hMap != NULL)
+		CloseHandle(_hMap);
+	if (_hFile != INVALID_HANDLE_VALUE)
+		CloseHandle(_hFile);
+
+	init();
+}
+
+#else
+
+bool MappedFile::open(const string &fileName, bool copyOnWrite)
+{
+	if (isOpen())
+		close();
+
+	int fd = ::open(fileName.c_str(), O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: %s\n", fileName.c_str(), strerror(errno));
+		return false;
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		fprintf(stderr, "%s: %s\n", fileName.c_str(), strerror(errno));
+		::close(fd);
+		return false;
+	}
+
+	// an empty file can not be mapped, but is still a valid (empty) mapping
+	_isOpen = true;
+	if (st.st_size == 0) {
+		::close(fd);
+		return true;
+	}
+
+	int prot = copyOnWrite ? (PROT_READ | PROT_WRITE) : PROT_READ;
+	void *p = mmap(NULL, st.st_size, prot, MAP_PRIVATE, fd, 0);
+	::close(fd); // the mapping holds its own reference to the file
+	if (p == MAP_FAILED) {
+		fprintf(stderr, "%s: %s\n", fileName.c_str(), strerror(errno));
+		init();
+		return false;
+	}
+	madvise(p, st.st_size, MADV_SEQUENTIAL);
+
+	_data = static_cast<const char *>(p);
+	_size = st.st_size;
+	_isCopyOnWrite = copyOnWrite;
+
+	return true;
+}
+
+void MappedFile::close()
+{
+	if (_data != NULL)
+		munmap(const_cast<char *>(_data), _size);
+
+	init();
+}
+
+#endif
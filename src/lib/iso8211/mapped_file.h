@@ -0,0 +1,95 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+
+#include <string>
+#include <string_view>
+
+#include "s57_utils.h"
+#include "iso8211_gloabal.h"
+
+/*
+ * Read-only memory mapping of a whole file.
+ * A copy-on-write mapping can be modified in memory, the changes are
+ * private to the process and never reach the file.
+ */
+class ISO8211_EXPORT MappedFile : public AtomicRefBase
+{
+private:
+    const char * _data;
+    size_t       _size;
+    bool         _isOpen;
+    bool         _isCopyOnWrite;
+#ifdef _WIN32
+    void * _hFile;
+    void * _hMap;
+#endif
+
+private:
+    void init();
+
+    MappedFile(const MappedFile &);
+    MappedFile & operator=(const MappedFile &);
+
+public:
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const std::string & fileName, bool copyOnWrite = false);
+    void close();
+
+    bool isOpen() const;
+    bool isCopyOnWrite() const;
+
+    const char * data() const;
+    size_t       size() const;
+
+    // Returns the modifiable data of a copy-on-write mapping, otherwise NULL
+    char * writableData();
+
+    // Returns the bytes [pos, pos + len) of the mapping, clipped to its end
+    std::string_view view(size_t pos, size_t len) const;
+};
+
+typedef Ref<MappedFile> MappedFileRef;
+
+// MappedFile inline functions
+
+inline bool MappedFile::isOpen() const
+{
+    return _isOpen;
+}
+
+inline bool MappedFile::isCopyOnWrite() const
+{
+    return _isCopyOnWrite;
+}
+
+inline const char * MappedFile::data() const
+{
+    return _data;
+}
+
+inline size_t MappedFile::size() const
+{
+    return _size;
+}
+
+inline char * MappedFile::writableData()
+{
+    return _isCopyOnWrite ? const_cast<char *>(_data) : NULL;
+}
+
+inline std::string_view MappedFile::view(size_t pos, size_t len) const
+{
+    if (pos >= _size)
+        return std::string_view();
+    if (len > _size - pos)
+        len = _size - pos;
+    return std::string_view(_data + pos, len);
+}
+
+// ~
+
+#endif
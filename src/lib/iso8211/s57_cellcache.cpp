@@ -0,0 +1,199 @@
+#include <stdio.h>
+
+#include "s57_cellcache.h"
+
+using namespace std;
+
+// Estimated cost of an entry of a name index
+static const size_t NAME_INDEX_ENTRY_SIZE = sizeof(unsigned long long) + sizeof(size_t) + sizeof(void *) * 2;
+
+// Returns an estimate of the memory held by the header of the record
+static size_t headerUsage(const S57Record *r)
+{
+	LRHeaderRef hr = r->header();
+	if (hr.isNull())
+		return 0;
+	return sizeof(LRHeader) + hr->_dir.capacity() * sizeof(LRDirEntry);
+}
+
+// Resolves the numbers of the pool of the record, unless it's the pool
+// last resolved, as the records mostly share the pool of the cell
+static void resolveRecordPool(const S57Record *r, const S57AttrPool **last)
+{
+	const S57AttrPoolRef &pool = r->attrPool();
+	if (!pool.isNull() && pool.getPtr() != *last) {
+		pool->resolveNumbers();
+		*last = pool.getPtr();
+	}
+}
+
+// S57Cell members
+
+void S57Cell::freeze()
+{
+	const vector<S57FeatureRecordRef> *lists[] = { &_grList, &_mrList, &_lrList };
+	for (int i = 0; i < 3; ++i) {
+		vector<S57FeatureRecordRef>::const_iterator it = lists[i]->begin();
+		for (; it != lists[i]->end(); ++it)
+			(*it)->fieldFOID();
+	}
+
+	vector<S57VectorRecordRef>::const_iterator vt = _vrList.begin();
+	for (; vt != _vrList.end(); ++vt)
+		(*vt)->fieldsATTV();
+
+	if (!_attrPool.isNull())
+		_attrPool->resolveNumbers();
+
+	// the records decoded without a module have pools of their own
+	const S57AttrPool *last = _attrPool.getPtr();
+	for (int i = 0; i < 3; ++i) {
+		vector<S57FeatureRecordRef>::const_iterator it = lists[i]->begin();
+		for (; it != lists[i]->end(); ++it)
+			resolveRecordPool(it->getPtr(), &last);
+	}
+	for (vt = _vrList.begin(); vt != _vrList.end(); ++vt)
+		resolveRecordPool(vt->getPtr(), &last);
+}
+
+size_t S57Cell::memoryUsage() const
+{
+	size_t n = sizeof(S57Cell);
+
+	const vector<S57FeatureRecordRef> *lists[] = { &_grList, &_mrList, &_lrList };
+	for (int i = 0; i < 3; ++i) {
+		n += lists[i]->capacity() * sizeof(S57FeatureRecordRef);
+		vector<S57FeatureRecordRef>::const_iterator it = lists[i]->begin();
+		for (; it != lists[i]->end(); ++it) {
+			const S57FeatureRecord *r = it->getPtr();
+			n += sizeof(S57FeatureRecord) + headerUsage(r)
+				+ sizeof(S57_FRID) + sizeof(S57_LNAM)
+				+ (r->fieldsATTF().capacity() + r->fieldsNATF().capacity()) * sizeof(S57_AttItem)
+				+ r->fieldsFFPT().capacity() * sizeof(S57_FFPT)
+				+ r->fieldsFSPT().capacity() * sizeof(S57_FSPT);
+		}
+	}
+
+	n += _vrList.capacity() * sizeof(S57VectorRecordRef);
+	vector<S57VectorRecordRef>::const_iterator vt = _vrList.begin();
+	for (; vt != _vrList.end(); ++vt) {
+		const S57VectorRecord *r = vt->getPtr();
+		n += sizeof(S57VectorRecord) + headerUsage(r) + sizeof(S57_VRID)
+			+ r->fieldsATTV().capacity() * sizeof(S57_AttItem)
+			+ r->fieldsVRPT().capacity() * sizeof(S57_VRPT)
+			+ r->coords().size() * r->coords().dimension() * sizeof(int32_t);
+	}
+
+	n += (_grIndex.size() + _mrIndex.size() + _lrIndex.size() + _vrIndex.size())
+		* NAME_INDEX_ENTRY_SIZE;
+	if (!_attrPool.isNull())
+		n += _attrPool->memoryUsage();
+
+	return n;
+}
+
+// S57CellCache members
+
+S57CellCache::S57CellCache(size_t budget)
+	: AtomicRefBase(), _budget(budget), _usage(0), _hits(0), _misses(0)
+{
+}
+
+void S57CellCache::evict()
+{
+	while (_usage > _budget && !_entries.empty()) {
+		Entry &e = _entries.back();
+		_usage -= e.size;
+		_index.erase(e.key);
+		_entries.pop_back();
+	}
+}
+
+size_t S57CellCache::budget() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _budget;
+}
+
+void S57CellCache::setBudget(size_t budget)
+{
+	lock_guard<mutex> lock(_mutex);
+	_budget = budget;
+	evict();
+}
+
+size_t S57CellCache::memoryUsage() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _usage;
+}
+
+size_t S57CellCache::count() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _entries.size();
+}
+
+size_t S57CellCache::hits() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _hits;
+}
+
+size_t S57CellCache::misses() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _misses;
+}
+
+S57CellRef S57CellCache::find(const string &key)
+{
+	lock_guard<mutex> lock(_mutex);
+
+	unordered_map<string, EntryList::iterator>::iterator it = _index.find(key);
+	if (it == _index.end()) {
+		++_misses;
+		return S57CellRef();
+	}
+
+	++_hits;
+	_entries.splice(_entries.begin(), _entries, it->second);
+	return it->second->cell;
+}
+
+void S57CellCache::insert(const string &key, S57CellRef cell)
+{
+	// out of the lock, the cell is not shared yet
+	cell->freeze();
+	size_t size = cell->memoryUsage();
+
+	lock_guard<mutex> lock(_mutex);
+
+	unordered_map<string, EntryList::iterator>::iterator it = _index.find(key);
+	if (it != _index.end()) {
+		_usage -= it->second->size;
+		_entries.erase(it->second);
+		_index.erase(it);
+	}
+	if (size > _budget)
+		return;
+
+	Entry e;
+	e.key = key;
+	e.cell = cell;
+	e.size = size;
+	_entries.push_front(e);
+	_index[key] = _entries.begin();
+	_usage += size;
+	evict();
+}
+
+void S57CellCache::clear()
+{
+	lock_guard<mutex> lock(_mutex);
+	_entries.clear();
+	_index.clear();
+	_usage = 0;
+}
+
+// ~
@@ -0,0 +1,111 @@
+#ifndef S57_CELLCACHE_H
+#define S57_CELLCACHE_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+#include "s57_utils.h"
+#include "s57_record.h"
+#include "iso8211_gloabal.h"
+
+/*
+ * Records of a data set merged with its update cells, as kept by
+ * S57ParseScanner. Once frozen a cell is read-only, and can be shared
+ * by the scanners of any thread.
+ *
+ * Only the cell is counted atomically. Its records keep the plain count
+ * of RefBase: the cell owns them, and the readers of a shared cell borrow
+ * them (pointers or const references) while holding the cell, taking no
+ * Ref of their own.
+ */
+class ISO8211_EXPORT S57Cell : public AtomicRefBase
+{
+public:
+    S57DSInfoRecordRef               _dsinfRec;
+    S57DSGeoRecordRef                _dsgeoRec;
+    S57DSAccuracyRecordRef           _dsaccRec;
+    std::vector<S57FeatureRecordRef> _grList; // Geo features
+    std::vector<S57FeatureRecordRef> _mrList; // Meta features
+    std::vector<S57FeatureRecordRef> _lrList; // Collection features
+    std::vector<S57VectorRecordRef>  _vrList; // Vector records
+
+    // Attribute values of the data set and its update cells
+    S57AttrPoolRef _attrPool;
+
+    // Record indexes, S57_NAME::key() to the position in the list.
+    // Only the first record of a name is indexed, as the lookup
+    // always returned the first one.
+    typedef std::unordered_map<unsigned long long, size_t> NameIndex;
+    NameIndex _grIndex;
+    NameIndex _mrIndex;
+    NameIndex _lrIndex;
+    NameIndex _vrIndex;
+
+public:
+    // Decodes the fields left pending by lazy decoding and the attribute
+    // numbers, nothing is written in the cell on reading afterwards.
+    void freeze();
+
+    // Returns an estimate of the memory held by the records
+    size_t memoryUsage() const;
+};
+
+typedef Ref<S57Cell> S57CellRef;
+
+/*
+ * Least recently used cache of merged cells, within a memory budget.
+ * The key identifies the files the cell is parsed from, see
+ * S57ParseScanner::setCellCache(). The cache is thread-safe.
+ */
+class ISO8211_EXPORT S57CellCache : public AtomicRefBase
+{
+private:
+    struct Entry
+    {
+        std::string key;
+        S57CellRef  cell;
+        size_t      size;
+    };
+    typedef std::list<Entry> EntryList;
+
+    EntryList                                             _entries; // Most recently used first
+    std::unordered_map<std::string, EntryList::iterator> _index;
+    size_t                                                _budget;
+    size_t                                                _usage;
+    size_t                                                _hits;
+    size_t                                                _misses;
+    mutable std::mutex                                    _mutex;
+
+private:
+    // Drops the least recently used cells until the usage fits the budget
+    void evict();
+
+    S57CellCache(const S57CellCache &);
+    S57CellCache & operator=(const S57CellCache &);
+
+public:
+    // Constructs a cache of the memory budget in bytes
+    S57CellCache(size_t budget);
+
+    size_t budget() const;
+    void   setBudget(size_t);
+    size_t memoryUsage() const;
+    size_t count() const;
+    size_t hits() const;
+    size_t misses() const;
+
+    // Returns the cell of the key, or a null one if not cached
+    S57CellRef find(const std::string & key);
+    // Freezes the cell and caches it, unless it's larger than the budget
+    void insert(const std::string & key, S57CellRef cell);
+    void clear();
+};
+
+typedef Ref<S57CellCache> S57CellCacheRef;
+
+#endif
@@ -0,0 +1,359 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "../tools/LString.h"
+
+#include "s57_exportbackend.h"
+
+using namespace std;
+using namespace MyTools;
+
+// Returns k if f is 10^k, k in [0, maxDigits], otherwise -1
+static int decimalDigits(double f, int maxDigits)
+{
+	double p = 1.0;
+	for (int k = 0; k <= maxDigits; ++k, p *= 10.0) {
+		if (f == p)
+			return k;
+	}
+	return -1;
+}
+
+// Returns 10^k
+static long long power10(int k)
+{
+	long long p = 1;
+	while (k-- > 0)
+		p *= 10;
+	return p;
+}
+
+// S57ExportBackend members
+
+S57ExportBackend::S57ExportBackend()
+	: AtomicRefBase(), _comf(1.0), _somf(1.0), _comfDigits(0), _somfDigits(0)
+{
+}
+
+S57ExportBackend::~S57ExportBackend()
+{
+}
+
+void S57ExportBackend::open(const string &name, int objl, double comf, double somf)
+{
+	_comf = comf;
+	_somf = somf;
+	_comfDigits = decimalDigits(_comf, COORD_DECIMALS);
+	_somfDigits = decimalDigits(_somf, COORD_DECIMALS);
+
+	doOpen(name, objl);
+}
+
+void S57ExportBackend::putCoord(S57ExportWriter *w, s57_b24 v) const
+{
+	if (_comfDigits >= 0)
+		w->putDecimal(v * power10(COORD_DECIMALS - _comfDigits), COORD_DECIMALS);
+	else
+		w->putFixed(v / _comf, COORD_DECIMALS);
+}
+
+void S57ExportBackend::putDepth(S57ExportWriter *w, s57_b24 v) const
+{
+	if (_somfDigits >= 0)
+		w->putDecimal(v, _somfDigits);
+	else
+		w->putShortest(v / _somf);
+}
+
+double S57ExportBackend::coord(s57_b24 v) const
+{
+	return v / _comf;
+}
+
+double S57ExportBackend::depth(s57_b24 v) const
+{
+	return v / _somf;
+}
+
+string S57ExportBackend::attributeName(const S57_AttItem &item)
+{
+	char sbuf[16];
+	sprintf_s(sbuf, "%u", static_cast<unsigned>(item._attl));
+	return sbuf;
+}
+
+string S57ExportBackend::attributeValue(const S57_AttItem &item, int llcode)
+{
+	string_view v = item.atvl();
+	if (llcode == S57_LL2)
+		return LString::fromUcs2(v.data(), v.size(), false).toUtf8();
+
+	// Latin alphabet 1, mostly ASCII
+	string res;
+	res.reserve(v.size());
+	for (size_t i = 0; i < v.size(); ++i) {
+		unsigned char c = v[i];
+		if (c < 0x80)
+			res.push_back(c);
+		else {
+			res.push_back(0xc0 | (c >> 6));
+			res.push_back(0x80 | (c & 0x3f));
+		}
+	}
+	return res;
+}
+
+// S57MifBackend members
+
+S57MifBackend::S57MifBackend()
+	: S57ExportBackend(), _hasDepth(false)
+{
+}
+
+S57ExportBackend *S57MifBackend::clone() const
+{
+	return new S57MifBackend;
+}
+
+void S57MifBackend::doOpen(const string &name, int objl)
+{
+	_mif = new S57ExportWriter;
+	_mid = new S57ExportWriter;
+	_mif->open(name + ".MIF");
+	_mid->open(name + ".MID");
+	_hasDepth = objl == 129;
+
+	_mif->put("VERSION 300\r\n");
+	_mif->put("CHARSET \"WindowsLatin1\"\r\n");
+	if (_hasDepth) {
+		_mif->put("COLUMNS 2\r\n");
+		_mif->put("\tFeatureID integer\r\n");
+		_mif->put("\tDepth float\r\n");
+	}
+	else {
+		_mif->put("COLUMNS 1\r\n");
+		_mif->put("\tFeatureID integer\r\n");
+	}
+	_mif->put("\r\n");
+	_mif->put("DATA\r\n");
+}
+
+void S57MifBackend::close()
+{
+	if (_mif.isNull())
+		return;
+
+	_mif->close();
+	_mid->close();
+	_mif.release();
+	_mid.release();
+}
+
+bool S57MifBackend::isOpen() const
+{
+	return !_mif.isNull();
+}
+
+void S57MifBackend::writeCoord(const S57ExportFeature &f, size_t i)
+{
+	putCoord(_mif.getPtr(), f._xy[i * 2]);
+	_mif->put(' ');
+	putCoord(_mif.getPtr(), f._xy[i * 2 + 1]);
+	_mif->put("\r\n", 2);
+}
+
+void S57MifBackend::writeId(const S57ExportFeature &f)
+{
+	_mid->putUInt(f._record->fieldFRID()->_name._rcid);
+}
+
+void S57MifBackend::write(const S57ExportFeature &f)
+{
+	switch (f._type) {
+	case S57ExportFeature::POINT:
+	case S57ExportFeature::SOUNDING:
+		// a row per point
+		for (size_t i = 0; i < f.pointCount(); ++i) {
+			_mif->put("POINT ", 6);
+			writeCoord(f, i);
+			writeId(f);
+			if (_hasDepth && !f._zs.empty()) {
+				_mid->put(',');
+				putDepth(_mid.getPtr(), f._zs[i]);
+			}
+			_mid->put("\r\n", 2);
+		}
+		return;
+
+	case S57ExportFeature::LINE:
+		_mif->put("PLINE", 5);
+		if (f._ends.size() > 1) {
+			_mif->put(" MULTIPLE ", 10);
+			_mif->putUInt(f._ends.size());
+		}
+		_mif->put("\r\n", 2);
+		break;
+
+	case S57ExportFeature::AREA:
+		_mif->put("REGION ", 7);
+		_mif->putUInt(f._ends.size());
+		_mif->put("\r\n", 2);
+		break;
+	}
+
+	size_t begin = 0;
+	for (size_t p = 0; p < f._ends.size(); begin = f._ends[p++]) {
+		_mif->putUInt(f._ends[p] - begin);
+		_mif->put("\r\n", 2);
+		for (size_t i = begin; i < f._ends[p]; ++i)
+			writeCoord(f, i);
+	}
+
+	writeId(f);
+	_mid->put("\r\n", 2);
+}
+
+// S57GeoJsonBackend members
+
+S57GeoJsonBackend::S57GeoJsonBackend()
+	: S57ExportBackend()
+{
+}
+
+S57ExportBackend *S57GeoJsonBackend::clone() const
+{
+	return new S57GeoJsonBackend;
+}
+
+void S57GeoJsonBackend::doOpen(const string &name, int)
+{
+	_out = new S57ExportWriter;
+	_out->open(name + ".geojsonl");
+}
+
+void S57GeoJsonBackend::close()
+{
+	if (_out.isNull())
+		return;
+
+	_out->close();
+	_out.release();
+}
+
+bool S57GeoJsonBackend::isOpen() const
+{
+	return !_out.isNull();
+}
+
+void S57GeoJsonBackend::writePosition(const S57ExportFeature &f, size_t i)
+{
+	_out->put('[');
+	putCoord(_out.getPtr(), f._xy[i * 2]);
+	_out->put(',');
+	putCoord(_out.getPtr(), f._xy[i * 2 + 1]);
+	if (!f._zs.empty()) {
+		_out->put(',');
+		putDepth(_out.getPtr(), f._zs[i]);
+	}
+	_out->put(']');
+}
+
+void S57GeoJsonBackend::writePositions(const S57ExportFeature &f, size_t begin, size_t end)
+{
+	_out->put('[');
+	for (size_t i = begin; i < end; ++i) {
+		if (i != begin)
+			_out->put(',');
+		writePosition(f, i);
+	}
+	_out->put(']');
+}
+
+void S57GeoJsonBackend::writeString(const string &s)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	_out->put('"');
+	for (size_t i = 0; i < s.size(); ++i) {
+		unsigned char c = s[i];
+		if (c == '"' || c == '\\') {
+			_out->put('\\');
+			_out->put(c);
+		}
+		else if (c < 0x20) {
+			_out->put("\\u00", 4);
+			_out->put(hex[c >> 4]);
+			_out->put(hex[c & 0xf]);
+		}
+		else
+			_out->put(c);
+	}
+	_out->put('"');
+}
+
+void S57GeoJsonBackend::write(const S57ExportFeature &f)
+{
+	_out->put("{\"type\":\"Feature\",\"id\":");
+	_out->putUInt(f._record->fieldFRID()->_name._rcid);
+	_out->put(",\"geometry\":{\"type\":\"");
+
+	size_t nparts = f._ends.size();
+	switch (f._type) {
+	case S57ExportFeature::POINT:
+		if (f.pointCount() == 1) {
+			_out->put("Point\",\"coordinates\":");
+			writePosition(f, 0);
+		}
+		else {
+			_out->put("MultiPoint\",\"coordinates\":");
+			writePositions(f, 0, f.pointCount());
+		}
+		break;
+
+	case S57ExportFeature::SOUNDING:
+		_out->put("MultiPoint\",\"coordinates\":");
+		writePositions(f, 0, f.pointCount());
+		break;
+
+	case S57ExportFeature::LINE:
+	case S57ExportFeature::AREA:
+		if (f._type == S57ExportFeature::AREA)
+			_out->put("Polygon\",\"coordinates\":[");
+		else if (nparts == 1)
+			_out->put("LineString\",\"coordinates\":");
+		else
+			_out->put("MultiLineString\",\"coordinates\":[");
+
+		for (size_t p = 0; p < nparts; ++p) {
+			if (p != 0)
+				_out->put(',');
+			writePositions(f, p == 0 ? 0 : f._ends[p - 1], f._ends[p]);
+		}
+
+		if (f._type == S57ExportFeature::AREA || nparts != 1)
+			_out->put(']');
+		break;
+	}
+
+	_out->put("},\"properties\":{");
+
+	// ATTF then NATF, in the order of the record
+	const vector<S57_AttItem> *atts[] = { &f._record->fieldsATTF(), &f._record->fieldsNATF() };
+	int llcodes[] = { f._record->aall(), f._record->nall() };
+	bool first = true;
+	for (int k = 0; k < 2; ++k) {
+		vector<S57_AttItem>::const_iterator it = atts[k]->begin();
+		for (; it != atts[k]->end(); ++it) {
+			if (!first)
+				_out->put(',');
+			first = false;
+			writeString(attributeName(*it));
+			_out->put(':');
+			writeString(attributeValue(*it, llcodes[k]));
+		}
+	}
+
+	_out->put("}}\n", 3);
+}
+
+// ~
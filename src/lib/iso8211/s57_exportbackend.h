@@ -0,0 +1,174 @@
+#ifndef S57_EXPORTBACKEND_H
+#define S57_EXPORTBACKEND_H
+
+#include <stddef.h>
+
+#include <string>
+#include <vector>
+
+#include "s57_utils.h"
+#include "s57_record.h"
+#include "s57_exportwriter.h"
+#include "iso8211_gloabal.h"
+
+/*
+ * Geometry of a feature resolved by S57Extract from its vector records,
+ * as handed to the export backends. The coordinates stay in the integer
+ * units of the data set, see S57ExportBackend::coord().
+ */
+class ISO8211_EXPORT S57ExportFeature
+{
+public:
+    enum GeomType
+    {
+        POINT,    // A point per part
+        SOUNDING, // Points of SG3D vectors, with their depths
+        LINE,     // A line string per part
+        AREA      // The closed rings of a polygon, the outer one first
+    };
+
+    const S57FeatureRecord * _record;
+    GeomType                 _type;
+    std::vector<s57_b24>     _xy;   // X and Y of each point
+    std::vector<s57_b24>     _zs;   // Depth of each point, SOUNDING only
+    std::vector<size_t>      _ends; // Point count at the end of each part
+
+public:
+    S57ExportFeature();
+
+    void clear();
+
+    size_t pointCount() const;
+};
+
+/*
+ * Output format of the features of an object class. S57Extract clones
+ * its backend for each class of a data set, then opens the clone, writes
+ * the features as they are resolved and closes it. A backend never
+ * holds the geometries it's given, and holds its writers only while open.
+ *
+ * The attributes are named by their ATTL codes, the library has no
+ * attribute catalogue, and converted to UTF-8 from their lexical level.
+ */
+class ISO8211_EXPORT S57ExportBackend : public AtomicRefBase
+{
+private:
+    double _comf;
+    double _somf;
+    int    _comfDigits; // k if _comf is 10^k, otherwise -1
+    int    _somfDigits;
+
+protected:
+    // Decimals of the coordinates written
+    static const int COORD_DECIMALS = 7;
+
+    virtual void doOpen(const std::string & name, int objl) = 0;
+
+    // Writes a coordinate or a depth in degrees or meters, from the
+    // integers if the factor is a power of ten.
+    void putCoord(S57ExportWriter *, s57_b24) const;
+    void putDepth(S57ExportWriter *, s57_b24) const;
+
+    double coord(s57_b24) const;
+    double depth(s57_b24) const;
+
+    static std::string attributeName(const S57_AttItem &);
+    static std::string attributeValue(const S57_AttItem &, int llcode);
+
+public:
+    S57ExportBackend();
+    virtual ~S57ExportBackend();
+
+    // Returns a new backend of the same kind and settings, not open
+    virtual S57ExportBackend * clone() const = 0;
+
+    // Starts the output of an object class, to name plus the file
+    // extension of the backend, with the COMF and SOMF of the data set.
+    void open(const std::string & name, int objl, double comf, double somf);
+    virtual void close() = 0;
+    virtual bool isOpen() const = 0;
+
+    virtual void write(const S57ExportFeature &) = 0;
+};
+
+typedef Ref<S57ExportBackend> S57ExportBackendRef;
+
+/*
+ * MapInfo MIF/MID pair, with the FeatureID column, and the Depth of
+ * each sounding for SOUNDG.
+ */
+class ISO8211_EXPORT S57MifBackend : public S57ExportBackend
+{
+private:
+    S57ExportWriterRef _mif;
+    S57ExportWriterRef _mid;
+    bool               _hasDepth;
+
+private:
+    void doOpen(const std::string & name, int objl);
+
+    void writeCoord(const S57ExportFeature &, size_t i);
+    void writeId(const S57ExportFeature &);
+
+public:
+    S57MifBackend();
+
+    S57ExportBackend * clone() const;
+
+    void close();
+    bool isOpen() const;
+
+    void write(const S57ExportFeature &);
+};
+
+/*
+ * Newline-delimited GeoJSON (.geojsonl), a Feature object per line with
+ * the record id as id and the attributes as properties. The depths of
+ * the soundings are their third coordinates.
+ */
+class ISO8211_EXPORT S57GeoJsonBackend : public S57ExportBackend
+{
+private:
+    S57ExportWriterRef _out;
+
+private:
+    void doOpen(const std::string & name, int objl);
+
+    void writePosition(const S57ExportFeature &, size_t i);
+    void writePositions(const S57ExportFeature &, size_t begin, size_t end);
+    void writeString(const std::string &);
+
+public:
+    S57GeoJsonBackend();
+
+    S57ExportBackend * clone() const;
+
+    void close();
+    bool isOpen() const;
+
+    void write(const S57ExportFeature &);
+};
+
+// S57ExportFeature inline functions
+
+inline S57ExportFeature::S57ExportFeature()
+    : _record(NULL)
+    , _type(POINT)
+{}
+
+inline void S57ExportFeature::clear()
+{
+    _record = NULL;
+    _xy.clear();
+    _zs.clear();
+    _ends.clear();
+}
+
+inline size_t S57ExportFeature::pointCount() const
+{
+    return _xy.size() / 2;
+}
+
+// ~
+
+#endif
@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+
+#include <charconv>
+
+#include "assure_fio.h"
+#include "s57_exportwriter.h"
+
+using namespace std;
+
+// Room taken by a formatted number: sign, 20 digits, point and decimals
+static const size_t NUMBER_SIZE = 32;
+static const int    MAX_DECIMALS = 18;
+
+// S57ExportWriter members
+
+void S57ExportWriter::init()
+{
+	_fp = NULL;
+	_buf = NULL;
+	_size = 0;
+	_capacity = 0;
+	_flushed = 0;
+}
+
+S57ExportWriter::S57ExportWriter(size_t bufferSize)
+	: RefBase()
+{
+	init();
+	_bufferSize = bufferSize < 4096 ? 4096 : bufferSize;
+}
+
+S57ExportWriter::~S57ExportWriter()
+{
+	close();
+	delete [] _buf;
+}
+
+void S57ExportWriter::open(const string &fileName)
+{
+	close();
+	_fp = as_fopen(fileName.c_str(), "wb");
+	// the buffer is ours, stdio would only copy it once more
+	setvbuf(_fp, NULL, _IONBF, 0);
+	delete [] _buf;
+	_capacity = _bufferSize;
+	_buf = new char[_capacity];
+}
+
+void S57ExportWriter::close()
+{
+	if (_fp == NULL)
+		return;
+
+	flush();
+	fclose(_fp);
+	delete [] _buf;
+	init();
+}
+
+void S57ExportWriter::flush()
+{
+	if (_fp != NULL && _size != 0)
+		as_fwrite(_buf, 1, _size, _fp);
+	_flushed += _size;
+	_size = 0;
+}
+
+void S57ExportWriter::reserve(size_t n)
+{
+	// the buffer is full or, before open(), not allocated
+	assert(_fp != NULL);
+	flush();
+	if (n <= _capacity)
+		return;
+
+	// a single piece larger than the buffer
+	delete [] _buf;
+	_capacity = n;
+	_buf = new char[_capacity];
+}
+
+void S57ExportWriter::putInt(long long v)
+{
+	if (_capacity - _size < NUMBER_SIZE)
+		reserve(NUMBER_SIZE);
+	_size = to_chars(_buf + _size, _buf + _capacity, v).ptr - _buf;
+}
+
+void S57ExportWriter::putUInt(unsigned long long v)
+{
+	if (_capacity - _size < NUMBER_SIZE)
+		reserve(NUMBER_SIZE);
+	_size = to_chars(_buf + _size, _buf + _capacity, v).ptr - _buf;
+}
+
+void S57ExportWriter::putFixed(double v, int precision)
+{
+	// 309 integer digits at most, plus the decimals
+	size_t n = 320 + precision;
+	if (_capacity - _size < n)
+		reserve(n);
+	_size = to_chars(_buf + _size, _buf + _capacity, v, chars_format::fixed, precision).ptr - _buf;
+}
+
+void S57ExportWriter::putShortest(double v)
+{
+	if (_capacity - _size < NUMBER_SIZE)
+		reserve(NUMBER_SIZE);
+	_size = to_chars(_buf + _size, _buf + _capacity, v).ptr - _buf;
+}
+
+void S57ExportWriter::putDecimal(long long v, int decimals)
+{
+	if (decimals <= 0 || decimals > MAX_DECIMALS) {
+		putInt(v);
+		return;
+	}
+
+	if (_capacity - _size < NUMBER_SIZE + decimals)
+		reserve(NUMBER_SIZE + decimals);
+
+	char *p = _buf + _size;
+	unsigned long long u = v;
+	if (v < 0) {
+		*p++ = '-';
+		u = 0ULL - u;
+	}
+
+	// the digits backwards, zero padded to the decimals plus a unit
+	char tmp[NUMBER_SIZE];
+	int n = 0;
+	do {
+		tmp[n++] = '0' + u % 10;
+		u /= 10;
+	} while (u != 0 || n <= decimals);
+
+	while (n > decimals)
+		*p++ = tmp[--n];
+	*p++ = '.';
+	while (n > 0)
+		*p++ = tmp[--n];
+
+	_size = p - _buf;
+}
+
+// ~
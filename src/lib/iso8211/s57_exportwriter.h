@@ -0,0 +1,114 @@
+#ifndef S57_EXPORTWRITER_H
+#define S57_EXPORTWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "s57_utils.h"
+#include "iso8211_gloabal.h"
+
+/*
+ * Output file of the exports, written through a large buffer of its own,
+ * held only while the file is open. The numbers are formatted by
+ * std::to_chars into the buffer, which is several times faster than the
+ * printf family for the coordinates. Nothing may be put while the file
+ * is not open, debug builds assert it.
+ */
+class ISO8211_EXPORT S57ExportWriter : public RefBase
+{
+private:
+    FILE *   _fp;
+    char *   _buf;
+    size_t   _size;       // Bytes in the buffer
+    size_t   _capacity;
+    size_t   _bufferSize; // Capacity allocated by open()
+    uint64_t _flushed;    // Bytes written to the file
+
+private:
+    void init();
+
+    // Makes room for n bytes in the buffer
+    void reserve(size_t n);
+
+    S57ExportWriter(const S57ExportWriter &);
+    S57ExportWriter & operator=(const S57ExportWriter &);
+
+public:
+    enum
+    {
+        DEFAULT_BUFFER_SIZE = 1024 * 1024
+    };
+
+    S57ExportWriter(size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~S57ExportWriter();
+
+    // Creates the file, the program exits if it cannot be written,
+    // see as_fopen().
+    void open(const std::string & fileName);
+    void close();
+    bool isOpen() const;
+    void flush();
+    // Returns the number of bytes put since the file was opened
+    uint64_t position() const;
+
+    void put(char);
+    void put(const char * s, size_t n);
+    void put(const char * s);
+    void put(const std::string & s);
+
+    void putInt(long long);
+    void putUInt(unsigned long long);
+    // Writes v with precision decimals, as "%.*f" does
+    void putFixed(double v, int precision);
+    // Writes the shortest representation read back as v
+    void putShortest(double v);
+    // Writes v / 10^decimals with all its decimals, exactly
+    void putDecimal(long long v, int decimals);
+};
+
+typedef Ref<S57ExportWriter> S57ExportWriterRef;
+
+// S57ExportWriter inline functions
+
+inline bool S57ExportWriter::isOpen() const
+{
+    return _fp != NULL;
+}
+
+inline uint64_t S57ExportWriter::position() const
+{
+    return _flushed + _size;
+}
+
+inline void S57ExportWriter::put(char c)
+{
+    if (_size == _capacity)
+        reserve(1);
+    _buf[_size++] = c;
+}
+
+inline void S57ExportWriter::put(const char * s, size_t n)
+{
+    if (_capacity - _size < n)
+        reserve(n);
+    memcpy(_buf + _size, s, n);
+    _size += n;
+}
+
+inline void S57ExportWriter::put(const char * s)
+{
+    put(s, strlen(s));
+}
+
+inline void S57ExportWriter::put(const std::string & s)
+{
+    put(s.data(), s.size());
+}
+
+// ~
+
+#endif
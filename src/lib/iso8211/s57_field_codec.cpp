@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
 #include <assert.h>
 
 #include <strstream>
@@ -63,6 +64,60 @@ string S57_Date::toString() const
 	return result;
 }
 
+// S57AttrValue members
+
+long S57AttrValue::toInt() const
+{
+	if (!_hasInt) {
+		_int = strToInt(_str);
+		_hasInt = true;
+	}
+	return _int;
+}
+
+double S57AttrValue::toFloat() const
+{
+	if (!_hasFloat) {
+		_float = strToFloat(_str);
+		_hasFloat = true;
+	}
+	return _float;
+}
+
+// S57AttrPool members
+
+const S57AttrValue *S57AttrPool::intern(string_view s)
+{
+	unordered_map<string_view, const S57AttrValue *>::const_iterator it = _index.find(s);
+	if (it != _index.end())
+		return it->second;
+
+	// the key views the pooled string, a deque never moves its elements
+	_values.emplace_back(s);
+	const S57AttrValue *v = &_values.back();
+	_index.emplace(string_view(v->str()), v);
+	return v;
+}
+
+void S57AttrPool::resolveNumbers()
+{
+	deque<S57AttrValue>::const_iterator it = _values.begin();
+	for (; it != _values.end(); ++it) {
+		it->toInt();
+		it->toFloat();
+	}
+}
+
+size_t S57AttrPool::memoryUsage() const
+{
+	size_t n = _values.size() * (sizeof(S57AttrValue) + sizeof(void *) * 4);
+	deque<S57AttrValue>::const_iterator it = _values.begin();
+	for (; it != _values.end(); ++it)
+		if (it->str().capacity() >= sizeof(string))
+			n += it->str().capacity() + 1;
+	return n;
+}
+
 // S57_AttItem members
 
 string S57_AttItem::toString(int llcode) const
@@ -70,10 +125,11 @@ string S57_AttItem::toString(int llcode) const
 	ostrstream os;
 	os << INDENT << "*ATTL: " << _attl << endl
 		<< INDENT << "ATVL:  ";
+	string_view v = atvl();
 	if (llcode == S57_LL2)
-		os << LString::fromUcs2(_atvl.data(), _atvl.size(), false).toUtf8();
+		os << LString::fromUcs2(v.data(), v.size(), false).toUtf8();
 	else 
-		os << _atvl;
+		os << string(v);
 	os << endl << ends;
 
 	char *tmp = os.str();
@@ -785,6 +841,12 @@ S57Decoder::S57Decoder(string fieldData)
 	setFieldData(fieldData);
 }
 
+S57Decoder::S57Decoder(string_view fieldData)
+{
+	init();
+	setFieldData(fieldData);
+}
+
 S57Decoder::~S57Decoder()
 {
 	if (_buf != NULL)
@@ -806,6 +868,17 @@ void S57Decoder::setFieldData(string s)
 	_endptr = _curptr + bufsz;
 }
 
+void S57Decoder::setFieldData(string_view s)
+{
+	if (_buf != NULL) {
+		delete[] _buf;
+		_buf = NULL;
+	}
+
+	_curptr = s.data();
+	_endptr = _curptr + s.size();
+}
+
 s57_b24 S57Decoder::getSInt(int width)
 {
 	s57_b24 n = 0;
@@ -815,19 +888,27 @@ s57_b24 S57Decoder::getSInt(int width)
 		return 0;
 	}
 
+	// The subfields are not aligned, and s57_b24 is wider than 4 bytes
+	// on LP64 targets, so they are copied out at their exact width.
 	switch (width) {
 	case 1:
-		n = *reinterpret_cast<s57_b21 *>(_curptr);
+		n = *reinterpret_cast<const s57_b21 *>(_curptr);
 		_curptr += 1;
 		break;
-	case 2:
-		n = *reinterpret_cast<s57_b22 *>(_curptr);
+	case 2: {
+		int16_t v;
+		memcpy(&v, _curptr, 2);
+		n = v;
 		_curptr += 2;
 		break;
-	case 4:
-		n = *reinterpret_cast<s57_b24 *>(_curptr);
+	}
+	case 4: {
+		int32_t v;
+		memcpy(&v, _curptr, 4);
+		n = v;
 		_curptr += 4;
 		break;
+	}
 	default:
 		assert(0);
 		break;
@@ -850,17 +931,23 @@ s57_b14 S57Decoder::getUInt(int width)
 
 	switch (width) {
 	case 1:
-		n = *reinterpret_cast<s57_b11 *>(_curptr);
+		n = *reinterpret_cast<const s57_b11 *>(_curptr);
 		_curptr += 1;
 		break;
-	case 2:
-		n = *reinterpret_cast<s57_b12 *>(_curptr);
+	case 2: {
+		uint16_t v;
+		memcpy(&v, _curptr, 2);
+		n = v;
 		_curptr += 2;
 		break;
-	case 4:
-		n = *reinterpret_cast<s57_b14 *>(_curptr);
+	}
+	case 4: {
+		uint32_t v;
+		memcpy(&v, _curptr, 4);
+		n = v;
 		_curptr += 4;
 		break;
+	}
 	default:
 		assert(0);
 		break;
@@ -874,7 +961,12 @@ s57_b14 S57Decoder::getUInt(int width)
 
 string S57Decoder::getString(int ll, int len)
 {
-	string s;
+	return string(getStringView(ll, len));
+}
+
+string_view S57Decoder::getStringView(int ll, int len)
+{
+	string_view s;
 
 	if (isEnd()) {
 		fprintf(stderr, "*** Unexpected end of field\n");
@@ -882,23 +974,26 @@ string S57Decoder::getString(int ll, int len)
 	}
 
 	if (len != -1) {
-		s.assign(_curptr, len);
+		s = string_view(_curptr, len);
 		_curptr += len;
 	}
 	else {
-		char *p = _curptr;
+		const char *p = _curptr;
 		if (ll == S57_LL2) { 
-			while (p < _endptr 
-					&& *reinterpret_cast<s57_b12 *>(p) != S57_UT 
-					&& *reinterpret_cast<s57_b12 *>(p) != S57_FT) {
-				s.push_back(*p++);
-				s.push_back(*p++);
+			s57_b12 c;
+			while (p + 1 < _endptr) {
+				memcpy(&c, p, 2);
+				if (c == S57_UT || c == S57_FT)
+					break;
+				p += 2;
 			}
+			s = string_view(_curptr, p - _curptr);
 			_curptr = p + 2;
 		}
 		else {
 			while (p < _endptr && *p != S57_UT && *p != S57_FT)
-				s.push_back(*p++);
+				++p;
+			s = string_view(_curptr, p - _curptr);
 			_curptr = p + 1;
 		}
 	}
@@ -968,7 +1063,7 @@ bool S57Decoder::isEnd() const
 		return true;
 	else if (_curptr == _endptr - 1 && *_curptr == S57_FT)
 		return true;
-	else if (_curptr == _endptr - 2 && *(s57_b12 *)_curptr == S57_FT)
+	else if (_curptr == _endptr - 2 && *(const s57_b12 *)_curptr == S57_FT)
 		return true;
 	else
 		return false;
@@ -977,7 +1072,12 @@ bool S57Decoder::isEnd() const
 // S57Encoder members
 
 S57Encoder::S57Encoder(FILE *fp)
-	: _fp(fp)
+	: _fp(fp), _buf(NULL), _written(0)
+{
+}
+
+S57Encoder::S57Encoder(string *buf)
+	: _fp(NULL), _buf(buf), _written(0)
 {
 }
 
@@ -985,18 +1085,27 @@ S57Encoder::~S57Encoder()
 {
 }
 
+void S57Encoder::write(const void *p, size_t sz)
+{
+	if (_buf != NULL)
+		_buf->append(static_cast<const char *>(p), sz);
+	else
+		as_fwrite(p, 1, sz, _fp);
+	_written += sz;
+}
+
 void S57Encoder::setUInt(s57_b14 n, int width)
 {
 	if (width == 1) {
 		s57_b11 n1 = n;
-		as_fwrite(&n1, 1, 1, _fp);
+		write(&n1, 1);
 	}
 	else if (width == 2) {
 		s57_b12 n2 = n;
-		as_fwrite(&n2, 2, 1, _fp);
+		write(&n2, 2);
 	}
 	else if (width == 4)
-		as_fwrite(&n, 4, 1, _fp);
+		write(&n, 4);
 	else
 		assert(0);
 }
@@ -1005,30 +1114,30 @@ void S57Encoder::setSInt(s57_b24 n, int width)
 {
 	if (width == 1) {
 		s57_b21 n1 = n;
-		as_fwrite(&n1, 1, 1, _fp);
+		write(&n1, 1);
 	}
 	else if (width == 2) {
 		s57_b22 n2 = n;
-		as_fwrite(&n2, 2, 1, _fp);
+		write(&n2, 2);
 	}
 	else if (width == 4)
-		as_fwrite(&n, 4, 1, _fp);
+		write(&n, 4);
 	else
 		assert(0);
 }
 
 void S57Encoder::setString(std::string s, int ll, bool setUT)
 {
-	as_fwrite(s.data(), 1, s.size(), _fp);
+	write(s.data(), s.size());
 
 	if (setUT) {
 		if (ll == S57_LL2) {
 			s57_b12 ut2 = S57_UT;
-			as_fwrite(&ut2, 2, 1, _fp);
+			write(&ut2, 2);
 		}
 		else {
 			s57_b11 ut1 = S57_UT;
-			as_fwrite(&ut1, 1, 1, _fp);
+			write(&ut1, 1);
 		}
 	}
 }
@@ -1037,7 +1146,7 @@ void S57Encoder::setDate(const S57_Date &date)
 {
 	char sbuf[9];
 	snprintf(sbuf, 9, "%4d%02d%02d", date._year, date._month, date._day);
-	as_fwrite(sbuf, 1, 8, _fp);
+	write(sbuf, 8);
 }
 
 void S57Encoder::packName(const S57_NAME &name)
@@ -1055,17 +1164,17 @@ void S57Encoder::packLongName(const S57_LNAM &lname)
 
 void S57Encoder::writeBlock(const char *p, size_t sz)
 {
-	as_fwrite(p, 1, sz, _fp);
+	write(p, sz);
 }
 
 void S57Encoder::endField(int ll)
 {
 	if (ll == S57_LL2) {
 		s57_b12 ft2 = S57_FT;
-		as_fwrite(&ft2, 2, 1, _fp);
+		write(&ft2, 2);
 	}
 	else {
 		s57_b11 ft1 = S57_FT;
-		as_fwrite(&ft1, 1, 1, _fp);
+		write(&ft1, 1);
 	}
 }
@@ -2,6 +2,11 @@
 #define S57_FIELD_CODEC_H
 
 #include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+
+#include "s57_utils.h"
 #include "iso8211_gloabal.h"
 
 class S57Decoder;
@@ -23,6 +28,9 @@ public:
 
     friend bool operator==(const S57_NAME &, const S57_NAME &);
 
+    // Packs RCNM and RCID into one value, used as a hash key.
+    unsigned long long key() const;
+
     std::string toString() const;
 };
 
@@ -36,6 +44,11 @@ inline bool operator==(const S57_NAME & n1, const S57_NAME & n2)
     return n1._rcnm == n2._rcnm && n1._rcid == n2._rcid;
 }
 
+inline unsigned long long S57_NAME::key() const
+{
+    return (static_cast<unsigned long long>(_rcnm) << 32) | (_rcid & 0xffffffffUL);
+}
+
 /*
  * The LNAM subfield is used as a foreign pointer in
  * the encoding of relations between feature records.
@@ -53,6 +66,9 @@ public:
 
     friend bool operator==(const S57_LNAM &, const S57_LNAM &);
 
+    // Packs AGEN, FIDN and FIDS into one value, used as a hash key.
+    unsigned long long key() const;
+
     std::string toString(bool repeat = false) const;
 };
 
@@ -67,6 +83,12 @@ inline bool operator==(const S57_LNAM & ln1, const S57_LNAM & ln2)
     return (ln1._agen == ln2._agen) && (ln1._fidn == ln2._fidn) && (ln1._fids == ln2._fids);
 }
 
+inline unsigned long long S57_LNAM::key() const
+{
+    return (static_cast<unsigned long long>(_agen) << 48)
+         | (static_cast<unsigned long long>(_fidn & 0xffffffffUL) << 16) | _fids;
+}
+
 /*
  * A date subfield int the fom: YYYYMMDD
  */
@@ -89,31 +111,124 @@ inline S57_Date::S57_Date()
     , _day(0)
 {}
 
+/*
+ * Attribute value kept in a S57AttrPool.
+ * The numeric values are parsed on the first request and then cached.
+ */
+class ISO8211_EXPORT S57AttrValue
+{
+private:
+    std::string _str;
+
+    mutable bool   _hasInt;
+    mutable bool   _hasFloat;
+    mutable long   _int;
+    mutable double _float;
+
+public:
+    S57AttrValue(std::string_view);
+
+    const std::string & str() const;
+
+    long   toInt() const;
+    double toFloat() const;
+};
+
+inline S57AttrValue::S57AttrValue(std::string_view s)
+    : _str(s)
+    , _hasInt(false)
+    , _hasFloat(false)
+    , _int(0)
+    , _float(0.0)
+{}
+
+inline const std::string & S57AttrValue::str() const
+{
+    return _str;
+}
+
+/*
+ * Interning pool of the attribute values, shared by the records of a
+ * data set and its update cells. Each distinct value is stored once,
+ * and stays at the same address as long as the pool is alive.
+ * A pool is not thread-safe, it belongs to the thread parsing the data set,
+ * unless its numbers are resolved and no value is added any more. Its
+ * records may be released by any thread, as with a cached cell.
+ */
+class ISO8211_EXPORT S57AttrPool : public AtomicRefBase
+{
+private:
+    std::deque<S57AttrValue>                                        _values;
+    std::unordered_map<std::string_view, const S57AttrValue *>      _index;
+
+public:
+    // Returns the pooled value equal to s, adding it if not found
+    const S57AttrValue * intern(std::string_view s);
+
+    // Parses every value as numbers in advance, so toInt() and toFloat()
+    // only read the values afterwards.
+    void resolveNumbers();
+
+    size_t size() const;
+    // Returns an estimate of the memory held by the pool
+    size_t memoryUsage() const;
+};
+
+typedef Ref<S57AttrPool> S57AttrPoolRef;
+
+inline size_t S57AttrPool::size() const
+{
+    return _values.size();
+}
+
 /*
  * Attribute or national attribute field structure
  */
 class ISO8211_EXPORT S57_AttItem
 {
 public:
-    s57_b12     _attl;
-    std::string _atvl;
+    s57_b12              _attl;
+    const S57AttrValue * _value; // Value in the pool of the record
 
 public:
     S57_AttItem();
-    S57_AttItem(s57_b12 attl, std::string atvl);
+    S57_AttItem(s57_b12 attl, const S57AttrValue * value);
+
+    // Returns the attribute value (ATVL)
+    std::string_view atvl() const;
+
+    // Returns the attribute value as a number, parsed once per pooled value
+    long   intValue() const;
+    double floatValue() const;
 
     std::string toString(int llcode) const;
 };
 
 inline S57_AttItem::S57_AttItem()
     : _attl(0)
+    , _value(NULL)
 {}
 
-inline S57_AttItem::S57_AttItem(s57_b12 attl, std::string atvl)
+inline S57_AttItem::S57_AttItem(s57_b12 attl, const S57AttrValue * value)
     : _attl(attl)
-    , _atvl(atvl)
+    , _value(value)
 {}
 
+inline std::string_view S57_AttItem::atvl() const
+{
+    return _value != NULL ? std::string_view(_value->str()) : std::string_view();
+}
+
+inline long S57_AttItem::intValue() const
+{
+    return _value != NULL ? _value->toInt() : 0L;
+}
+
+inline double S57_AttItem::floatValue() const
+{
+    return _value != NULL ? _value->toFloat() : 0.0;
+}
+
 /*
  * Control field structure
  */
@@ -527,13 +642,16 @@ inline S57_SG3D::S57_SG3D(s57_b24 y, s57_b24 x, s57_b24 v)
 
 /*
  * S57 field decoder
+ *
+ * The field data is either copied into an own buffer (std::string) or
+ * borrowed (std::string_view), in which case it must outlive the decoding.
  */
 class ISO8211_EXPORT S57Decoder
 {
 private:
-    char * _buf;
-    char * _curptr;
-    char * _endptr;
+    char *       _buf;
+    const char * _curptr;
+    const char * _endptr;
 
 private:
     void init();
@@ -544,9 +662,11 @@ private:
 public:
     S57Decoder();
     S57Decoder(std::string);
+    S57Decoder(std::string_view);
     ~S57Decoder();
 
     void setFieldData(std::string);
+    void setFieldData(std::string_view);
 
     // Get signed integer with width number of bytes
     s57_b24 getSInt(int width);
@@ -558,6 +678,9 @@ public:
     // If len is -1, the result string is stopping at unit/field terminator.
     // The lexical level is indicated by ll.
     std::string getString(int ll, int len = -1);
+    // Same as getString(), but returns a view of the field data,
+    // which is valid as long as the field data is.
+    std::string_view getStringView(int ll, int len = -1);
 
     // Unpack S57_NAME structure from a 40-bit-string
     // The values must be stored in the "little-endian"
@@ -578,10 +701,17 @@ public:
 class ISO8211_EXPORT S57Encoder
 {
 private:
-    FILE * _fp;
+    FILE *        _fp;
+    std::string * _buf;     // Appended to instead of the file, if not NULL
+    size_t        _written; // Bytes written since constructed
+
+private:
+    void write(const void * p, size_t sz);
 
 public:
     S57Encoder(FILE * fp);
+    // Constructs a encoder appending to the buffer
+    S57Encoder(std::string * buf);
     ~S57Encoder();
 
     void setUInt(s57_b14 n, int width);
@@ -594,6 +724,13 @@ public:
     void writeBlock(const char * p, size_t sz);
 
     void endField(int ll = S57_LL0);
+
+    size_t written() const;
 };
 
+inline size_t S57Encoder::written() const
+{
+    return _written;
+}
+
 #endif
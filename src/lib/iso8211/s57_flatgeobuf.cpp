@@ -0,0 +1,615 @@
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+
+#include "mapped_file.h"
+#include "s57_flatgeobuf.h"
+
+using namespace std;
+
+// FlatGeobuf 3.0, the integers and doubles are little-endian, as the
+// host is assumed to be.
+static const char FGB_MAGIC[8] = { 'f', 'g', 'b', 3, 'f', 'g', 'b', 0 };
+
+// GeometryType
+static const uint8_t FGB_UNKNOWN = 0;
+static const uint8_t FGB_POINT = 1;
+static const uint8_t FGB_LINESTRING = 2;
+static const uint8_t FGB_POLYGON = 3;
+static const uint8_t FGB_MULTIPOINT = 4;
+static const uint8_t FGB_MULTILINESTRING = 5;
+
+// ColumnType
+static const uint8_t FGB_LONG = 7;
+static const uint8_t FGB_STRING = 11;
+
+// Field ids of the tables used
+enum
+{
+	HEADER_ENVELOPE = 1,
+	HEADER_GEOMETRY_TYPE = 2,
+	HEADER_HAS_Z = 3,
+	HEADER_COLUMNS = 7,
+	HEADER_FEATURES_COUNT = 8,
+	HEADER_INDEX_NODE_SIZE = 9,
+	HEADER_CRS = 10,
+	COLUMN_NAME = 0,
+	COLUMN_TYPE = 1,
+	CRS_ORG = 0,
+	CRS_CODE = 1,
+	GEOMETRY_ENDS = 0,
+	GEOMETRY_XY = 1,
+	GEOMETRY_Z = 2,
+	GEOMETRY_TYPE = 6,
+	FEATURE_GEOMETRY = 0,
+	FEATURE_PROPERTIES = 1
+};
+
+/*
+ * Table being encoded, the scalar fields with their values and the
+ * offset fields, positioned once the table is written.
+ */
+class FbTable
+{
+public:
+	struct Field
+	{
+		int      id;
+		size_t   size; // 0 for an offset
+		uint64_t bits;
+		size_t   pos;
+	};
+
+	vector<Field> _fields;
+
+public:
+	template <typename T>
+	void add(int id, T v)
+	{
+		Field f = { id, sizeof(T), 0, 0 };
+		memcpy(&f.bits, &v, sizeof(T));
+		_fields.push_back(f);
+	}
+
+	void addOffset(int id)
+	{
+		Field f = { id, 0, 0, 0 };
+		_fields.push_back(f);
+	}
+
+	// Returns the position of the field in the buffer
+	size_t pos(int id) const
+	{
+		for (size_t i = 0; i < _fields.size(); ++i) {
+			if (_fields[i].id == id)
+				return _fields[i].pos;
+		}
+		return 0;
+	}
+};
+
+/*
+ * FlatBuffers encoder laid out front to back. A table is written with
+ * its vtable ahead and its offset fields empty, then the strings, vectors
+ * and tables they refer to are appended, and the offsets linked.
+ * The alignment is relative to the start of the buffer, its size prefix
+ * included, as the FlatBuffers builder does.
+ */
+class FbBuilder
+{
+private:
+	string *_buf;
+
+public:
+	FbBuilder(string *buf) : _buf(buf) {}
+
+	size_t pos() const { return _buf->size(); }
+
+	// Pads until pos() + extra is a multiple of align
+	void pad(size_t align, size_t extra = 0)
+	{
+		while ((pos() + extra) % align != 0)
+			_buf->push_back(0);
+	}
+
+	template <typename T>
+	void put(T v)
+	{
+		_buf->append(reinterpret_cast<const char *>(&v), sizeof(T));
+	}
+
+	template <typename T>
+	void patch(size_t at, T v)
+	{
+		memcpy(&(*_buf)[at], &v, sizeof(T));
+	}
+
+	// Points the offset at 'at' to target, which follows it
+	void link(size_t at, size_t target)
+	{
+		patch<uint32_t>(at, target - at);
+	}
+
+	size_t putTable(FbTable &t);
+
+	void putString(size_t field, const string &s)
+	{
+		pad(4);
+		link(field, pos());
+		put<uint32_t>(s.size());
+		_buf->append(s);
+		_buf->push_back(0);
+	}
+
+	template <typename T>
+	void putVector(size_t field, const T *v, size_t n)
+	{
+		pad(sizeof(T) > 4 ? sizeof(T) : 4, 4);
+		link(field, pos());
+		put<uint32_t>(n);
+		_buf->append(reinterpret_cast<const char *>(v), n * sizeof(T));
+	}
+};
+
+static bool largerField(const FbTable::Field &a, const FbTable::Field &b)
+{
+	size_t sa = a.size == 0 ? 4 : a.size;
+	size_t sb = b.size == 0 ? 4 : b.size;
+	return sa > sb;
+}
+
+size_t FbBuilder::putTable(FbTable &t)
+{
+	// the largest fields first, each is aligned after the soffset
+	stable_sort(t._fields.begin(), t._fields.end(), largerField);
+
+	int maxId = -1;
+	bool has8 = false;
+	for (size_t i = 0; i < t._fields.size(); ++i) {
+		maxId = max(maxId, t._fields[i].id);
+		has8 = has8 || t._fields[i].size == 8;
+	}
+
+	size_t vtSize = 4 + 2 * (maxId + 1);
+	vector<uint16_t> vt(maxId + 1, 0);
+	size_t off = 4;
+	for (size_t i = 0; i < t._fields.size(); ++i) {
+		vt[t._fields[i].id] = off;
+		off += t._fields[i].size == 0 ? 4 : t._fields[i].size;
+	}
+
+	pad(2);
+	size_t vtPos = pos();
+	put<uint16_t>(vtSize);
+	put<uint16_t>(off);
+	for (size_t i = 0; i < vt.size(); ++i)
+		put<uint16_t>(vt[i]);
+
+	if (has8)
+		pad(8, 4);
+	else
+		pad(4);
+	size_t tablePos = pos();
+	put<int32_t>(tablePos - vtPos);
+
+	for (size_t i = 0; i < t._fields.size(); ++i) {
+		FbTable::Field &f = t._fields[i];
+		f.pos = pos();
+		if (f.size == 0)
+			put<uint32_t>(0);
+		else
+			_buf->append(reinterpret_cast<const char *>(&f.bits), f.size);
+	}
+
+	return tablePos;
+}
+
+// Returns the index of (x, y) on the Hilbert curve of 2^16 x 2^16 cells
+static uint32_t hilbert(uint32_t x, uint32_t y)
+{
+	uint32_t a = x ^ y;
+	uint32_t b = 0xFFFF ^ a;
+	uint32_t c = 0xFFFF ^ (x | y);
+	uint32_t d = x & (y ^ 0xFFFF);
+
+	uint32_t A = a | (b >> 1);
+	uint32_t B = (a >> 1) ^ a;
+	uint32_t C = ((c >> 1) ^ (b & (d >> 1))) ^ c;
+	uint32_t D = ((a & (c >> 1)) ^ (d >> 1)) ^ d;
+
+	a = A; b = B; c = C; d = D;
+	A = ((a & (a >> 2)) ^ (b & (b >> 2)));
+	B = ((a & (b >> 2)) ^ (b & ((a ^ b) >> 2)));
+	C ^= ((a & (c >> 2)) ^ (b & (d >> 2)));
+	D ^= ((b & (c >> 2)) ^ ((a ^ b) & (d >> 2)));
+
+	a = A; b = B; c = C; d = D;
+	A = ((a & (a >> 4)) ^ (b & (b >> 4)));
+	B = ((a & (b >> 4)) ^ (b & ((a ^ b) >> 4)));
+	C ^= ((a & (c >> 4)) ^ (b & (d >> 4)));
+	D ^= ((b & (c >> 4)) ^ ((a ^ b) & (d >> 4)));
+
+	a = A; b = B; c = C; d = D;
+	C ^= ((a & (c >> 8)) ^ (b & (d >> 8)));
+	D ^= ((b & (c >> 8)) ^ ((a ^ b) & (d >> 8)));
+
+	a = C ^ (C >> 1);
+	b = D ^ (D >> 1);
+
+	uint32_t i0 = x ^ y;
+	uint32_t i1 = b | (0xFFFF ^ (i0 | a));
+
+	i0 = (i0 | (i0 << 8)) & 0x00FF00FF;
+	i0 = (i0 | (i0 << 4)) & 0x0F0F0F0F;
+	i0 = (i0 | (i0 << 2)) & 0x33333333;
+	i0 = (i0 | (i0 << 1)) & 0x55555555;
+
+	i1 = (i1 | (i1 << 8)) & 0x00FF00FF;
+	i1 = (i1 | (i1 << 4)) & 0x0F0F0F0F;
+	i1 = (i1 | (i1 << 2)) & 0x33333333;
+	i1 = (i1 | (i1 << 1)) & 0x55555555;
+
+	return (i1 << 1) | i0;
+}
+
+// S57FlatGeobufBackend members
+
+S57FlatGeobufBackend::S57FlatGeobufBackend(int nodeSize)
+	: S57ExportBackend()
+{
+	_nodeSize = nodeSize < 2 ? 0 : min(nodeSize, 65535);
+	_geomType = FGB_UNKNOWN;
+	_hasZ = false;
+}
+
+S57FlatGeobufBackend::~S57FlatGeobufBackend()
+{
+	close();
+}
+
+S57ExportBackend *S57FlatGeobufBackend::clone() const
+{
+	return new S57FlatGeobufBackend(_nodeSize);
+}
+
+void S57FlatGeobufBackend::doOpen(const string &name, int)
+{
+	close();
+
+	_name = name;
+	_tmp = new S57ExportWriter;
+	_tmp->open(_name + ".fgb.tmp");
+	_items.clear();
+	_columns.clear();
+	_columnIndex.clear();
+	_columns.push_back("FeatureID");
+	_geomType = -1;
+	_hasZ = true;
+}
+
+bool S57FlatGeobufBackend::isOpen() const
+{
+	return !_tmp.isNull();
+}
+
+void S57FlatGeobufBackend::close()
+{
+	if (_tmp.isNull())
+		return;
+
+	_tmp->close();
+	_tmp.release();
+	writeFile();
+	remove((_name + ".fgb.tmp").c_str());
+
+	vector<Item>().swap(_items);
+}
+
+uint16_t S57FlatGeobufBackend::columnIndex(const string &name)
+{
+	unordered_map<string, uint16_t>::const_iterator it = _columnIndex.find(name);
+	if (it != _columnIndex.end())
+		return it->second;
+
+	if (_columns.size() >= 0xFFFF) {
+		fprintf(stderr, "%s.fgb: too many columns\n", _name.c_str());
+		return 0xFFFF;
+	}
+
+	uint16_t i = _columns.size();
+	_columns.push_back(name);
+	_columnIndex[name] = i;
+	return i;
+}
+
+void S57FlatGeobufBackend::encodeProperties(const S57ExportFeature &f)
+{
+	_props.clear();
+	FbBuilder b(&_props);
+
+	b.put<uint16_t>(0);
+	b.put<int64_t>(f._record->fieldFRID()->_name._rcid);
+
+	// ATTF then NATF, in the order of the record
+	const vector<S57_AttItem> *atts[] = { &f._record->fieldsATTF(), &f._record->fieldsNATF() };
+	int llcodes[] = { f._record->aall(), f._record->nall() };
+	for (int k = 0; k < 2; ++k) {
+		vector<S57_AttItem>::const_iterator it = atts[k]->begin();
+		for (; it != atts[k]->end(); ++it) {
+			uint16_t col = columnIndex(attributeName(*it));
+			if (col == 0xFFFF)
+				continue;
+			string v = attributeValue(*it, llcodes[k]);
+			b.put<uint16_t>(col);
+			b.put<uint32_t>(v.size());
+			_props.append(v);
+		}
+	}
+}
+
+void S57FlatGeobufBackend::encodeFeature(const S57ExportFeature &f, int geomType)
+{
+	_fbuf.clear();
+	FbBuilder b(&_fbuf);
+
+	// size prefix and root offset
+	b.put<uint32_t>(0);
+	b.put<uint32_t>(0);
+
+	FbTable ft;
+	ft.addOffset(FEATURE_GEOMETRY);
+	ft.addOffset(FEATURE_PROPERTIES);
+	b.link(4, b.putTable(ft));
+
+	bool hasEnds = (geomType == FGB_POLYGON || geomType == FGB_MULTILINESTRING) && f._ends.size() > 1;
+	FbTable gt;
+	if (hasEnds)
+		gt.addOffset(GEOMETRY_ENDS);
+	gt.addOffset(GEOMETRY_XY);
+	if (!f._zs.empty())
+		gt.addOffset(GEOMETRY_Z);
+	gt.add<uint8_t>(GEOMETRY_TYPE, geomType);
+	b.link(ft.pos(FEATURE_GEOMETRY), b.putTable(gt));
+
+	if (hasEnds) {
+		vector<uint32_t> ends(f._ends.begin(), f._ends.end());
+		b.putVector<uint32_t>(gt.pos(GEOMETRY_ENDS), ends.data(), ends.size());
+	}
+
+	_dbuf.resize(f._xy.size());
+	for (size_t i = 0; i < f._xy.size(); ++i)
+		_dbuf[i] = coord(f._xy[i]);
+	b.putVector<double>(gt.pos(GEOMETRY_XY), _dbuf.data(), _dbuf.size());
+
+	if (!f._zs.empty()) {
+		_dbuf.resize(f._zs.size());
+		for (size_t i = 0; i < f._zs.size(); ++i)
+			_dbuf[i] = depth(f._zs[i]);
+		b.putVector<double>(gt.pos(GEOMETRY_Z), _dbuf.data(), _dbuf.size());
+	}
+
+	b.putVector<uint8_t>(ft.pos(FEATURE_PROPERTIES),
+			reinterpret_cast<const uint8_t *>(_props.data()), _props.size());
+
+	b.patch<uint32_t>(0, b.pos() - 4);
+}
+
+void S57FlatGeobufBackend::write(const S57ExportFeature &f)
+{
+	if (f.pointCount() == 0)
+		return;
+
+	int geomType;
+	switch (f._type) {
+	case S57ExportFeature::POINT:
+		geomType = f.pointCount() == 1 ? FGB_POINT : FGB_MULTIPOINT;
+		break;
+	case S57ExportFeature::SOUNDING:
+		geomType = FGB_MULTIPOINT;
+		break;
+	case S57ExportFeature::LINE:
+		geomType = f._ends.size() == 1 ? FGB_LINESTRING : FGB_MULTILINESTRING;
+		break;
+	default:
+		geomType = FGB_POLYGON;
+		break;
+	}
+
+	if (_geomType == -1)
+		_geomType = geomType;
+	else if (_geomType != geomType)
+		_geomType = FGB_UNKNOWN;
+	_hasZ = _hasZ && !f._zs.empty();
+
+	encodeProperties(f);
+	encodeFeature(f, geomType);
+
+	Item item;
+	item.minX = item.maxX = coord(f._xy[0]);
+	item.minY = item.maxY = coord(f._xy[1]);
+	for (size_t i = 1; i < f.pointCount(); ++i) {
+		double x = coord(f._xy[i * 2]);
+		double y = coord(f._xy[i * 2 + 1]);
+		item.minX = min(item.minX, x);
+		item.maxX = max(item.maxX, x);
+		item.minY = min(item.minY, y);
+		item.maxY = max(item.maxY, y);
+	}
+	item.pos = _tmp->position();
+	item.size = _fbuf.size();
+	item.hilbert = 0;
+	_items.push_back(item);
+
+	_tmp->put(_fbuf);
+}
+
+void S57FlatGeobufBackend::encodeHeader(string &buf) const
+{
+	FbBuilder b(&buf);
+	b.put<uint32_t>(0);
+	b.put<uint32_t>(0);
+
+	FbTable ht;
+	if (!_items.empty())
+		ht.addOffset(HEADER_ENVELOPE);
+	ht.add<uint8_t>(HEADER_GEOMETRY_TYPE, _geomType < 0 ? FGB_UNKNOWN : _geomType);
+	ht.add<uint8_t>(HEADER_HAS_Z, _hasZ && !_items.empty());
+	ht.addOffset(HEADER_COLUMNS);
+	ht.add<uint64_t>(HEADER_FEATURES_COUNT, _items.size());
+	ht.add<uint16_t>(HEADER_INDEX_NODE_SIZE, _items.empty() ? 0 : _nodeSize);
+	ht.addOffset(HEADER_CRS);
+	b.link(4, b.putTable(ht));
+
+	if (!_items.empty()) {
+		double env[4] = { _items[0].minX, _items[0].minY, _items[0].maxX, _items[0].maxY };
+		for (size_t i = 1; i < _items.size(); ++i) {
+			env[0] = min(env[0], _items[i].minX);
+			env[1] = min(env[1], _items[i].minY);
+			env[2] = max(env[2], _items[i].maxX);
+			env[3] = max(env[3], _items[i].maxY);
+		}
+		b.putVector<double>(ht.pos(HEADER_ENVELOPE), env, 4);
+	}
+
+	// the vector of the columns, then each column and its name
+	b.pad(4);
+	b.link(ht.pos(HEADER_COLUMNS), b.pos());
+	b.put<uint32_t>(_columns.size());
+	size_t slots = b.pos();
+	for (size_t i = 0; i < _columns.size(); ++i)
+		b.put<uint32_t>(0);
+	for (size_t i = 0; i < _columns.size(); ++i) {
+		FbTable ct;
+		ct.addOffset(COLUMN_NAME);
+		ct.add<uint8_t>(COLUMN_TYPE, i == 0 ? FGB_LONG : FGB_STRING);
+		b.link(slots + i * 4, b.putTable(ct));
+		b.putString(ct.pos(COLUMN_NAME), _columns[i]);
+	}
+
+	FbTable crs;
+	crs.addOffset(CRS_ORG);
+	crs.add<int32_t>(CRS_CODE, 4326);
+	b.link(ht.pos(HEADER_CRS), b.putTable(crs));
+	b.putString(crs.pos(CRS_ORG), "EPSG");
+
+	b.patch<uint32_t>(0, b.pos() - 4);
+}
+
+void S57FlatGeobufBackend::writeIndex(S57ExportWriter *w)
+{
+	// Level bounds in the node array, the leaves first, stored after
+	// the upper levels, the root at 0.
+	vector<uint64_t> levelNodes;
+	uint64_t n = _items.size();
+	uint64_t nodeCount = n;
+	levelNodes.push_back(n);
+	do {
+		n = (n + _nodeSize - 1) / _nodeSize;
+		nodeCount += n;
+		levelNodes.push_back(n);
+	} while (n != 1);
+
+	vector<uint64_t> levelBegin;
+	n = nodeCount;
+	for (size_t i = 0; i < levelNodes.size(); ++i)
+		levelBegin.push_back(n -= levelNodes[i]);
+
+	vector<double> boxes(nodeCount * 4);
+	vector<uint64_t> offsets(nodeCount);
+
+	// the leaves, at the offsets of the features after the index
+	uint64_t pos = 0;
+	for (size_t i = 0; i < _items.size(); ++i) {
+		size_t k = levelBegin[0] + i;
+		boxes[k * 4] = _items[i].minX;
+		boxes[k * 4 + 1] = _items[i].minY;
+		boxes[k * 4 + 2] = _items[i].maxX;
+		boxes[k * 4 + 3] = _items[i].maxY;
+		offsets[k] = pos;
+		pos += _items[i].size;
+	}
+
+	// each parent is the extent of its children, pointing to the first one
+	for (size_t l = 0; l + 1 < levelNodes.size(); ++l) {
+		uint64_t child = levelBegin[l];
+		uint64_t end = child + levelNodes[l];
+		uint64_t parent = levelBegin[l + 1];
+		for (; child < end; ++parent) {
+			offsets[parent] = child;
+			double *pb = &boxes[parent * 4];
+			pb[0] = pb[1] = HUGE_VAL;
+			pb[2] = pb[3] = -HUGE_VAL;
+			for (int j = 0; j < _nodeSize && child < end; ++j, ++child) {
+				const double *cb = &boxes[child * 4];
+				pb[0] = min(pb[0], cb[0]);
+				pb[1] = min(pb[1], cb[1]);
+				pb[2] = max(pb[2], cb[2]);
+				pb[3] = max(pb[3], cb[3]);
+			}
+		}
+	}
+
+	for (uint64_t k = 0; k < nodeCount; ++k) {
+		w->put(reinterpret_cast<const char *>(&boxes[k * 4]), 4 * sizeof(double));
+		w->put(reinterpret_cast<const char *>(&offsets[k]), sizeof(uint64_t));
+	}
+}
+
+bool S57FlatGeobufBackend::lessHilbert(const Item &a, const Item &b)
+{
+	return a.hilbert < b.hilbert;
+}
+
+void S57FlatGeobufBackend::writeFile()
+{
+	if (_nodeSize != 0 && !_items.empty()) {
+		double minX = _items[0].minX, minY = _items[0].minY;
+		double maxX = _items[0].maxX, maxY = _items[0].maxY;
+		for (size_t i = 1; i < _items.size(); ++i) {
+			minX = min(minX, _items[i].minX);
+			minY = min(minY, _items[i].minY);
+			maxX = max(maxX, _items[i].maxX);
+			maxY = max(maxY, _items[i].maxY);
+		}
+
+		// Hilbert index of the center of each feature in the extent
+		double width = maxX - minX;
+		double height = maxY - minY;
+		for (size_t i = 0; i < _items.size(); ++i) {
+			Item &it = _items[i];
+			uint32_t x = 0, y = 0;
+			if (width != 0.0)
+				x = floor(0xFFFF * ((it.minX + it.maxX) / 2 - minX) / width);
+			if (height != 0.0)
+				y = floor(0xFFFF * ((it.minY + it.maxY) / 2 - minY) / height);
+			it.hilbert = hilbert(x, y);
+		}
+		stable_sort(_items.begin(), _items.end(), lessHilbert);
+	}
+
+	MappedFileRef map = new MappedFile;
+	if (!_items.empty() && !map->open(_name + ".fgb.tmp")) {
+		fprintf(stderr, "%s.fgb: cannot read the features back\n", _name.c_str());
+		return;
+	}
+
+	S57ExportWriterRef out = new S57ExportWriter;
+	out->open(_name + ".fgb");
+	out->put(FGB_MAGIC, sizeof(FGB_MAGIC));
+
+	string hdr;
+	encodeHeader(hdr);
+	out->put(hdr);
+
+	if (_nodeSize != 0 && !_items.empty())
+		writeIndex(out.getPtr());
+
+	for (size_t i = 0; i < _items.size(); ++i)
+		out->put(map->data() + _items[i].pos, _items[i].size);
+
+	out->close();
+}
+
+// ~
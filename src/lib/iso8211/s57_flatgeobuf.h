@@ -0,0 +1,91 @@
+#ifndef S57_FLATGEOBUF_H
+#define S57_FLATGEOBUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "s57_exportbackend.h"
+#include "iso8211_gloabal.h"
+
+/*
+ * FlatGeobuf file (.fgb) with a packed Hilbert R-tree index, in WGS 84.
+ * The index precedes the features in the file and orders them along the
+ * Hilbert curve, so the features are encoded to a temporary file as they
+ * come, and only their extents are kept until close() assembles the file.
+ *
+ * The columns are FeatureID, then the attributes as strings in the order
+ * they are first met. The depths of the soundings are their Z.
+ */
+class ISO8211_EXPORT S57FlatGeobufBackend : public S57ExportBackend
+{
+private:
+    // Feature encoded in the temporary file
+    struct Item
+    {
+        double   minX;
+        double   minY;
+        double   maxX;
+        double   maxY;
+        uint64_t pos;
+        uint32_t size;
+        uint32_t hilbert;
+    };
+
+    int                                       _nodeSize;
+    std::string                               _name;       // Output file name, without extension
+    S57ExportWriterRef                        _tmp;
+    std::vector<Item>                         _items;
+    std::vector<std::string>                  _columns;
+    std::unordered_map<std::string, uint16_t> _columnIndex;
+    int                                       _geomType;   // Of all the features, 0 if mixed
+    bool                                      _hasZ;       // All the features have Z
+
+    // Buffers of the feature being encoded
+    std::string         _fbuf;
+    std::string         _props;
+    std::vector<double> _dbuf;
+
+private:
+    void doOpen(const std::string & name, int objl);
+
+    uint16_t columnIndex(const std::string & name);
+    void     encodeProperties(const S57ExportFeature &);
+    void     encodeFeature(const S57ExportFeature &, int geomType);
+    void     encodeHeader(std::string & buf) const;
+    void     writeIndex(S57ExportWriter *);
+    void     writeFile();
+
+    static bool lessHilbert(const Item &, const Item &);
+
+    S57FlatGeobufBackend(const S57FlatGeobufBackend &);
+    S57FlatGeobufBackend & operator=(const S57FlatGeobufBackend &);
+
+public:
+    // Constructs a backend of the R-tree node size, 0 for no index
+    S57FlatGeobufBackend(int nodeSize = 16);
+    ~S57FlatGeobufBackend();
+
+    int indexNodeSize() const;
+
+    S57ExportBackend * clone() const;
+
+    void close();
+    bool isOpen() const;
+
+    void write(const S57ExportFeature &);
+};
+
+// S57FlatGeobufBackend inline functions
+
+inline int S57FlatGeobufBackend::indexNodeSize() const
+{
+    return _nodeSize;
+}
+
+// ~
+
+#endif
@@ -15,6 +15,9 @@ using namespace std;
 void S57Module::init()
 {
 	_fp = NULL;
+	_mapPos = 0;
+	_lazyDecoding = false;
+	_attrPool = new S57AttrPool;
 }
 
 S57Module::S57Module()
@@ -23,11 +26,11 @@ S57Module::S57Module()
 	init();
 }
 
-S57Module::S57Module(string fileName)
+S57Module::S57Module(string fileName, bool mapped)
 	: RefBase()
 {
 	init();
-	open(fileName);
+	open(fileName, mapped);
 }
 
 S57Module::~S57Module()
@@ -35,17 +38,27 @@ S57Module::~S57Module()
 	close();
 }
 
-bool S57Module::open(string fileName)
+bool S57Module::open(string fileName, bool mapped)
 {
 	if (isOpen())
 		close();
 
 	_fileName = fileName;
 
-	_fp = fopen(fileName.c_str(), "rb");
-	if (_fp == NULL) {
-		fprintf(stderr, "%s: %s\n", fileName.c_str(), strerror(errno));
-		return false;
+	if (mapped) {
+		_map = new MappedFile;
+		if (!_map->open(fileName)) {
+			_map.release();
+			return false;
+		}
+		_mapPos = 0;
+	}
+	else {
+		_fp = fopen(fileName.c_str(), "rb");
+		if (_fp == NULL) {
+			fprintf(stderr, "%s: %s\n", fileName.c_str(), strerror(errno));
+			return false;
+		}
 	}
 
 	int flags = 0xf; // CATD|DSAC|DSPM|DSID
@@ -91,7 +104,9 @@ bool S57Module::open(string fileName)
 		}
 	}
 
-	rewind(_fp);
+	if (_fp != NULL)
+		rewind(_fp);
+	_mapPos = 0;
 	return true;
 }
 
@@ -101,11 +116,16 @@ void S57Module::close()
 		fclose(_fp);
 
 	_fp = NULL;
+	_map.release();
+	_mapPos = 0;
 	_fileName.clear();
 }
 
 bool S57Module::atEnd() const
 {
+	if (!_map.isNull())
+		return _mapPos >= _map->size();
+
 	int c = fgetc(_fp);
 	bool res = (c == EOF);
 	ungetc(c, _fp);
@@ -128,36 +148,61 @@ int S57Module::nall() const
 		return S57_LL1;
 }
 
-S57RecordRef S57Module::getNextRecord()
+string_view S57Module::nextRecordSpan()
 {
-	S57RecordRef r;
-	int ret;
+	// the record length is the first 5 digits of the leader
+	if (!_map.isNull()) {
+		const size_t left = _map->size() - _mapPos;
+		if (left == 0)
+			return string_view();
+
+		const char *p = _map->data() + _mapPos;
+		size_t reclen = 0;
+		for (int i = 0; i < 5 && i < static_cast<int>(left); ++i)
+			reclen = reclen * 10 + (p[i] - '0');
+		if (left < 5 || reclen < 24 || reclen > left) {
+			fprintf(stderr, "%s: broken record at %lu\n", _fileName.c_str(), 
+					static_cast<unsigned long>(_mapPos));
+			_mapPos = _map->size();
+			return string_view();
+		}
+
+		_mapPos += reclen;
+		return string_view(p, reclen);
+	}
 
 	// read record length
-	int posSave = ftell(_fp);
 	char numbuf[8];
-	if ((ret = fread(numbuf, 1, 5, _fp)) != 5) {
+	if (fread(numbuf, 1, 5, _fp) != 5) {
 		if (ferror(_fp))
 			fprintf(stderr, "File I/O error: %s\n", strerror(errno));
-		return NULL;
+		return string_view();
 	}
 	numbuf[5] = 0;
 
-	// read the whole record
+	// read the rest of the record after the length
 	const int reclen = atoi(numbuf);
-	char *recbuf = new char [reclen];
-	if (recbuf == NULL)
-		return NULL;
+	if (reclen < 24) {
+		fprintf(stderr, "%s: broken record length %s\n", _fileName.c_str(), numbuf);
+		return string_view();
+	}
 
-	fseek(_fp, posSave, SEEK_SET);
-	if ((ret = fread(recbuf, 1, reclen, _fp)) != reclen) {
+	_recbuf.resize(reclen);
+	memcpy(&_recbuf[0], numbuf, 5);
+	if (static_cast<int>(fread(&_recbuf[5], 1, reclen - 5, _fp)) != reclen - 5) {
 		if (ferror(_fp))
 			fprintf(stderr, "File I/O error: %s\n", strerror(errno));
+		return string_view();
 	}
-	else
-		r = S57Record::decode(string(recbuf, reclen), this);
 
-	delete[] recbuf;
-	return r;
+	return string_view(_recbuf.data(), reclen);
 }
 
+S57RecordRef S57Module::getNextRecord()
+{
+	string_view data = nextRecordSpan();
+	if (data.empty())
+		return NULL;
+
+	return S57Record::decode(data, this);
+}
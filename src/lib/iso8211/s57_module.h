@@ -4,9 +4,11 @@
 #include <stdio.h>
 
 #include <string>
+#include <string_view>
 
 #include "s57_utils.h"
 #include "s57_record.h"
+#include "mapped_file.h"
 #include "iso8211_gloabal.h"
 
 class ISO8211_EXPORT S57Module : public RefBase
@@ -15,6 +17,17 @@ private:
 	FILE *_fp;
 	std::string _fileName;
 
+	// Memory mapped mode: records are handed out as spans of the mapping
+	MappedFileRef _map;
+	size_t _mapPos;
+
+	// Record buffer of the stdio mode, reused across records
+	std::string _recbuf;
+
+	bool _lazyDecoding;
+
+	S57AttrPoolRef _attrPool;
+
 	Ref<S57DataDescripRecord> _ddr;
 	Ref<S57DSInfoRecord> _dr_dsInfo;
 	Ref<S57DSGeoRecord> _dr_dsGeo;
@@ -26,17 +39,33 @@ private:
 
 public:
 	S57Module();
-	S57Module(std::string fileName);
+	S57Module(std::string fileName, bool mapped = false);
 	~S57Module();
 
-	bool open(std::string fileName);
+	// If mapped is true, the file is memory mapped and records are
+	// decoded straight from the mapping without copying.
+	bool open(std::string fileName, bool mapped = false);
 	void close();
 
 	bool isOpen() const;
+	bool isMapped() const;
 	bool atEnd() const;
 
 	std::string fileName() const;
 
+	// If lazy decoding is on, feature and vector records decode their
+	// identifier (FRID, VRID) only, the other fields are decoded from the
+	// retained field area the first time one of them is accessed.
+	// A record is then not to be shared between threads before accessed.
+	bool lazyDecoding() const;
+	void setLazyDecoding(bool);
+
+	// The attribute values of the records are interned in this pool.
+	// Each module has its own one, unless it's shared with others,
+	// like a data set and its update cells.
+	S57AttrPoolRef attrPool() const;
+	void setAttrPool(S57AttrPoolRef);
+
 	Ref<S57DataDescripRecord> ddr() const;
 	Ref<S57DSInfoRecord> generalInfoRecord() const;
 	Ref<S57DSGeoRecord> geographicRecord() const;
@@ -47,6 +76,14 @@ public:
 	int aall() const;
 	int nall() const;
 
+	// Returns the mapping of a module opened in mapped mode
+	MappedFileRef mapping() const;
+
+	// Returns the raw data of the next record, an empty span at the end.
+	// The span is valid until the next call in stdio mode, and as long as
+	// the mapping is alive in mapped mode.
+	std::string_view nextRecordSpan();
+
 	S57RecordRef getNextRecord();
 };
 
@@ -55,8 +92,26 @@ public:
 inline std::string S57Module::fileName() const
 { return _fileName; }
 
+inline bool S57Module::lazyDecoding() const
+{ return _lazyDecoding; }
+
+inline void S57Module::setLazyDecoding(bool on)
+{ _lazyDecoding = on; }
+
+inline S57AttrPoolRef S57Module::attrPool() const
+{ return _attrPool; }
+
+inline void S57Module::setAttrPool(S57AttrPoolRef pool)
+{ _attrPool = pool; }
+
 inline bool S57Module::isOpen() const
-{ return _fp != NULL; }
+{ return _fp != NULL || !_map.isNull(); }
+
+inline bool S57Module::isMapped() const
+{ return !_map.isNull(); }
+
+inline MappedFileRef S57Module::mapping() const
+{ return _map; }
 
 inline Ref<S57DataDescripRecord> S57Module::ddr() const
 { return _ddr; }
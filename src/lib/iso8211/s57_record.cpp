@@ -15,15 +15,28 @@ using namespace std;
 // Update utils
 
 void updateAttributes(std::vector<S57_AttItem> &dst, 
-				const std::vector<S57_AttItem> &src);
+				const std::vector<S57_AttItem> &src, S57AttrPool *);
 
 template <class T>
 void updatePointers(std::vector<T> &dst, 
 				const std::vector<T> &src, 
 				const S57_UpdControl *);
 
-void updateCoords(vector<s57_b24> &dst, const vector<s57_b24> &src, 
-				int pairSize, const S57_UpdControl *);
+void updateCoords(S57CoordArray &dst, const S57CoordArray &src, 
+				const S57_UpdControl *);
+
+// Converts n ascii digits like atoi() does, without copying them
+static size_t digitsToInt(const char *p, size_t n)
+{
+	size_t i = 0;
+	while (i < n && p[i] == ' ')
+		++i;
+
+	size_t val = 0;
+	for (; i < n && p[i] >= '0' && p[i] <= '9'; ++i)
+		val = val * 10 + (p[i] - '0');
+	return val;
+}
 
 // LRLeader members
 
@@ -44,16 +57,16 @@ LRLeader::LRLeader()
 	_szFieldPos = 0;
 }
 
-LRLeader::LRLeader(string data)
+LRLeader::LRLeader(string_view data)
 {
-	_recordLength = atoi(data.substr(0, 5).c_str());
+	_recordLength = digitsToInt(data.data(), 5);
 	_interchangeLevel = data[5];
 	_leaderIdentifier = data[6];
 	_extensionIndicator = data[7];
 	_versionNumber = data[8];
 	_applicationIndicator = data[9];
-	_fieldControlLength = atoi(data.substr(10, 2).c_str());
-	_fieldAreaOffset = atoi(data.substr(12, 5).c_str());
+	_fieldControlLength = digitsToInt(data.data() + 10, 2);
+	_fieldAreaOffset = digitsToInt(data.data() + 12, 5);
 	_charSetIndicator[0] = data[17];
 	_charSetIndicator[1] = data[18];
 	_charSetIndicator[2] = data[19];
@@ -105,25 +118,31 @@ LRHeader::LRHeader()
 {
 }
 
-LRHeader::LRHeader(string data)
+LRHeader::LRHeader(string_view data)
 	: RefBase(), _leader(data)
 {
 	// decode directory
-	const int dirCount = (_leader._fieldAreaOffset - 24)
-							/ (_leader._szFieldLen + _leader._szFieldPos + FIELD_TAG_SIZE);
+	const size_t entrySize = _leader._szFieldLen + _leader._szFieldPos + FIELD_TAG_SIZE;
+	if (_leader._fieldAreaOffset < 24 || _leader._fieldAreaOffset > data.size()) {
+		fprintf(stderr, "Broken record leader, field area at %u\n", 
+				static_cast<unsigned>(_leader._fieldAreaOffset));
+		return;
+	}
+	const int dirCount = (_leader._fieldAreaOffset - 24) / entrySize;
 	_dir.resize(dirCount);
 
-	int pos = 24;
+	const char *p = data.data() + 24;
 	for (int i = 0; i < dirCount; ++i) {
-		strcpy(_dir[i]._fieldTag, data.substr(pos, FIELD_TAG_SIZE).c_str());
-		pos += FIELD_TAG_SIZE;
-		_dir[i]._fieldLen = atoi(data.substr(pos, _leader._szFieldLen).c_str());
-		pos += _leader._szFieldLen;
-		_dir[i]._fieldPos = atoi(data.substr(pos, _leader._szFieldPos).c_str());
-		pos += _leader._szFieldPos;
+		memcpy(_dir[i]._fieldTag, p, FIELD_TAG_SIZE);
+		_dir[i]._fieldTag[FIELD_TAG_SIZE] = '\0';
+		p += FIELD_TAG_SIZE;
+		_dir[i]._fieldLen = digitsToInt(p, _leader._szFieldLen);
+		p += _leader._szFieldLen;
+		_dir[i]._fieldPos = digitsToInt(p, _leader._szFieldPos);
+		p += _leader._szFieldPos;
 	}
 
-	assert(data[pos] = S57_FT);
+	assert(*p == S57_FT);
 }
 
 LRHeader::DirIterator LRHeader::begin()
@@ -185,6 +204,16 @@ string LRHeader::toString() const
 	return result;
 }
 
+// Appends to dir the entry of the field just encoded from *start,
+// positioned from base, then moves *start to the next field.
+static void addDirEntry(vector<LRDirEntry> *dir, const char *tag, 
+				const S57Encoder &e, size_t base, size_t *start)
+{
+	if (dir != NULL)
+		dir->push_back(LRDirEntry(tag, e.written() - *start, *start - base));
+	*start = e.written();
+}
+
 // S57Record members
 
 S57Record::S57Record()
@@ -198,12 +227,14 @@ S57Record::S57Record(S57Record::RecordType type, S57Module *mod)
 {
 	_recordType = type;
 	_module = mod;
+	if (mod != NULL)
+		_attrPool = mod->attrPool();
 }
 
-S57Record::S57Record(S57Record::RecordType type, string data)
+S57Record::S57Record(S57Record::RecordType type, string_view data)
 	: RefBase()
 { 
-	_data = data;
+	_data.assign(data.data(), data.size());
 	_recordType = type;
 	_header = new LRHeader(data);
 	_module = NULL;
@@ -213,18 +244,58 @@ S57Record::~S57Record()
 {
 }
 
-Ref<S57Record> S57Record::decode(string data, S57Module *mod)
+void S57Record::retainFields(string_view fieldArea, S57Module *mod)
+{
+	// a mapped field area stays valid as long as its mapping is alive,
+	// one from elsewhere (a snapshot, say) is copied
+	MappedFileRef map;
+	if (mod != NULL && mod->isMapped())
+		map = mod->mapping();
+	if (!map.isNull() && fieldArea.data() >= map->data()
+			&& fieldArea.data() + fieldArea.size() <= map->data() + map->size()) {
+		_rawMap = map;
+		_rawFields = fieldArea;
+	}
+	else {
+		_rawBuf.assign(fieldArea.data(), fieldArea.size());
+		_rawFields = _rawBuf;
+	}
+}
+
+S57AttrPool *S57Record::ownAttrPool()
+{
+	// a record decoded without a module keeps its values in a pool of its
+	// own, released along with it
+	if (_attrPool.isNull())
+		_attrPool = new S57AttrPool;
+	return _attrPool.getPtr();
+}
+
+void S57Record::releaseFields()
+{
+	_rawFields = string_view();
+	_rawMap.release();
+	string().swap(_rawBuf);
+}
+
+Ref<S57Record> S57Record::decode(string_view data, S57Module *mod)
 {
 	Ref<S57Record> res;
-	LRHeaderRef hr = new LRHeader(data);
-	const string tag1(hr->_dir[1]._fieldTag);
-	const string fieldArea(data.substr(hr->_leader._fieldAreaOffset));
+	if (data.size() < 24) {
+		fprintf(stderr, "Seems not a S57 record, too short.\n");
+		return res;
+	}
 
+	LRHeaderRef hr = new LRHeader(data);
 	if (hr->_dir.size() < 2) {
 		fprintf(stderr, "Seems not a S57 record, directory too small.\n");
 		return res;
 	}
 
+	// the field area is referenced in place, fields are decoded from it directly
+	const string_view tag1(hr->_dir[1]._fieldTag);
+	const string_view fieldArea(data.substr(hr->_leader._fieldAreaOffset));
+
 	if (tag1 == "0001")
 		res = new S57DataDescripRecord(hr, fieldArea, mod);
 	else if (tag1 == "DSID")
@@ -250,11 +321,12 @@ Ref<S57Record> S57Record::decode(string data, S57Module *mod)
 	else if (tag1 == "VRID")
 		res = new S57VectorRecord(hr, fieldArea, mod);
 	else
-		fprintf(stderr, "Unknown S57 record with the first field: %s\n", tag1.c_str());
+		fprintf(stderr, "Unknown S57 record with the first field: %.*s\n", 
+				static_cast<int>(tag1.size()), tag1.data());
 
-	if (strncmp(hr->_dir[0]._fieldTag, "0001", 4) == 0)
-		res->setRecordId(fieldArea.substr(hr->_dir[0]._fieldPos, 
-					hr->_dir[0]._fieldLen));
+	if (!res.isNull() && strncmp(hr->_dir[0]._fieldTag, "0001", 4) == 0)
+		res->setRecordId(string(fieldArea.substr(hr->_dir[0]._fieldPos, 
+					hr->_dir[0]._fieldLen)));
 
 	return res;
 }
@@ -285,7 +357,7 @@ S57DataDescripRecord::S57DataDescripRecord()
 {
 }
 
-S57DataDescripRecord::S57DataDescripRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57DataDescripRecord::S57DataDescripRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(DDR, mod)
 {
 	setHeader(hr);
@@ -295,7 +367,7 @@ S57DataDescripRecord::S57DataDescripRecord(LRHeaderRef hr, string s, S57Module *
 
 	LRHeader::DirIterator it = _header->begin();
 	for (; it != _header->end(); ++it)
-		_descripFields.push_back(s.substr(it->_fieldPos, it->_fieldLen));
+		_descripFields.emplace_back(s.substr(it->_fieldPos, it->_fieldLen));
 }
 
 S57DataDescripRecord::~S57DataDescripRecord()
@@ -346,7 +418,7 @@ S57DSInfoRecord::S57DSInfoRecord()
 	init();
 }
 
-S57DSInfoRecord::S57DSInfoRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57DSInfoRecord::S57DSInfoRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(DatasetInformation, mod)
 {
 	init();
@@ -355,7 +427,7 @@ S57DSInfoRecord::S57DSInfoRecord(LRHeaderRef hr, string s, S57Module *mod)
 	S57Decoder d;
 	LRHeader::DirIterator it = _header->begin();
 	for (; it != _header->end(); ++it) {
-		const string tag(it->_fieldTag);
+		const string_view tag(it->_fieldTag);
 		d.setFieldData(s.substr(it->_fieldPos, it->_fieldLen));
 		if (tag == "DSID")
 			_dsid = new S57_DSID(d);
@@ -420,7 +492,7 @@ S57DSGeoRecord::S57DSGeoRecord()
 	init();
 }
 
-S57DSGeoRecord::S57DSGeoRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57DSGeoRecord::S57DSGeoRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(DatasetGeographic, mod)
 {
 	init();
@@ -429,7 +501,7 @@ S57DSGeoRecord::S57DSGeoRecord(LRHeaderRef hr, string s, S57Module *mod)
 	S57Decoder d;
 	LRHeader::DirIterator it = _header->begin();
 	for (; it != _header->end(); ++it) {
-		const string tag(it->_fieldTag);
+		const string_view tag(it->_fieldTag);
 		d.setFieldData(s.substr(it->_fieldPos, it->_fieldLen));
 		if (tag == "DSPM")
 			_dspm = new S57_DSPM(d);
@@ -496,7 +568,7 @@ S57DSHistoryRecord::S57DSHistoryRecord()
 	init();
 }
 
-S57DSHistoryRecord::S57DSHistoryRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57DSHistoryRecord::S57DSHistoryRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(DatasetHistory, mod)
 {
 	init();
@@ -541,7 +613,7 @@ S57DSAccuracyRecord::S57DSAccuracyRecord()
 	init();
 }
 
-S57DSAccuracyRecord::S57DSAccuracyRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57DSAccuracyRecord::S57DSAccuracyRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(DatasetAccuracy, mod)
 {
 	init();
@@ -586,7 +658,7 @@ S57CatalogDirRecord::S57CatalogDirRecord()
 	init();
 }
 
-S57CatalogDirRecord::S57CatalogDirRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57CatalogDirRecord::S57CatalogDirRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(CatalogDirectory, mod)
 {
 	init();
@@ -626,6 +698,9 @@ void S57FeatureRecord::init()
 	_foid = NULL;
 	_ffpc = NULL;
 	_fspc = NULL;
+	_fieldsPending = false;
+	_aall = S57_LL1;
+	_nall = S57_LL1;
 }
 
 S57FeatureRecord::S57FeatureRecord()
@@ -634,41 +709,65 @@ S57FeatureRecord::S57FeatureRecord()
 	init();
 }
 
-S57FeatureRecord::S57FeatureRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57FeatureRecord::S57FeatureRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(Feature, mod)
 {
 	init();
 	setHeader(hr);
 
+	_aall = mod != NULL ? mod->aall() : S57_LL1;
+	_nall = mod != NULL ? mod->nall() : S57_LL1;
+
+	if (mod == NULL || !mod->lazyDecoding()) {
+		decodeFields(s, false);
+		return;
+	}
+
+	// Decodes FRID only, the other fields are decoded on first access
+	LRHeader::DirIterator it = _header->begin();
+	for (; it != _header->end(); ++it) {
+		if (strcmp(it->_fieldTag, "FRID") == 0) {
+			S57Decoder d;
+			d.setFieldData(s.substr(it->_fieldPos, it->_fieldLen));
+			_frid = new S57_FRID(d);
+			break;
+		}
+	}
+	retainFields(s, mod);
+	_fieldsPending = true;
+}
+
+void S57FeatureRecord::decodeFields(string_view s, bool skipFRID)
+{
 	S57Decoder d;
 	LRHeader::DirIterator it = _header->begin();
 	for (; it != _header->end(); ++it) {
-		const string tag(it->_fieldTag);
+		const string_view tag(it->_fieldTag);
 		d.setFieldData(s.substr(it->_fieldPos, it->_fieldLen));
-		if (tag == "FRID")
-			_frid = new S57_FRID(d);
+		if (tag == "FRID") {
+			if (!skipFRID)
+				_frid = new S57_FRID(d);
+		}
 		else if (tag == "FOID")
 			_foid = new S57_LNAM(d);
 		else if (tag == "ATTF") {
 			/* XXX Wrong code!
 			   while (!d.isEnd())
-			   _attfs.push_back(S57_AttItem(d.getUInt(2), d.getString(_module->aall())));
+			   _attfs.push_back(S57_AttItem(d.getUInt(2), d.getString(_aall)));
 			 */
 			while (!d.isEnd()) {
 				int attl = d.getUInt(2);
-				string atvl = d.getString(_module->aall());
-				_attfs.push_back(S57_AttItem(attl, atvl));
+				_attfs.emplace_back(attl, ownAttrPool()->intern(d.getStringView(_aall)));
 			}
 		}
 		else if (tag == "NATF") {
 			/* XXX Wrong code!
 			   while (!d.isEnd())
-			   _natfs.push_back(S57_AttItem(d.getUInt(2), d.getString(_module->nall())));
+			   _natfs.push_back(S57_AttItem(d.getUInt(2), d.getString(_nall)));
 			 */
 			while (!d.isEnd()) {
 				int attl = d.getUInt(2);
-				string atvl = d.getString(_module->nall());
-				_natfs.push_back(S57_AttItem(attl, atvl));
+				_natfs.emplace_back(attl, ownAttrPool()->intern(d.getStringView(_nall)));
 			}
 		}
 		else if (tag == "FFPC")
@@ -686,6 +785,16 @@ S57FeatureRecord::S57FeatureRecord(LRHeaderRef hr, string s, S57Module *mod)
 	}
 }
 
+void S57FeatureRecord::loadFields()
+{
+	if (!_fieldsPending)
+		return;
+
+	_fieldsPending = false;
+	decodeFields(_rawFields, true);
+	releaseFields();
+}
+
 S57FeatureRecord::~S57FeatureRecord()
 {
 	if (_frid != NULL)
@@ -700,62 +809,86 @@ S57FeatureRecord::~S57FeatureRecord()
 
 void S57FeatureRecord::encode(S57Encoder &e)
 {
+	loadFields();
+
 	_header->encode(e);
 
 	if (!_recordId.empty())
 		e.writeBlock(_recordId.data(), _recordId.size());
+	encodeFields(e, NULL);
+}
+
+void S57FeatureRecord::encodeFields(S57Encoder &e, vector<LRDirEntry> *dir)
+{
+	loadFields();
+
+	size_t base = e.written();
+	size_t start = base;
+
 	if (_frid != NULL) {
 		_frid->encode(e);
 		e.endField();
+		addDirEntry(dir, "FRID", e, base, &start);
 	}
 	if (_foid != NULL) {
-		e.setUInt(_foid->_agen, 2);
-		e.setUInt(_foid->_fidn, 4);
-		e.setUInt(_foid->_fids, 2);
+		e.packLongName(*_foid);
 		e.endField();
+		addDirEntry(dir, "FOID", e, base, &start);
 	}
 
 	vector<S57_AttItem>::const_iterator it = _attfs.begin();
 	for (; it != _attfs.end(); ++it) {
 		e.setUInt(it->_attl, 2);
-		e.setString(it->_atvl, _module->aall(), true);
+		e.setString(string(it->atvl()), _aall, true);
+	}
+	if (!_attfs.empty()) {
+		e.endField(_aall);
+		addDirEntry(dir, "ATTF", e, base, &start);
 	}
-	if (!_attfs.empty())
-		e.endField(_module->aall());
 
 	it = _natfs.begin();
 	for (; it != _natfs.end(); ++it) {
 		e.setUInt(it->_attl, 2);
-		e.setString(it->_atvl, _module->nall(), true);
+		e.setString(string(it->atvl()), _nall, true);
+	}
+	if (!_natfs.empty()) {
+		e.endField(_nall);
+		addDirEntry(dir, "NATF", e, base, &start);
 	}
-	if (!_natfs.empty())
-		e.endField(_module->nall());
 
 	if (_ffpc != NULL) { 
 		_ffpc->encode(e);
 		e.endField();
+		addDirEntry(dir, "FFPC", e, base, &start);
 	}
 
 	vector<S57_FFPT>::iterator jt = _ffpts.begin();
 	for (; jt != _ffpts.end(); ++jt)
 		jt->encode(e);
-	if (!_ffpts.empty())
+	if (!_ffpts.empty()) {
 		e.endField();
+		addDirEntry(dir, "FFPT", e, base, &start);
+	}
 
 	if (_fspc != NULL) {
 		_fspc->encode(e);
 		e.endField();
+		addDirEntry(dir, "FSPC", e, base, &start);
 	}
 
 	vector<S57_FSPT>::iterator kt = _fspts.begin();
 	for (; kt != _fspts.end(); ++kt)
 		kt->encode(e);
-	if (!_fspts.empty())
+	if (!_fspts.empty()) {
 		e.endField();
+		addDirEntry(dir, "FSPT", e, base, &start);
+	}
 }
 
 string S57FeatureRecord::toString() const
 {
+	const_cast<S57FeatureRecord *>(this)->loadFields();
+
 	string s("=- Feature record -=\n");
 	s += _header->toString();
 
@@ -771,13 +904,13 @@ string S57FeatureRecord::toString() const
 		s += "| ATTF | Feature record attribute |\n";
 		vector<S57_AttItem>::const_iterator it = _attfs.begin();
 		for (; it != _attfs.end(); ++it)
-			s += it->toString(_module->aall());
+			s += it->toString(_aall);
 	}
 	if (!_natfs.empty()) {
 		s += "| NATF | Feature record national attribute |\n";
 		vector<S57_AttItem>::const_iterator it = _natfs.begin();
 		for (; it != _natfs.end(); ++it)
-			s += it->toString(_module->nall());
+			s += it->toString(_nall);
 	}
 	if (_ffpc != NULL) {
 		s += " | FFPC [Upd] | Feature Record to Feature Object Pointer Control |\n";
@@ -820,13 +953,15 @@ void S57FeatureRecord::update(Ref<S57FeatureRecord> upr)
 	assert(upr->fieldFRID() != NULL);
 	assert(_frid != NULL);
 
+	loadFields();
+
 	const S57_FRID *up_frid = upr->fieldFRID();
 
 	if (_frid->_rver != up_frid->_rver - 1)
 		fprintf(stderr, "Unordered update record: %s\n", up_frid->_name.toString().c_str());
 
-	updateAttributes(_attfs, upr->fieldsATTF());
-	updateAttributes(_natfs, upr->fieldsNATF());
+	updateAttributes(_attfs, upr->fieldsATTF(), ownAttrPool());
+	updateAttributes(_natfs, upr->fieldsNATF(), ownAttrPool());
 
 	if (upr->fieldFFPC() != NULL)
 		updatePointers(_ffpts, upr->fieldsFFPT(), upr->fieldFFPC());
@@ -837,6 +972,75 @@ void S57FeatureRecord::update(Ref<S57FeatureRecord> upr)
 	_frid->_rver = up_frid->_rver;
 }
 
+// S57CoordArray members
+
+void S57CoordArray::append(const char *p, size_t n, int dim)
+{
+	size_t base = _ys.size();
+	_dim = dim;
+	_ys.resize(base + n);
+	_xs.resize(base + n);
+	if (dim == 3)
+		_zs.resize(base + n);
+
+	int32_t *ys = _ys.data() + base;
+	int32_t *xs = _xs.data() + base;
+	if (dim == 2) {
+		for (size_t i = 0; i < n; ++i, p += 8) {
+			memcpy(ys + i, p, 4);
+			memcpy(xs + i, p + 4, 4);
+		}
+	}
+	else {
+		int32_t *zs = _zs.data() + base;
+		for (size_t i = 0; i < n; ++i, p += 12) {
+			memcpy(ys + i, p, 4);
+			memcpy(xs + i, p + 4, 4);
+			memcpy(zs + i, p + 8, 4);
+		}
+	}
+}
+
+void S57CoordArray::insert(size_t pos, const S57CoordArray &src, size_t n)
+{
+	if (pos > size())
+		return;
+	if (n > src.size())
+		n = src.size();
+
+	_ys.insert(_ys.begin() + pos, src._ys.begin(), src._ys.begin() + n);
+	_xs.insert(_xs.begin() + pos, src._xs.begin(), src._xs.begin() + n);
+	if (_dim == 3) {
+		if (src._dim == 3)
+			_zs.insert(_zs.begin() + pos, src._zs.begin(), src._zs.begin() + n);
+		else
+			_zs.insert(_zs.begin() + pos, n, 0);
+	}
+}
+
+void S57CoordArray::erase(size_t pos, size_t n)
+{
+	if (pos > size())
+		return;
+	if (n > size() - pos)
+		n = size() - pos;
+
+	_ys.erase(_ys.begin() + pos, _ys.begin() + pos + n);
+	_xs.erase(_xs.begin() + pos, _xs.begin() + pos + n);
+	if (_dim == 3)
+		_zs.erase(_zs.begin() + pos, _zs.begin() + pos + n);
+}
+
+void S57CoordArray::replace(size_t pos, const S57CoordArray &src, size_t n)
+{
+	for (size_t i = 0; i < n && i < src.size() && pos + i < size(); ++i) {
+		_ys[pos + i] = src._ys[i];
+		_xs[pos + i] = src._xs[i];
+		if (_dim == 3)
+			_zs[pos + i] = src.z(i);
+	}
+}
+
 // S57VectorRecord members
 
 void S57VectorRecord::init()
@@ -845,6 +1049,7 @@ void S57VectorRecord::init()
 	_vrpc = NULL;
 	_sgcc = NULL;
 	_coordType = S57VectorRecord::SG2D;
+	_fieldsPending = false;
 }
 
 S57VectorRecord::S57VectorRecord()
@@ -853,19 +1058,42 @@ S57VectorRecord::S57VectorRecord()
 	init();
 }
 
-S57VectorRecord::S57VectorRecord(LRHeaderRef hr, string s, S57Module *mod)
+S57VectorRecord::S57VectorRecord(LRHeaderRef hr, string_view s, S57Module *mod)
 	: S57Record(Vector, mod)
 {
 	init();
 	setHeader(hr);
 
+	if (mod == NULL || !mod->lazyDecoding()) {
+		decodeFields(s, false);
+		return;
+	}
+
+	// Decodes VRID only, the other fields are decoded on first access
+	LRHeader::DirIterator it = _header->begin();
+	for (; it != _header->end(); ++it) {
+		if (strcmp(it->_fieldTag, "VRID") == 0) {
+			S57Decoder d;
+			d.setFieldData(s.substr(it->_fieldPos, it->_fieldLen));
+			_vrid = new S57_VRID(d);
+			break;
+		}
+	}
+	retainFields(s, mod);
+	_fieldsPending = true;
+}
+
+void S57VectorRecord::decodeFields(string_view s, bool skipVRID)
+{
 	S57Decoder d;
 	LRHeader::DirIterator it = _header->begin();
 	for (; it != _header->end(); ++it) {
-		const string tag(it->_fieldTag);
+		const string_view tag(it->_fieldTag);
 		d.setFieldData(s.substr(it->_fieldPos, it->_fieldLen));
-		if (tag == "VRID")
-			_vrid = new S57_VRID(d);
+		if (tag == "VRID") {
+			if (!skipVRID)
+				_vrid = new S57_VRID(d);
+		}
 		else if (tag == "ATTV") {
 			/* XXX Wrong code!
 			   while (!d.isEnd())
@@ -873,8 +1101,8 @@ S57VectorRecord::S57VectorRecord(LRHeaderRef hr, string s, S57Module *mod)
 			 */
 			while (!d.isEnd()) {
 				int attl = d.getUInt(2);
-				string atvl = d.getString(S57_LL0); // the string domain is always "Basic Text"
-				_attvs.push_back(S57_AttItem(attl, atvl));
+				// the string domain is always "Basic Text"
+				_attvs.emplace_back(attl, ownAttrPool()->intern(d.getStringView(S57_LL0)));
 			}
 		}
 		else if (tag == "VRPC")
@@ -885,21 +1113,27 @@ S57VectorRecord::S57VectorRecord(LRHeaderRef hr, string s, S57Module *mod)
 		}
 		else if (tag == "SGCC")
 			_sgcc = new S57_UpdControl(d);
-		else if (tag == "SG2D") {
-			_coordType = S57VectorRecord::SG2D;
-			while (!d.isEnd())
-				_coords.push_back(d.getSInt(4));
-			assert(_coords.size() % 2 == 0);
-		}
-		else if (tag == "SG3D") {
-			_coordType = S57VectorRecord::SG3D;
-			while (!d.isEnd())
-				_coords.push_back(d.getSInt(4));
-			assert(_coords.size() % 3 == 0);
+		else if (tag == "SG2D" || tag == "SG3D") {
+			// The points are copied out of the field at once, skipping
+			// the decoder. The field terminator follows the last one.
+			int dim = tag == "SG2D" ? 2 : 3;
+			_coordType = dim == 2 ? S57VectorRecord::SG2D : S57VectorRecord::SG3D;
+			assert(it->_fieldLen % (dim * 4) == 1);
+			_coords.append(s.data() + it->_fieldPos, it->_fieldLen / (dim * 4), dim);
 		}
 	}
 }
 
+void S57VectorRecord::loadFields()
+{
+	if (!_fieldsPending)
+		return;
+
+	_fieldsPending = false;
+	decodeFields(_rawFields, true);
+	releaseFields();
+}
+
 S57VectorRecord::~S57VectorRecord()
 {
 	if (_vrid != NULL)
@@ -912,44 +1146,75 @@ S57VectorRecord::~S57VectorRecord()
 
 void S57VectorRecord::encode(S57Encoder &e)
 {
+	loadFields();
+
 	_header->encode(e);
 
 	if (!_recordId.empty())
 		e.writeBlock(_recordId.data(), _recordId.size());
+	encodeFields(e, NULL);
+}
+
+void S57VectorRecord::encodeFields(S57Encoder &e, vector<LRDirEntry> *dir)
+{
+	loadFields();
+
+	size_t base = e.written();
+	size_t start = base;
 
 	if (_vrid != NULL) {
 		_vrid->encode(e);
 		e.endField();
+		addDirEntry(dir, "VRID", e, base, &start);
 	}
 
+	// the string domain is always "Basic Text", as decoded
 	vector<S57_AttItem>::const_iterator it = _attvs.begin();
 	for (; it != _attvs.end(); ++it) {
 		e.setUInt(it->_attl, 2);
-		e.setString(it->_atvl, _module->aall(), true);
+		e.setString(string(it->atvl()), S57_LL0, true);
+	}
+	if (!_attvs.empty()) {
+		e.endField(S57_LL0);
+		addDirEntry(dir, "ATTV", e, base, &start);
+	}
+
+	if (_vrpc != NULL) {
+		_vrpc->encode(e);
+		e.endField();
+		addDirEntry(dir, "VRPC", e, base, &start);
 	}
-	if (!_attvs.empty())
-		e.endField(_module->aall());
 
 	vector<S57_VRPT>::iterator jt = _vrpts.begin();
 	for (; jt != _vrpts.end(); ++jt)
 		jt->encode(e);
-	if (!_vrpts.empty())
+	if (!_vrpts.empty()) {
 		e.endField();
+		addDirEntry(dir, "VRPT", e, base, &start);
+	}
 
 	if (_sgcc != NULL) {
 		_sgcc->encode(e);
 		e.endField();
+		addDirEntry(dir, "SGCC", e, base, &start);
 	}
 
-	vector<s57_b24>::const_iterator kt = _coords.begin();
-	for (; kt != _coords.end(); ++kt)
-		e.setSInt(*kt, 4);
-	if (!_coords.empty())
+	for (size_t i = 0; i < _coords.size(); ++i) {
+		e.setSInt(_coords.y(i), 4);
+		e.setSInt(_coords.x(i), 4);
+		if (_coordType == SG3D)
+			e.setSInt(_coords.z(i), 4);
+	}
+	if (!_coords.empty()) {
 		e.endField();
+		addDirEntry(dir, _coordType == SG3D ? "SG3D" : "SG2D", e, base, &start);
+	}
 }
 
 string S57VectorRecord::toString() const
 {
+	const_cast<S57VectorRecord *>(this)->loadFields();
+
 	string s("=- Vector record -=\n");
 	s += _header->toString();
 
@@ -961,7 +1226,7 @@ string S57VectorRecord::toString() const
 		s += "| ATTV | Vector record attribute |\n";
 		vector<S57_AttItem>::const_iterator it = _attvs.begin();
 		for (; it != _attvs.end(); ++it)
-			s += it->toString(_module->aall());
+			s += it->toString(S57_LL0);
 	}
 	if (_vrpc != NULL) {
 		s += "| VRPC [Upd] | Vector Record Pointer Control |\n";
@@ -984,13 +1249,12 @@ string S57VectorRecord::toString() const
 			s += "| SG3D | 3-D Coordinate |\n";
 		else
 			assert(0);
-		int i = 0;
 		ostrstream os;
-		while (i < static_cast<int>(_coords.size())) {
-			os << INDENT << "*YCOO: " << _coords[i++] << endl;
-			os << INDENT << "XCOO:  " << _coords[i++] << endl;
+		for (size_t i = 0; i < _coords.size(); ++i) {
+			os << INDENT << "*YCOO: " << _coords.y(i) << endl;
+			os << INDENT << "XCOO:  " << _coords.x(i) << endl;
 			if (_coordType == SG3D)
-				os << INDENT << "VE3D:  " << _coords[i++] << endl;
+				os << INDENT << "VE3D:  " << _coords.z(i) << endl;
 		}
 		os << ends;
 		char *tmp = os.str();
@@ -1018,20 +1282,20 @@ void S57VectorRecord::update(Ref<S57VectorRecord> upr)
 	assert(upr->fieldVRID() != NULL);
 	assert(_vrid != NULL);
 
+	loadFields();
+
 	const S57_VRID *up_vrid = upr->fieldVRID();
 
 	if (_vrid->_rver != up_vrid->_rver - 1)
 		fprintf(stderr, "Unordered update record: %s\n", up_vrid->_name.toString().c_str());
 
-	updateAttributes(_attvs, upr->fieldsATTV());
+	updateAttributes(_attvs, upr->fieldsATTV(), ownAttrPool());
 
 	if (upr->fieldVRPC() != NULL)
 		updatePointers(_vrpts, upr->fieldsVRPT(), upr->fieldVRPC());
 
 	if (upr->fieldSGCC() != NULL)
-		updateCoords(_coords, upr->coords(), 
-				_coordType == S57VectorRecord::SG2D ? 2 : 3, 
-				upr->fieldSGCC());
+		updateCoords(_coords, upr->coords(), upr->fieldSGCC());
 
 	// Update the record version
 	_vrid->_rver = up_vrid->_rver;
@@ -1039,7 +1303,10 @@ void S57VectorRecord::update(Ref<S57VectorRecord> upr)
 
 // ~
 
-void updateAttributes(vector<S57_AttItem> &dst, const vector<S57_AttItem> &src)
+// The values of an update record may be pooled elsewhere, they are
+// interned in the pool of the target record.
+void updateAttributes(vector<S57_AttItem> &dst, const vector<S57_AttItem> &src, 
+				S57AttrPool *pool)
 {
 	vector<S57_AttItem>::const_iterator s_it = src.begin();
 	for (; s_it != src.end(); ++s_it) {
@@ -1048,15 +1315,18 @@ void updateAttributes(vector<S57_AttItem> &dst, const vector<S57_AttItem> &src)
 			if (s_it->_attl == d_it->_attl)
 				break;
 
+		string_view s_atvl = s_it->atvl();
 		if (d_it == dst.end())
-			dst.push_back(*s_it);
+			dst.push_back(S57_AttItem(s_it->_attl, pool->intern(s_atvl)));
 		else {
-			string s_atvl = s_it->_atvl;
+			s57_b12 c = 0;
+			if (s_atvl.size() == 2)
+				memcpy(&c, s_atvl.data(), 2);
 			if ((s_atvl.size() == 1 && s_atvl[0] == 0x7f)
-				|| (s_atvl.size() == 2 && *reinterpret_cast<const s57_b12 *>(s_atvl.data()) == 0x007f))
+				|| (s_atvl.size() == 2 && c == 0x007f))
 				dst.erase(d_it);
 			else
-				d_it->_atvl = s_atvl;
+				d_it->_value = pool->intern(s_atvl);
 		}
 	}
 }
@@ -1095,35 +1365,20 @@ void updatePointers(vector<T> &dst, const vector<T> &src, const S57_UpdControl *
 	}
 }
 
-void updateCoords(vector<s57_b24> &dst, const vector<s57_b24> &src, 
-				int pairSize, const S57_UpdControl *ctrl)
+void updateCoords(S57CoordArray &dst, const S57CoordArray &src, 
+				const S57_UpdControl *ctrl)
 {
 	assert(ctrl != NULL && ctrl->_index > 0);
 
-	vector<s57_b24>::iterator pos;
-	if ((ctrl->_index - 1) <= static_cast<int>(dst.size()) / pairSize)
-		pos = dst.begin() + (ctrl->_index - 1) * pairSize;
-	else
+	// NOTE: the index starts from 1
+	size_t pos = ctrl->_index - 1;
+	if (pos > dst.size())
 		return;
 
-	if (ctrl->_instruction == S57_UI_I) {
-		vector<s57_b24>::const_iterator src_endpos = src.begin() + ctrl->_count * pairSize;
-		if (src_endpos > src.end())
-			src_endpos = src.end();
-		dst.insert(pos, src.begin(), src_endpos);
-	}
-	else if (ctrl->_instruction == S57_UI_D) {
-		vector<s57_b24>::iterator endpos = pos + ctrl->_count * pairSize;
-		if (endpos > dst.end())
-			endpos = dst.end();
-		dst.erase(pos, endpos);
-	}
-	else if (ctrl->_instruction == S57_UI_M) {
-		int i = 0;
-		int j = (ctrl->_index - 1) * pairSize;
-		while (i < static_cast<int>(ctrl->_count * pairSize) 
-				&& i < static_cast<int>(src.size()) 
-				&& j < static_cast<int>(dst.size()))
-			dst[j++] = src[i++];
-	}
+	if (ctrl->_instruction == S57_UI_I)
+		dst.insert(pos, src, ctrl->_count);
+	else if (ctrl->_instruction == S57_UI_D)
+		dst.erase(pos, ctrl->_count);
+	else if (ctrl->_instruction == S57_UI_M)
+		dst.replace(pos, src, ctrl->_count);
 }
@@ -1,11 +1,15 @@
 #ifndef S57_RECORD_H
 #define S57_RECORD_H
 
+#include <stdint.h>
+
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "s57_utils.h"
 #include "s57_field_codec.h"
+#include "mapped_file.h"
 #include "iso8211_gloabal.h"
 
 const int FIELD_TAG_SIZE = 4;
@@ -29,7 +33,7 @@ public:
 
 public:
     LRLeader();
-    LRLeader(std::string data);
+    LRLeader(std::string_view data);
 
     std::string toString() const;
 };
@@ -54,7 +58,7 @@ public:
 
 public:
     LRHeader();
-    LRHeader(std::string data);
+    LRHeader(std::string_view data);
 
     void encode(S57Encoder &);
 
@@ -97,18 +101,38 @@ protected:
 
     std::string _recordId; // raw data of field 0001
 
+    // Field area of a record decoded lazily, either viewed in the mapping
+    // of the module or copied into the buffer. See S57Module::setLazyDecoding().
+    MappedFileRef    _rawMap;
+    std::string      _rawBuf;
+    std::string_view _rawFields;
+
+    // Pool of the attribute values of the record, the one of its module
+    S57AttrPoolRef _attrPool;
+
+protected:
+    void retainFields(std::string_view, S57Module *);
+    void releaseFields();
+
+    // Returns the pool to add the values to, creating one of its own
+    // for a record decoded without a module
+    S57AttrPool * ownAttrPool();
+
 public:
     S57Record();
     S57Record(RecordType, S57Module * mod = NULL);
     // Constructs a default record with given record raw data
-    S57Record(RecordType, std::string);
+    S57Record(RecordType, std::string_view);
     virtual ~S57Record();
 
-    static Ref<S57Record> decode(std::string, S57Module *);
+    // Decodes a record from its raw data, the data is not kept by the record
+    static Ref<S57Record> decode(std::string_view, S57Module *);
     virtual void          encode(S57Encoder &);
 
     RecordType  recordType() const;
     LRHeaderRef header() const;
+    // Returns the pool of the attribute values, null if none decoded yet
+    const S57AttrPoolRef & attrPool() const;
 
     void setRecordType(RecordType);
     void setHeader(LRHeaderRef);
@@ -130,6 +154,11 @@ inline LRHeaderRef S57Record::header() const
     return _header;
 }
 
+inline const S57AttrPoolRef & S57Record::attrPool() const
+{
+    return _attrPool;
+}
+
 inline void S57Record::setRecordType(S57Record::RecordType t)
 {
     _recordType = t;
@@ -162,7 +191,7 @@ private:
 
 private:
     // Constructor with given header and field area
-    S57DataDescripRecord(LRHeaderRef, std::string, S57Module *);
+    S57DataDescripRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57DataDescripRecord();
@@ -187,7 +216,7 @@ private:
     void init();
 
     // Constructor with given header and field area
-    S57DSInfoRecord(LRHeaderRef, std::string, S57Module *);
+    S57DSInfoRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57DSInfoRecord();
@@ -226,7 +255,7 @@ private:
     void init();
 
     // Constructor with given header and field area
-    S57DSGeoRecord(LRHeaderRef, std::string, S57Module *);
+    S57DSGeoRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57DSGeoRecord();
@@ -269,7 +298,7 @@ private:
     void init();
 
     // Constructor with given header and field area
-    S57DSHistoryRecord(LRHeaderRef, std::string, S57Module *);
+    S57DSHistoryRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57DSHistoryRecord();
@@ -298,7 +327,7 @@ private:
     void init();
 
     // Constructor with given header and field area
-    S57DSAccuracyRecord(LRHeaderRef, std::string, S57Module *);
+    S57DSAccuracyRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57DSAccuracyRecord();
@@ -327,7 +356,7 @@ private:
     void init();
 
     // Constructor with given header and field area
-    S57CatalogDirRecord(LRHeaderRef, std::string, S57Module *);
+    S57CatalogDirRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57CatalogDirRecord();
@@ -359,11 +388,18 @@ private:
     S57_UpdControl *         _fspc;
     std::vector<S57_FSPT>    _fspts;
 
+    // Lazy decoding, the fields but FRID are pending until first accessed
+    bool _fieldsPending;
+    int  _aall;
+    int  _nall;
+
 private:
     void init();
+    void decodeFields(std::string_view, bool skipFRID);
+    void loadFields();
 
     // Constructor with given header and field area
-    S57FeatureRecord(LRHeaderRef, std::string, S57Module *);
+    S57FeatureRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57FeatureRecord();
@@ -378,7 +414,15 @@ public:
     const S57_UpdControl *           fieldFSPC() const;
     const std::vector<S57_FSPT> &    fieldsFSPT() const;
 
+    // Lexical levels of the ATTF and NATF values
+    int aall() const;
+    int nall() const;
+
     void encode(S57Encoder &);
+    // Encodes the fields but the record identifier (0001). If dir is not
+    // NULL, the entry of each field is appended to it, positioned from
+    // the first field.
+    void encodeFields(S57Encoder &, std::vector<LRDirEntry> * dir);
 
     std::string toString() const;
 
@@ -388,6 +432,7 @@ public:
     void update(Ref<S57FeatureRecord> upr);
 
     friend class S57Record;
+    friend class S57Snapshot;
 };
 
 inline const S57_FRID * S57FeatureRecord::fieldFRID() const
@@ -397,39 +442,155 @@ inline const S57_FRID * S57FeatureRecord::fieldFRID() const
 
 inline const S57_LNAM * S57FeatureRecord::fieldFOID() const
 {
+    if (_fieldsPending)
+        const_cast<S57FeatureRecord *>(this)->loadFields();
     return _foid;
 }
 
 inline const std::vector<S57_AttItem> & S57FeatureRecord::fieldsATTF() const
 {
+    if (_fieldsPending)
+        const_cast<S57FeatureRecord *>(this)->loadFields();
     return _attfs;
 }
 
 inline const std::vector<S57_AttItem> & S57FeatureRecord::fieldsNATF() const
 {
+    if (_fieldsPending)
+        const_cast<S57FeatureRecord *>(this)->loadFields();
     return _natfs;
 }
 
 inline const S57_UpdControl * S57FeatureRecord::fieldFFPC() const
 {
+    if (_fieldsPending)
+        const_cast<S57FeatureRecord *>(this)->loadFields();
     return _ffpc;
 }
 
 inline const std::vector<S57_FFPT> & S57FeatureRecord::fieldsFFPT() const
 {
+    if (_fieldsPending)
+        const_cast<S57FeatureRecord *>(this)->loadFields();
     return _ffpts;
 }
 
 inline const S57_UpdControl * S57FeatureRecord::fieldFSPC() const
 {
+    if (_fieldsPending)
+        const_cast<S57FeatureRecord *>(this)->loadFields();
     return _fspc;
 }
 
 inline const std::vector<S57_FSPT> & S57FeatureRecord::fieldsFSPT() const
 {
+    if (_fieldsPending)
+        const_cast<S57FeatureRecord *>(this)->loadFields();
     return _fspts;
 }
 
+inline int S57FeatureRecord::aall() const
+{
+    return _aall;
+}
+
+inline int S57FeatureRecord::nall() const
+{
+    return _nall;
+}
+
+// ~
+
+/*
+ * Coordinates of a vector record, stored as int32 structure-of-arrays:
+ * the YCOO, XCOO and, for SG3D, VE3D subfields of the points each in
+ * their own array.
+ */
+class ISO8211_EXPORT S57CoordArray
+{
+private:
+    int                  _dim; // 2 for SG2D, 3 for SG3D
+    std::vector<int32_t> _ys;
+    std::vector<int32_t> _xs;
+    std::vector<int32_t> _zs;
+
+public:
+    S57CoordArray();
+
+    // Appends n points of dim subfields from the raw SG2D/SG3D field data
+    void append(const char * p, size_t n, int dim);
+
+    int    dimension() const;
+    size_t size() const;
+    bool   empty() const;
+
+    const int32_t * ys() const;
+    const int32_t * xs() const;
+    // Returns NULL for SG2D
+    const int32_t * zs() const;
+
+    int32_t y(size_t i) const;
+    int32_t x(size_t i) const;
+    int32_t z(size_t i) const;
+
+    // Inserts, erases or replaces n points at pos, for the coordinate
+    // updates. The points out of range are ignored.
+    void insert(size_t pos, const S57CoordArray & src, size_t n);
+    void erase(size_t pos, size_t n);
+    void replace(size_t pos, const S57CoordArray & src, size_t n);
+};
+
+// S57CoordArray inline functions
+
+inline S57CoordArray::S57CoordArray()
+    : _dim(2)
+{}
+
+inline int S57CoordArray::dimension() const
+{
+    return _dim;
+}
+
+inline size_t S57CoordArray::size() const
+{
+    return _ys.size();
+}
+
+inline bool S57CoordArray::empty() const
+{
+    return _ys.empty();
+}
+
+inline const int32_t * S57CoordArray::ys() const
+{
+    return _ys.data();
+}
+
+inline const int32_t * S57CoordArray::xs() const
+{
+    return _xs.data();
+}
+
+inline const int32_t * S57CoordArray::zs() const
+{
+    return _dim == 3 ? _zs.data() : NULL;
+}
+
+inline int32_t S57CoordArray::y(size_t i) const
+{
+    return _ys[i];
+}
+
+inline int32_t S57CoordArray::x(size_t i) const
+{
+    return _xs[i];
+}
+
+inline int32_t S57CoordArray::z(size_t i) const
+{
+    return _dim == 3 ? _zs[i] : 0;
+}
+
 // ~
 
 class ISO8211_EXPORT S57VectorRecord : public S57Record
@@ -448,13 +609,18 @@ private:
     std::vector<S57_VRPT>    _vrpts;
     S57_UpdControl *         _sgcc;
     CoordType                _coordType;
-    std::vector<s57_b24>     _coords;
+    S57CoordArray            _coords;
+
+    // Lazy decoding, the fields but VRID are pending until first accessed
+    bool _fieldsPending;
 
 private:
     void init();
+    void decodeFields(std::string_view, bool skipVRID);
+    void loadFields();
 
     // Constructor with given header and field area
-    S57VectorRecord(LRHeaderRef, std::string, S57Module *);
+    S57VectorRecord(LRHeaderRef, std::string_view, S57Module *);
 
 public:
     S57VectorRecord();
@@ -466,9 +632,11 @@ public:
     const std::vector<S57_VRPT> &    fieldsVRPT() const;
     const S57_UpdControl *           fieldSGCC() const;
     CoordType                        coordType() const;
-    const std::vector<s57_b24> &     coords() const;
+    const S57CoordArray &            coords() const;
 
     void encode(S57Encoder &);
+    // See S57FeatureRecord::encodeFields()
+    void encodeFields(S57Encoder &, std::vector<LRDirEntry> * dir);
 
     std::string toString() const;
 
@@ -478,6 +646,7 @@ public:
     void update(Ref<S57VectorRecord> upr);
 
     friend class S57Record;
+    friend class S57Snapshot;
 };
 
 inline const S57_VRID * S57VectorRecord::fieldVRID() const
@@ -487,31 +656,43 @@ inline const S57_VRID * S57VectorRecord::fieldVRID() const
 
 inline const std::vector<S57_AttItem> & S57VectorRecord::fieldsATTV() const
 {
+    if (_fieldsPending)
+        const_cast<S57VectorRecord *>(this)->loadFields();
     return _attvs;
 }
 
 inline const S57_UpdControl * S57VectorRecord::fieldVRPC() const
 {
+    if (_fieldsPending)
+        const_cast<S57VectorRecord *>(this)->loadFields();
     return _vrpc;
 }
 
 inline const std::vector<S57_VRPT> & S57VectorRecord::fieldsVRPT() const
 {
+    if (_fieldsPending)
+        const_cast<S57VectorRecord *>(this)->loadFields();
     return _vrpts;
 }
 
 inline const S57_UpdControl * S57VectorRecord::fieldSGCC() const
 {
+    if (_fieldsPending)
+        const_cast<S57VectorRecord *>(this)->loadFields();
     return _sgcc;
 }
 
 inline S57VectorRecord::CoordType S57VectorRecord::coordType() const
 {
+    if (_fieldsPending)
+        const_cast<S57VectorRecord *>(this)->loadFields();
     return _coordType;
 }
 
-inline const std::vector<s57_b24> & S57VectorRecord::coords() const
+inline const S57CoordArray & S57VectorRecord::coords() const
 {
+    if (_fieldsPending)
+        const_cast<S57VectorRecord *>(this)->loadFields();
     return _coords;
 }
 
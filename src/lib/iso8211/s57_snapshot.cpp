@@ -0,0 +1,292 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "assure_fio.h"
+#include "s57_module.h"
+#include "s57_snapshot.h"
+
+using namespace std;
+
+static const char     SNAPSHOT_MAGIC[4] = { 'S', '5', '7', 'M' };
+static const uint16_t SNAPSHOT_VERSION = 2;
+static const size_t   SNAPSHOT_HEADER_SIZE = 4 + 2 + 2 + 4 + 4 + 4 + 4;
+static const size_t   RECORD_HEADER_SIZE = 1 + 1 + 1 + 1 + 2;
+static const size_t   FIELD_ENTRY_SIZE = FIELD_TAG_SIZE + 4;
+
+template <typename T>
+static void putValue(string &buf, T v)
+{
+	buf.append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <typename T>
+static T getValue(const char *p)
+{
+	T v;
+	memcpy(&v, p, sizeof(T));
+	return v;
+}
+
+// Returns the number of decimal digits of n
+static size_t digitCount(size_t n)
+{
+	size_t c = 1;
+	while (n >= 10) {
+		n /= 10;
+		++c;
+	}
+	return c;
+}
+
+// S57Snapshot members
+
+void S57Snapshot::init()
+{
+	_edition = 0;
+	_updateNumber = 0;
+	_source.clear();
+	_recordCount = 0;
+	_pos = 0;
+}
+
+S57Snapshot::S57Snapshot()
+	: RefBase()
+{
+	init();
+}
+
+S57Snapshot::S57Snapshot(int edition, int updateNumber, const string &source)
+	: RefBase()
+{
+	init();
+	_edition = edition;
+	_updateNumber = updateNumber;
+	_source = source;
+}
+
+S57Snapshot::~S57Snapshot()
+{
+	close();
+}
+
+void S57Snapshot::addFields(char kind, int aall, int nall, const string &recordId,
+		const string &fields, const vector<LRDirEntry> &dir)
+{
+	size_t nfields = dir.size() + (recordId.empty() ? 0 : 1);
+
+	_buf.push_back(kind);
+	putValue<uint8_t>(_buf, aall);
+	putValue<uint8_t>(_buf, nall);
+	putValue<uint8_t>(_buf, 0);
+	putValue<uint16_t>(_buf, nfields);
+
+	if (!recordId.empty()) {
+		_buf.append("0001", FIELD_TAG_SIZE);
+		putValue<uint32_t>(_buf, recordId.size());
+	}
+	vector<LRDirEntry>::const_iterator it = dir.begin();
+	for (; it != dir.end(); ++it) {
+		_buf.append(it->_fieldTag, FIELD_TAG_SIZE);
+		putValue<uint32_t>(_buf, it->_fieldLen);
+	}
+
+	_buf.append(recordId);
+	_buf.append(fields);
+	++_recordCount;
+}
+
+void S57Snapshot::addRecord(S57FeatureRecord *r)
+{
+	string fields;
+	vector<LRDirEntry> dir;
+	S57Encoder e(&fields);
+	r->encodeFields(e, &dir);
+	addFields('F', r->_aall, r->_nall, r->_recordId, fields, dir);
+}
+
+void S57Snapshot::addRecord(S57VectorRecord *r)
+{
+	string fields;
+	vector<LRDirEntry> dir;
+	S57Encoder e(&fields);
+	r->encodeFields(e, &dir);
+	addFields('V', S57_LL0, S57_LL0, r->_recordId, fields, dir);
+}
+
+bool S57Snapshot::save(string fileName) const
+{
+	string tmpName = fileName + ".tmp";
+	FILE *fp = fopen(tmpName.c_str(), "wb");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: cannot write snapshot\n", tmpName.c_str());
+		return false;
+	}
+
+	string hdr;
+	hdr.append(SNAPSHOT_MAGIC, 4);
+	putValue<uint16_t>(hdr, SNAPSHOT_VERSION);
+	putValue<uint16_t>(hdr, 0);
+	putValue<uint32_t>(hdr, _edition);
+	putValue<uint32_t>(hdr, _updateNumber);
+	putValue<uint32_t>(hdr, _recordCount);
+	putValue<uint32_t>(hdr, _source.size());
+	hdr.append(_source);
+
+	as_fwrite(hdr.data(), 1, hdr.size(), fp);
+	as_fwrite(_buf.data(), 1, _buf.size(), fp);
+	fclose(fp);
+
+	// rename() does not replace an existing file everywhere
+	remove(fileName.c_str());
+	if (rename(tmpName.c_str(), fileName.c_str()) != 0) {
+		fprintf(stderr, "%s: cannot write snapshot\n", fileName.c_str());
+		remove(tmpName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+bool S57Snapshot::load(string fileName)
+{
+	close();
+
+	_map = new MappedFile;
+	if (!_map->open(fileName)) {
+		close();
+		return false;
+	}
+
+	const char *p = _map->data();
+	if (_map->size() < SNAPSHOT_HEADER_SIZE || memcmp(p, SNAPSHOT_MAGIC, 4) != 0) {
+		fprintf(stderr, "%s: seems not a snapshot file.\n", fileName.c_str());
+		close();
+		return false;
+	}
+	if (getValue<uint16_t>(p + 4) != SNAPSHOT_VERSION) {
+		fprintf(stderr, "%s: unsupported snapshot version %d\n",
+				fileName.c_str(), getValue<uint16_t>(p + 4));
+		close();
+		return false;
+	}
+
+	_edition = getValue<uint32_t>(p + 8);
+	_updateNumber = getValue<uint32_t>(p + 12);
+	_recordCount = getValue<uint32_t>(p + 16);
+	size_t sourceSize = getValue<uint32_t>(p + 20);
+	if (sourceSize > _map->size() - SNAPSHOT_HEADER_SIZE) {
+		fprintf(stderr, "%s: broken snapshot header\n", fileName.c_str());
+		close();
+		return false;
+	}
+	_source.assign(p + SNAPSHOT_HEADER_SIZE, sourceSize);
+	_pos = SNAPSHOT_HEADER_SIZE + sourceSize;
+
+	return true;
+}
+
+void S57Snapshot::close()
+{
+	_map.release();
+	_buf.clear();
+	init();
+}
+
+S57RecordRef S57Snapshot::nextRecord(S57Module *mod)
+{
+	S57RecordRef res;
+	if (_map.isNull() || _pos >= _map->size())
+		return res;
+
+	const char *data = _map->data();
+	size_t size = _map->size();
+	if (size - _pos < RECORD_HEADER_SIZE) {
+		fprintf(stderr, "Broken snapshot record at %zu\n", _pos);
+		_pos = size;
+		return res;
+	}
+
+	const char *p = data + _pos;
+	char kind = p[0];
+	int aall = static_cast<uint8_t>(p[1]);
+	int nall = static_cast<uint8_t>(p[2]);
+	size_t nfields = getValue<uint16_t>(p + 4);
+	p += RECORD_HEADER_SIZE;
+
+	if (static_cast<size_t>(data + size - p) < nfields * FIELD_ENTRY_SIZE) {
+		fprintf(stderr, "Broken snapshot record at %zu\n", _pos);
+		_pos = size;
+		return res;
+	}
+
+	// Rebuilds the header, as if the record were read from a cell
+	LRHeaderRef hr = new LRHeader;
+	hr->_dir.resize(nfields);
+	size_t fieldsSize = 0;
+	size_t maxLen = 0;
+	for (size_t i = 0; i < nfields; ++i) {
+		LRDirEntry &ent = hr->_dir[i];
+		memcpy(ent._fieldTag, p, FIELD_TAG_SIZE);
+		ent._fieldTag[FIELD_TAG_SIZE] = '\0';
+		ent._fieldLen = getValue<uint32_t>(p + FIELD_TAG_SIZE);
+		ent._fieldPos = fieldsSize;
+		fieldsSize += ent._fieldLen;
+		if (ent._fieldLen > maxLen)
+			maxLen = ent._fieldLen;
+		p += FIELD_ENTRY_SIZE;
+	}
+
+	if (static_cast<size_t>(data + size - p) < fieldsSize) {
+		fprintf(stderr, "Broken snapshot record at %zu\n", _pos);
+		_pos = size;
+		return res;
+	}
+	string_view fieldArea(p, fieldsSize);
+	_pos = p + fieldsSize - data;
+
+	LRLeader &ld = hr->_leader;
+	ld._interchangeLevel = ' ';
+	ld._leaderIdentifier = 'D';
+	ld._extensionIndicator = ' ';
+	ld._versionNumber = ' ';
+	ld._applicationIndicator = ' ';
+	ld._fieldControlLength = 0;
+	memset(ld._charSetIndicator, ' ', 3);
+	ld._szFieldLen = digitCount(maxLen);
+	ld._szFieldPos = digitCount(fieldsSize);
+	ld._fieldAreaOffset = 24 + nfields * (FIELD_TAG_SIZE + ld._szFieldLen + ld._szFieldPos) + 1;
+	ld._recordLength = ld._fieldAreaOffset + fieldsSize;
+
+	if (kind == 'F') {
+		S57FeatureRecord *fr = new S57FeatureRecord;
+		res = fr;
+		fr->_module = mod;
+		if (mod != NULL && !mod->attrPool().isNull())
+			fr->_attrPool = mod->attrPool();
+		fr->_aall = aall;
+		fr->_nall = nall;
+		fr->setHeader(hr);
+		fr->decodeFields(fieldArea, false);
+	}
+	else if (kind == 'V') {
+		S57VectorRecord *vr = new S57VectorRecord;
+		res = vr;
+		vr->_module = mod;
+		if (mod != NULL && !mod->attrPool().isNull())
+			vr->_attrPool = mod->attrPool();
+		vr->setHeader(hr);
+		vr->decodeFields(fieldArea, false);
+	}
+	else {
+		fprintf(stderr, "Unknown snapshot record '%c'\n", kind);
+		_pos = size;
+		return res;
+	}
+
+	if (nfields > 0 && strcmp(hr->_dir[0]._fieldTag, "0001") == 0)
+		res->setRecordId(string(fieldArea.substr(0, hr->_dir[0]._fieldLen)));
+
+	return res;
+}
+
+// ~
@@ -0,0 +1,109 @@
+#ifndef S57_SNAPSHOT_H
+#define S57_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+
+#include "s57_utils.h"
+#include "s57_record.h"
+#include "mapped_file.h"
+#include "iso8211_gloabal.h"
+
+class S57Module;
+
+/*
+ * Merged state of a data set, the feature and vector records left by
+ * applying its update cells, so a later run loads them at once instead
+ * of replaying the updates. The snapshot is keyed by the edition of the
+ * data set, the number of the last update cell applied and the source, a
+ * string naming the base and update cells read, e.g. by size and time.
+ *
+ * The file is written in host byte order:
+ *   "S57M", version (uint16), reserved (uint16), edition (uint32),
+ *   update number (uint32), record count (uint32), source length (uint32),
+ *   the source,
+ * then each record:
+ *   kind 'F' or 'V' (char), AALL, NALL (uint8), reserved (uint8),
+ *   field count (uint16), the fields {tag (char[4]), length (uint32)},
+ *   then the encoded fields in order.
+ */
+class ISO8211_EXPORT S57Snapshot : public RefBase
+{
+private:
+    uint32_t _edition;
+    uint32_t _updateNumber;
+    std::string _source;
+    uint32_t _recordCount;
+
+    // Records encoded, when writing
+    std::string _buf;
+
+    // Mapping of the file and the position of the next record, when reading
+    MappedFileRef _map;
+    size_t        _pos;
+
+private:
+    void init();
+
+    void addFields(char kind, int aall, int nall, const std::string & recordId,
+                   const std::string & fields, const std::vector<LRDirEntry> & dir);
+
+    S57Snapshot(const S57Snapshot &);
+    S57Snapshot & operator=(const S57Snapshot &);
+
+public:
+    S57Snapshot();
+    S57Snapshot(int edition, int updateNumber, const std::string & source);
+    ~S57Snapshot();
+
+    int                 edition() const;
+    int                 updateNumber() const;
+    const std::string & source() const;
+    size_t              recordCount() const;
+
+    // Appends the record in its current state, deleted or not
+    void addRecord(S57FeatureRecord *);
+    void addRecord(S57VectorRecord *);
+
+    // Writes the records added to the file, through a temporary file
+    // renamed at the end, so a broken run never leaves a partial one.
+    bool save(std::string fileName) const;
+
+    // Opens a snapshot file and reads its header.
+    bool load(std::string fileName);
+    void close();
+
+    // Returns the next record of a loaded snapshot, decoded in the
+    // attribute pool of mod, or a null one at the end.
+    S57RecordRef nextRecord(S57Module * mod);
+};
+
+typedef Ref<S57Snapshot> S57SnapshotRef;
+
+// S57Snapshot inline functions
+
+inline int S57Snapshot::edition() const
+{
+    return _edition;
+}
+
+inline int S57Snapshot::updateNumber() const
+{
+    return _updateNumber;
+}
+
+inline const std::string & S57Snapshot::source() const
+{
+    return _source;
+}
+
+inline size_t S57Snapshot::recordCount() const
+{
+    return _recordCount;
+}
+
+// ~
+
+#endif
@@ -9,6 +9,10 @@
 #include <filesystem>
 #include <iostream>
 #include <strstream>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include <cctype> // ȷͷļʹ std::isdigit
 
 
@@ -214,57 +218,135 @@ std::string getAbsolutePath(const std::string& path)
 
 // S57DatasetScanner members
 
-void S57DatasetScanner::doScan(const std::string& prefix, const std::string& dirName)
+// Checks if the file name is of a S-57 data set, as XXXXXXXX.NNN
+static bool isDatasetName(const std::string& fileName)
 {
-    std::string cpath = prefix + dirName;
-    if (cpath.back() != '/')
-        cpath.push_back('/');
-    std::cout << "scanning " << cpath << std::endl;
+    return fileName.length() == 12 && fileName[8] == '.'
+        && std::isdigit(fileName[9]) && std::isdigit(fileName[10]) && std::isdigit(fileName[11]);
+}
 
-    std::filesystem::path dirPath(dirName);
-    if (!std::filesystem::exists(dirPath) || !std::filesystem::is_directory(dirPath)) {
-        std::cerr << dirName << ": " << strerror(errno) << std::endl;
+// Lists the data set files and the subdirectories of the directory
+static void listDirectory(const std::string& cpath, bool withSubdirs,
+                          std::vector<std::string>& files, std::vector<std::string>& subdirs)
+{
+    std::error_code ec;
+    std::filesystem::directory_iterator it(cpath, ec), end;
+    if (ec) {
+        std::cerr << cpath << ": " << ec.message() << std::endl;
         return;
     }
 
-    std::filesystem::current_path(dirPath);
+    for (; it != end; it.increment(ec)) {
+        const std::filesystem::path& filePath = it->path();
+        std::error_code fec;
 
-    for (const auto& entry : std::filesystem::directory_iterator(dirPath)) {
-        const std::filesystem::path& filePath = entry.path();
-        std::error_code ec;
-
-        if (std::filesystem::is_directory(filePath, ec)) {
-            if (filePath.filename() != "." && filePath.filename() != ".." && _recursive)
-                doScan(cpath, filePath.filename().string());
+        if (it->is_directory(fec)) {
+            if (withSubdirs)
+                subdirs.push_back(cpath + filePath.filename().string() + "/");
         }
-        else if (std::filesystem::is_regular_file(filePath, ec)) {
+        else if (it->is_regular_file(fec)) {
             std::string fileName = filePath.filename().string();
-            if (fileName.length() == 12 && fileName[8] == '.' && std::isdigit(fileName[9]) && std::isdigit(fileName[10]) && std::isdigit(fileName[11])) {
-                std::string absolutePath = std::filesystem::current_path().string() + "/" + fileName;
-                onDataset(absolutePath);
-            }
+            if (isDatasetName(fileName))
+                files.push_back(cpath + fileName);
         }
         else {
-            std::cerr << filePath << ": " << strerror(ec.value()) << std::endl;
+            std::cerr << filePath << ": " << fec.message() << std::endl;
         }
     }
+    if (ec)
+        std::cerr << cpath << ": " << ec.message() << std::endl;
+}
+
+void S57DatasetScanner::doScan(const std::string& dirName)
+{
+    std::cout << "scanning " << dirName << std::endl;
+
+    std::vector<std::string> files, subdirs;
+    listDirectory(dirName, _recursive, files, subdirs);
+
+    for (size_t i = 0; i < files.size(); ++i)
+        onDataset(files[i]);
+    onDirectoryScanned(dirName);
+
+    for (size_t i = 0; i < subdirs.size(); ++i)
+        doScan(subdirs[i]);
+}
 
-    std::filesystem::current_path("..");
+void S57DatasetScanner::doParallelScan(const std::string& dirName)
+{
+    size_t nthreads = _walkThreadCount > 0 ? _walkThreadCount : std::thread::hardware_concurrency();
+    if (nthreads == 0)
+        nthreads = 1;
+
+    // Directories to be listed, and the number of the ones not done yet
+    std::deque<std::string> dirs(1, dirName);
+    size_t outstanding = 1;
+    std::mutex mutex;
+    std::condition_variable cond;
+    // Serializes the callbacks
+    std::mutex callbackMutex;
+
+    auto walk = [&]() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            cond.wait(lock, [&]() { return !dirs.empty() || outstanding == 0; });
+            if (dirs.empty())
+                break;
+            std::string cpath = dirs.front();
+            dirs.pop_front();
+            lock.unlock();
+
+            std::vector<std::string> files, subdirs;
+            listDirectory(cpath, _recursive, files, subdirs);
+
+            lock.lock();
+            dirs.insert(dirs.end(), subdirs.begin(), subdirs.end());
+            outstanding += subdirs.size();
+            if (!subdirs.empty())
+                cond.notify_all();
+            lock.unlock();
+
+            {
+                std::lock_guard<std::mutex> cbLock(callbackMutex);
+                for (size_t i = 0; i < files.size(); ++i)
+                    onDataset(files[i]);
+                onDirectoryScanned(cpath);
+            }
+
+            lock.lock();
+            if (--outstanding == 0)
+                cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> walkers;
+    for (size_t i = 1; i < nthreads; ++i)
+        walkers.push_back(std::thread(walk));
+    walk();
+    for (size_t i = 0; i < walkers.size(); ++i)
+        walkers[i].join();
+}
+
+void S57DatasetScanner::onDirectoryScanned(std::string)
+{
+    // do nothing
 }
 
 void S57DatasetScanner::scan(string path)
 {
-//    char cwd[256];
-//
-//    if (getcwd(cwd, 255) == NULL) {
-//        fprintf(stderr, "%s: %s\n", cwd, strerror(errno));
-//        exit(1);
-//    }
-
-    doScan("", path);
-
-//    if (chdir(cwd) == -1) {
-//        fprintf(stderr, "%s: %s\n", cwd, strerror(errno));
-//        exit(1);
-//    }
+    std::error_code ec;
+    std::filesystem::path dirPath = std::filesystem::absolute(path, ec);
+    if (ec || !std::filesystem::is_directory(dirPath, ec)) {
+        std::cerr << path << ": not a directory" << std::endl;
+        return;
+    }
+
+    std::string cpath = dirPath.lexically_normal().string();
+    if (cpath.back() != '/')
+        cpath.push_back('/');
+
+    if (_recursive && _walkThreadCount != 1)
+        doParallelScan(cpath);
+    else
+        doScan(cpath);
 }
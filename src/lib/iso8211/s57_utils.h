@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include <atomic>
 
 #include "iso8211_gloabal.h"
 
@@ -176,6 +177,43 @@ inline int RefBase::refCount() const
     return _refCount;
 }
 
+/*
+ * RefBase with an atomic reference count, for the objects
+ * referenced from more than one thread at a time.
+ */
+class ISO8211_EXPORT AtomicRefBase
+{
+private:
+    std::atomic<int> _refCount;
+
+public:
+    AtomicRefBase();
+
+    int ref();
+    int unref();
+    int refCount() const;
+};
+
+inline AtomicRefBase::AtomicRefBase()
+    : _refCount(0)
+{}
+
+inline int AtomicRefBase::ref()
+{
+    return _refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+inline int AtomicRefBase::unref()
+{
+    // the last owner must see all writes of the others before deleting
+    return _refCount.fetch_sub(1, std::memory_order_acq_rel) - 1;
+}
+
+inline int AtomicRefBase::refCount() const
+{
+    return _refCount.load(std::memory_order_relaxed);
+}
+
 template <class T>
 class ISO8211_EXPORT Ref
 {
@@ -186,7 +224,9 @@ public:
     Ref();
     Ref(T * p);
     Ref(const Ref & r);
+    Ref(Ref && r) noexcept;
     Ref & operator=(const Ref & r);
+    Ref & operator=(Ref && r) noexcept;
     ~Ref();
 
     T *  operator->() const;
@@ -221,6 +261,13 @@ inline Ref<T>::Ref(const Ref<T> & r)
         _rep->ref();
 }
 
+template <class T>
+inline Ref<T>::Ref(Ref<T> && r) noexcept
+    : _rep(r._rep)
+{
+    r._rep = (T *)NULL;
+}
+
 template <class T>
 inline Ref<T> & Ref<T>::operator=(const Ref<T> & r)
 {
@@ -232,6 +279,19 @@ inline Ref<T> & Ref<T>::operator=(const Ref<T> & r)
     return *this;
 }
 
+template <class T>
+inline Ref<T> & Ref<T>::operator=(Ref<T> && r) noexcept
+{
+    if (this != &r) {
+        T * old = _rep;
+        _rep = r._rep;
+        r._rep = (T *)NULL;
+        if (old != (T *)NULL && old->unref() == 0)
+            delete old;
+    }
+    return *this;
+}
+
 template <class T>
 inline Ref<T>::~Ref()
 {
@@ -310,14 +370,21 @@ class ISO8211_EXPORT S57DatasetScanner
 {
 private:
     bool _recursive;
+    int  _walkThreadCount;
 
 private:
-    void doScan(const std::string & prefix, const std::string & dirName);
+    // Both walks use absolute paths and never change the current directory
+    void doScan(const std::string & dirName);
+    void doParallelScan(const std::string & dirName);
 
 protected:
     // This function will be called while a S-57 dataset found.
     // the fileName is absolute filename of the dataset.
     virtual void onDataset(std::string fileName) = 0;
+    // Called once all the data sets of the directory have been passed
+    // to onDataset(), the dirName is absolute and ends with '/'.
+    // The callbacks are never called concurrently, even in a parallel walk.
+    virtual void onDirectoryScanned(std::string dirName);
 
 public:
     // Constructs a scanner with recursive = false
@@ -327,13 +394,20 @@ public:
     bool isRecursive() const;
     void setRecursive(bool);
 
+    int walkThreadCount() const;
+    // Sets the number of threads listing the directories in a recursive
+    // scan, in which case the order of the data sets found is not fixed.
+    // 0 uses one thread per hardware core, 1 (by default) walks the tree
+    // in the calling thread.
+    void setWalkThreadCount(int);
+
     void scan(std::string path);
 };
 
 // S57DatasetScanner inline functions
 
 inline S57DatasetScanner::S57DatasetScanner()
-    : _recursive(false)
+    : _recursive(false), _walkThreadCount(1)
 {}
 
 inline S57DatasetScanner::~S57DatasetScanner()
@@ -349,6 +423,16 @@ inline void S57DatasetScanner::setRecursive(bool enabled)
     _recursive = enabled;
 }
 
+inline int S57DatasetScanner::walkThreadCount() const
+{
+    return _walkThreadCount;
+}
+
+inline void S57DatasetScanner::setWalkThreadCount(int n)
+{
+    _walkThreadCount = n < 0 ? 1 : n;
+}
+
 // ~
 
 #endif
@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <errno.h>
@@ -19,7 +20,7 @@ static DebugAllocPrinter g_debugAllocPrinter;
 static void usage()
 {
 	printf("Convert the S57 dataset to related-image file.\n"
-			"usage: s57cast [-hcRBal] [-projdatum] [SOURCE] [-P] [DEST]\n"
+			"usage: s57cast [-hcRBalV] [-j N] [-w N] [-q N] [-s DIR] [-projdatum] [SOURCE] [-P] [DEST]\n"
 			"options:\n"
 			"  -h\t Show this usage help.\n"
 			"  -c\t Check data set before casting.\n"
@@ -27,6 +28,12 @@ static void usage()
 			"  -B\t Handle base cells only.\n"
 			"  -a\t Append new datasets to DEST lib.\n"
 			"  -l\t List module entries.\n"
+			"  -j N\t Cast datasets with N threads, 0 for all cores.\n"
+			"  -w N\t Walk the directories with N threads, 0 for all cores.\n"
+			"  -q N\t Cast each data set as soon as found, up to N queued.\n"
+			"  -s DIR\t Keep snapshots of the merged data sets in DIR,\n"
+			"        \t only newer update cells are merged on later runs.\n"
+			"  -V\t Verify the snapshots loaded against a full replay.\n"
 			"  -projdatum\t Set projection datum for Mercator.\n"
 			"      1: Krassovsky (BeiJing 54)\n"
 			"      2: IAG75 (XiAn 80)\n"
@@ -50,7 +57,7 @@ int main(int argc, char *argv[])
 	scanner.setUpdating(true);
 
 	for (;;) {
-		int c = getopt(argc, argv, "hcRBalP1234");
+		int c = getopt(argc, argv, "hcRBalP1234j:w:q:s:V");
 		if (c == -1)
 			break;
 
@@ -91,6 +98,21 @@ int main(int argc, char *argv[])
 		case 'P':
 			createDest = true;
 			break;
+		case 'j':
+			scanner.setThreadCount(atoi(optarg));
+			break;
+		case 'w':
+			scanner.setWalkThreadCount(atoi(optarg));
+			break;
+		case 'q':
+			scanner.setPipelineDepth(atoi(optarg));
+			break;
+		case 's':
+			scanner.setSnapshotPath(optarg);
+			break;
+		case 'V':
+			scanner.setSnapshotVerify(true);
+			break;
 		default:
 			usage();
 			return -1;
@@ -6,6 +6,10 @@
 #include <math.h>
 #include <sys/stat.h>
 #include <assert.h>
+#include <thread>
+#include <functional>
+#include <unordered_map>
+#include <algorithm>
 
 #include "../tools/LString.h"
 #include "../geo/utmproject.h"
@@ -33,11 +37,12 @@ static bool onFatalError()
 
 //
 // CastingSpatialItem used to save a casting S-57 vector recrod.
+// The coordinates are kept in a buffer shared by all items of the data set,
+// they are given projected, in decimeters.
 //
 class CastingSpatialItem
 {
 private:
-	static Mercator _mer;
 	Int32 *_pcoord;
 
 	void updateMBR(Int32 x, Int32 y);
@@ -45,7 +50,6 @@ private:
 public:
 	IR_SpatialRec _r;
 	Int32 *_coords;
-	static UInt32 _curCoordPos;
 
 	Int32 _y_max; 
 	Int32 _x_max; 
@@ -54,24 +58,19 @@ public:
 
 public:
 	CastingSpatialItem();
-	~CastingSpatialItem();
 
-	static void setProjDatumType(Mercator::DatumType);
+	// Sets the buffer of _r.coordCount coordinates, zero filled.
+	void setBuffer(Int32 *buf);
 
-	void allocBuffer();
-
-	void setBeginNode(double ux, double uy);
-	void setEndNode(double ux, double uy);
-	void addCoords(double ux, double uy, int z);
+	void setBeginNode(Int32 wx, Int32 wy);
+	void setEndNode(Int32 wx, Int32 wy);
+	void addCoords(Int32 wx, Int32 wy, int z);
 
 	void checkIfClosed();
 
 	GRect mbr() const;
 };
 
-Mercator CastingSpatialItem::_mer;
-UInt32 CastingSpatialItem::_curCoordPos = 0;
-
 void CastingSpatialItem::updateMBR(Int32 x, Int32 y)
 {
 	if (y > _y_max)
@@ -96,37 +95,16 @@ CastingSpatialItem::CastingSpatialItem()
 	_x_min = LONG_MAX;
 }
 
-CastingSpatialItem::~CastingSpatialItem()
-{
-	if (_coords != NULL)
-		delete[] _coords;
-}
-
-void CastingSpatialItem::setProjDatumType(Mercator::DatumType dtype)
+void CastingSpatialItem::setBuffer(Int32 *buf)
 {
-	_mer.setDatumType(dtype);
-}
-
-void CastingSpatialItem::allocBuffer()
-{
-	_coords = new Int32[_r.coordCount];
-	if (_coords == NULL) {
-		fprintf(stderr, "Lack of memory.\n");
-		exit(1);
-	}
-	memset(_coords, 0, sizeof(Int32) * _r.coordCount);
+	_coords = buf;
 	_pcoord = _coords;
 }
 
-void CastingSpatialItem::setBeginNode(double ux, double uy)
+void CastingSpatialItem::setBeginNode(Int32 wx, Int32 wy)
 {
-	double x, y;
-	Int32 wx, wy;
-	_mer.project(ux, uy, &x, &y);
-	x += (signbit(x) ? -0.05 : 0.05);
-	y += (signbit(y) ? -0.05 : 0.05);
-	*_pcoord++ = wy = static_cast<Int32>(y * 10.0);
-	*_pcoord++ = wx = static_cast<Int32>(x * 10.0);
+	*_pcoord++ = wy;
+	*_pcoord++ = wx;
 #ifndef NDEBUG
 	assert(_r.pairSize == 2);
 #else
@@ -137,30 +115,20 @@ void CastingSpatialItem::setBeginNode(double ux, double uy)
 	updateMBR(wx, wy);
 }
 
-void CastingSpatialItem::setEndNode(double ux, double uy)
+void CastingSpatialItem::setEndNode(Int32 wx, Int32 wy)
 {
-	double x, y;
-	Int32 wx, wy;
 	Int32 *ep = _coords + _r.coordCount - _r.pairSize;
-	_mer.project(ux, uy, &x, &y);
-	x += (signbit(x) ? -0.05 : 0.05);
-	y += (signbit(y) ? -0.05 : 0.05);
-	*ep++ = wy = static_cast<Int32>(y * 10.0);
-	*ep++ = wx = static_cast<Int32>(x * 10.0);
+	*ep++ = wy;
+	*ep++ = wx;
 	assert(_r.pairSize == 2);
 
 	updateMBR(wx, wy);
 }
 
-void CastingSpatialItem::addCoords(double ux, double uy, int z)
+void CastingSpatialItem::addCoords(Int32 wx, Int32 wy, int z)
 {
-	double x, y;
-	Int32 wx, wy;
-	_mer.project(ux, uy, &x, &y);
-	x += (signbit(x) ? -0.05 : 0.05);
-	y += (signbit(y) ? -0.05 : 0.05);
-	*_pcoord++ = wy = static_cast<Int32>(y * 10.0);
-	*_pcoord++ = wx = static_cast<Int32>(x * 10.0);
+	*_pcoord++ = wy;
+	*_pcoord++ = wx;
 	if (_r.pairSize == 3)
 		*_pcoord++ = z;
 
@@ -182,6 +150,40 @@ GRect CastingSpatialItem::mbr() const
 
 // ~
 
+//
+// Output position of a feature record, the target of FFPTs.
+//
+struct CastingFeaturePos
+{
+	UInt32 pos; // Index in the output feature records
+	bool isDeleted;
+};
+
+// ~
+
+static void appendBytes(string &buf, const void *p, size_t size)
+{
+	buf.append(reinterpret_cast<const char *>(p), size);
+}
+
+static void appendLeader(string &buf, char identifier, 
+				UInt32 areaLength, UInt32 dataOffset, UInt32 dirSize, 
+				UInt8 dataVersion = 1)
+{
+	IR_DataAreaLeader leader;
+	memset(&leader, 0, sizeof(IR_DataAreaLeader));
+	leader.dataIdentifier = identifier;
+	leader.dataVersion = dataVersion;
+	leader.extension[0] = ' ';
+	leader.extension[1] = ' ';
+	leader.extension[2] = ' ';
+	leader.extension[3] = ' ';
+	leader.areaLength = areaLength;
+	leader.dataOffset = dataOffset;
+	leader.dirSize = dirSize;
+	appendBytes(buf, &leader, sizeof(IR_DataAreaLeader));
+}
+
 // S57CastScanner members
 
 bool S57CastScanner::loadModuleList(string indexFile, 
@@ -206,6 +208,13 @@ bool S57CastScanner::loadModuleList(string indexFile,
 	if (minor != NULL)
 		*minor = mi;
 
+	// the R-tree area of an older index is not the flat image
+	if (ma != IRV_MAJOR || mi < IRV_MINOR) {
+		fprintf(stderr, "%s: unsupported index version %d.%d\n", indexFile.c_str(), ma, mi);
+		fclose(fp);
+		return false;
+	}
+
 	IR_DataAreaLeader leader;
 	as_fread(&leader, sizeof(IR_DataAreaLeader), 1, fp);
 	if (leader.dataIdentifier != 'I') {
@@ -238,6 +247,9 @@ void S57CastScanner::init()
 {
 	memset(&_irParam, 0, sizeof(_irParam));
 	_comf = 0.0;
+	_threadCount = 1;
+	_deferRegister = false;
+	_castEntry = NULL;
 }
 
 void S57CastScanner::registerCurModule()
@@ -250,7 +262,6 @@ void S57CastScanner::registerCurModule()
 
 	memset(ent, 0, sizeof(IR_ModuleEntry));
 
-	ent->id = _irModuleDir.size() + 1;
 	memcpy(ent->dsnm, _irParam.dsnm, 16);
 	ent->mpdt = _irParam.mpdt;
 	ent->intu = _irParam.intu;
@@ -262,11 +273,22 @@ void S57CastScanner::registerCurModule()
 	ent->y_min = _irParam.y_min;
 	ent->x_min = _irParam.x_min;
 
+	if (_deferRegister)
+		_castEntry = ent;
+	else
+		registerModuleEntry(ent);
+}
+
+void S57CastScanner::registerModuleEntry(IR_ModuleEntry *ent)
+{
+	ent->id = _irModuleDir.size() + 1;
+
 	// The dataset module must be added once.
 	vector<IR_ModuleEntry *>::iterator it = _irModuleDir.begin();
 	for (; it != _irModuleDir.end(); ++it) {
 		if (memcmp(ent->dsnm, (*it)->dsnm, 16) == 0) {
 			fprintf(stderr, "'%s\' already exists.\n", ent->dsnm);
+			delete ent;
 			return;
 		}
 	}
@@ -280,34 +302,58 @@ void S57CastScanner::registerCurModule()
 
 void S57CastScanner::saveIrFile(FILE *fp)
 {
-	vector<IR_FFPtrRec *> irFfptList;
-	vector<IR_FSPtrRec *> irFsptList;
-	vector<IR_FeatureRec *> irFrList;
-	vector<IR_DirEntry *> irAttrDir;
+	vector<IR_FFPtrRec> irFfptList;
+	vector<IR_FSPtrRec> irFsptList;
+	vector<IR_FeatureRec> irFrList;
+	vector<IR_DirEntry> irAttrDir;
 	string attrString;
-	vector<CastingSpatialItem *> cspaList;
+	vector<CastingSpatialItem> cspaList;
+	vector<Int32> coordBuf; // Coordinates of all spatial items
+	vector<double> lonBuf, latBuf; // Coordinates of a spatial item to project
+	vector<int32_t> wxBuf, wyBuf;
+	unordered_map<unsigned long long, CastingFeaturePos> lnamMap; // LNAM key to feature
+	unordered_map<unsigned long long, UInt32> spaMap; // NAME key to index of cspaList
+	vector<RT_Item> treeItems; // MBRs of the geo features
 	RTree *tree;
 	GRect dsMbr;
-
-	vector<S57FeatureRecordRef> tmpfrs;
-	tmpfrs.insert(tmpfrs.end(), grList().begin(), grList().end());
-	tmpfrs.insert(tmpfrs.end(), mrList().begin(), mrList().end());
-	tmpfrs.insert(tmpfrs.end(), lrList().begin(), lrList().end());
+	UInt32 curCoordPos = 0;
+
+	// All the features in output order, borrowed from the record lists
+	vector<const S57FeatureRecord *> tmpfrs;
+	tmpfrs.reserve(grList().size() + mrList().size() + lrList().size());
+	vector<S57FeatureRecordRef>::const_iterator lit = grList().begin();
+	for (; lit != grList().end(); ++lit)
+		tmpfrs.push_back(lit->getPtr());
+	for (lit = mrList().begin(); lit != mrList().end(); ++lit)
+		tmpfrs.push_back(lit->getPtr());
+	for (lit = lrList().begin(); lit != lrList().end(); ++lit)
+		tmpfrs.push_back(lit->getPtr());
+
+	// Sizes the staging buffers at once, all of them are released
+	// together when the data set is written.
+	size_t nCoords = 0;
+	vector<S57VectorRecordRef>::const_iterator vit = vrList().begin();
+	for (; vit != vrList().end(); ++vit) {
+		const S57VectorRecord *theVr = vit->getPtr();
+		if (theVr->isDeleted())
+			continue;
+		int pairSize = theVr->coordType() == S57VectorRecord::SG3D ? 3 : 2;
+		nCoords += (theVr->coords().size() + theVr->fieldsVRPT().size()) * pairSize;
+	}
+	coordBuf.resize(nCoords);
+	cspaList.reserve(vrList().size());
+	irFrList.reserve(tmpfrs.size());
 
 	// For each vector record extracts coordinates and gets the MBR.
-	CastingSpatialItem::_curCoordPos = 0;
-	vector<S57VectorRecordRef>::const_iterator vit = vrList().begin();
+	vit = vrList().begin();
 	for (; vit != vrList().end(); ++vit) {
 		const S57VectorRecord *theVr = vit->getPtr(); // the vector record
 		if (theVr->isDeleted())
 			continue;
 
-		CastingSpatialItem *cspa = new CastingSpatialItem;
-		if (cspa == NULL) {
-			fprintf(stderr, "Lack of memory.\n");
-			exit(1);
-		}
-		cspaList.push_back(cspa);
+		spaMap.emplace(theVr->fieldVRID()->_name.key(), cspaList.size());
+		cspaList.emplace_back();
+		CastingSpatialItem *cspa = &cspaList.back();
 		cspa->_r.rcnm = theVr->fieldVRID()->_name._rcnm;
 		cspa->_r.rcid = theVr->fieldVRID()->_name._rcid;
 
@@ -332,16 +378,16 @@ void S57CastScanner::saveIrFile(FILE *fp)
 			cspa->_r.pairSize = 3;
 		else
 			assert(0);
-		cspa->_r.coordPos = CastingSpatialItem::_curCoordPos;
-		cspa->_r.coordCount = theVr->coords().size() 
-				+ theVr->fieldsVRPT().size() * cspa->_r.pairSize;
-		cspa->allocBuffer();
+		cspa->_r.coordPos = curCoordPos;
+		cspa->_r.coordCount = (theVr->coords().size() 
+				+ theVr->fieldsVRPT().size()) * cspa->_r.pairSize;
+		cspa->setBuffer(coordBuf.data() + curCoordPos);
 
-		CastingSpatialItem::_curCoordPos += cspa->_r.coordCount;
+		curCoordPos += cspa->_r.coordCount;
 
 		for (int i = 0; i < static_cast<int>(theVr->fieldsVRPT().size()); ++i) {
 			const S57_VRPT &vrpt = theVr->fieldsVRPT()[i];
-			S57VectorRecordRef toVr = findVectorTarget(vrpt._name);
+			const S57VectorRecordRef &toVr = findVectorTarget(vrpt._name);
 			if (toVr.isNull() || toVr->isDeleted()) {
 				// Fatal error!
 				fprintf(stderr, "Vector [%s]: invalid VRPT to %s\n", 
@@ -372,20 +418,32 @@ void S57CastScanner::saveIrFile(FILE *fp)
 				}
 			}
 
-			double uy = toVr->coords()[0] / _comf;
-			double ux = toVr->coords()[1] / _comf;
+			double uy = toVr->coords().y(0) / _comf;
+			double ux = toVr->coords().x(0) / _comf;
+			int32_t wx, wy;
+			_mer.projectDm(&ux, &uy, &wx, &wy, 1);
 			if (vrpt._topi == TOPI_B)
-				cspa->setBeginNode(ux, uy);
+				cspa->setBeginNode(wx, wy);
 			else if (vrpt._topi == TOPI_E)
-				cspa->setEndNode(ux, uy);
+				cspa->setEndNode(wx, wy);
 		}
 
-		const vector<s57_b24> &coords = theVr->coords();
-		for (int i = 0; i < static_cast<int>(coords.size()); i += cspa->_r.pairSize) {
-			double uy = coords[i] / _comf;
-			double ux = coords[i + 1] / _comf;
-			cspa->addCoords(ux, uy, coords[i + 2]);
+		// Projects the coordinates of the record at once
+		const S57CoordArray &coords = theVr->coords();
+		size_t npts = coords.size();
+		lonBuf.resize(npts);
+		latBuf.resize(npts);
+		wxBuf.resize(npts);
+		wyBuf.resize(npts);
+		const int32_t *ys = coords.ys();
+		const int32_t *xs = coords.xs();
+		for (size_t i = 0; i < npts; ++i) {
+			latBuf[i] = ys[i] / _comf;
+			lonBuf[i] = xs[i] / _comf;
 		}
+		_mer.projectDm(lonBuf.data(), latBuf.data(), wxBuf.data(), wyBuf.data(), npts);
+		for (size_t i = 0; i < npts; ++i)
+			cspa->addCoords(wxBuf[i], wyBuf[i], coords.z(i));
 
 		cspa->checkIfClosed();
 
@@ -398,10 +456,10 @@ void S57CastScanner::saveIrFile(FILE *fp)
 		for (; ait != theVr->fieldsATTV().end(); ++ait) {
 			switch (ait->_attl) {
 			case 401: // POSACC
-				cspa->_r.posacc = static_cast<UInt32>(strToFloat(ait->_atvl) * 10.0);
+				cspa->_r.posacc = static_cast<UInt32>(ait->floatValue() * 10.0);
 				break;
 			case 402: // UQAPOS
-				cspa->_r.quapos = strToInt(ait->_atvl);
+				cspa->_r.quapos = ait->intValue();
 				break;
 			default:
 				break;
@@ -409,19 +467,31 @@ void S57CastScanner::saveIrFile(FILE *fp)
 		}
 	}
 
+	assert(curCoordPos <= coordBuf.size());
+	coordBuf.resize(curCoordPos);
+
+	// Maps each LNAM to its output index, counting the records not deleted.
+	// The first record of a LNAM is the FFPT target, even if it's deleted.
+	UInt32 nFrs = 0;
+	vector<const S57FeatureRecord *>::const_iterator fit = tmpfrs.begin();
+	for (; fit != tmpfrs.end(); ++fit) {
+		if ((*fit)->fieldFOID() != NULL) {
+			CastingFeaturePos fpos = { nFrs, (*fit)->isDeleted() };
+			lnamMap.emplace((*fit)->fieldFOID()->key(), fpos);
+		}
+		if (!(*fit)->isDeleted())
+			++nFrs;
+	}
+
 	// For each features, extracts its FFPT, FSPT and attributes.
-	vector<S57FeatureRecordRef>::iterator fit = tmpfrs.begin();
+	fit = tmpfrs.begin();
 	for (; fit != tmpfrs.end(); ++fit) {
-		const S57FeatureRecord *theFr = fit->getPtr(); // the feature record
+		const S57FeatureRecord *theFr = *fit; // the feature record
 		if (theFr->isDeleted())
 			continue;
 
-		IR_FeatureRec *frbuf = new IR_FeatureRec;
-		if (frbuf == NULL) {
-			fprintf(stderr, "Lack of memory.\n");
-			exit(1);
-		}
-		irFrList.push_back(frbuf);
+		irFrList.resize(irFrList.size() + 1);
+		IR_FeatureRec *frbuf = &irFrList.back();
 
 		memset(frbuf, 0, sizeof(IR_FeatureRec));
 		frbuf->rcnm = theFr->fieldFRID()->_name._rcnm;
@@ -455,25 +525,21 @@ void S57CastScanner::saveIrFile(FILE *fp)
 		for (int i = 0; i < 2; ++i) {
 			vector<S57_AttItem>::const_iterator ait = atts[i]->begin();
 			for (; ait != atts[i]->end(); ++ait) {
-				IR_DirEntry *ent = new IR_DirEntry;
-				if (ent == NULL) {
-					fprintf(stderr, "Lack of memory.\n");
-					exit(1);
-				}
+				IR_DirEntry ent;
+				ent.label = ait->_attl;
+				ent.pos = attrString.size();
+				ent.size = ait->atvl().size();
 				irAttrDir.push_back(ent);
-				ent->label = ait->_attl;
-				ent->pos = attrString.size();
-				ent->size = ait->_atvl.size();
 
-				attrString.append(ait->_atvl);
+				attrString.append(ait->atvl());
 				attrString.push_back('\0');
 
 				switch (ait->_attl) {
 				case 132: // SCAMAX
-					frbuf->scale_max = strToInt(ait->_atvl);
+					frbuf->scale_max = ait->intValue();
 					break;
 				case 133: // SCAMIN
-					frbuf->scale_min = strToInt(ait->_atvl);
+					frbuf->scale_min = ait->intValue();
 					break;
 				default:
 					break;
@@ -487,33 +553,22 @@ void S57CastScanner::saveIrFile(FILE *fp)
 
 		vector<S57_FFPT>::const_iterator ffit = theFr->fieldsFFPT().begin();
 		for (; ffit != theFr->fieldsFFPT().end(); ++ffit) {
-			IR_FFPtrRec *ffrbuf = new IR_FFPtrRec;
-			if (ffrbuf == NULL) {
-				fprintf(stderr, "Lack of memory.\n");
-				exit(1);
-			}
+			IR_FFPtrRec ffrbuf;
+			memset(&ffrbuf, 0, sizeof(IR_FFPtrRec));
 			// Finds the target, get its index.
-			unsigned int pos = 0;
-			vector<S57FeatureRecordRef>::iterator toFr = tmpfrs.begin();
-			for (; toFr != tmpfrs.end(); ++toFr) {
-				if ((*toFr)->fieldFOID() != NULL && *((*toFr)->fieldFOID()) == ffit->_lnam)
-					break;
-				if (!(*toFr)->isDeleted())
-					++pos;
-			}
+			unordered_map<unsigned long long, CastingFeaturePos>::const_iterator toFr 
+					= lnamMap.find(ffit->_lnam.key());
 
-			if (toFr == tmpfrs.end()) 
+			if (toFr == lnamMap.end()) 
 				fprintf(stderr, "Feature [%s]: invalid FFPT to [%s]\n", 
 						(*fit)->fieldFRID()->_name.toString().c_str(), ffit->_lnam.toString().c_str());
 
-			if (toFr != tmpfrs.end() && !(*toFr)->isDeleted()) {
-				ffrbuf->pos = pos;
-				ffrbuf->rind = ffit->_rind;
+			if (toFr != lnamMap.end() && !toFr->second.isDeleted) {
+				ffrbuf.pos = toFr->second.pos;
+				ffrbuf.rind = ffit->_rind;
 				irFfptList.push_back(ffrbuf);
 				++frbuf->ffptCount;
 			}
-			else
-				delete ffrbuf;
 		}
 
 		// FSPTs
@@ -522,52 +577,39 @@ void S57CastScanner::saveIrFile(FILE *fp)
 
 		vector<S57_FSPT>::const_iterator fsit = theFr->fieldsFSPT().begin();
 		for (; fsit != theFr->fieldsFSPT().end(); ++fsit) {
-			IR_FSPtrRec *fsrbuf = new IR_FSPtrRec;
-			if (fsrbuf == NULL) {
-				fprintf(stderr, "Lack of memory.\n");
-				exit(1);
-			}
+			IR_FSPtrRec fsrbuf;
+			memset(&fsrbuf, 0, sizeof(IR_FSPtrRec));
 			// Finds the target, get its index.
-			vector<CastingSpatialItem *>::iterator toSp = cspaList.begin();
-			for (; toSp != cspaList.end(); ++toSp) {
-				if ((*toSp)->_r.rcnm == fsit->_name._rcnm && (*toSp)->_r.rcid == fsit->_name._rcid)
-					break;
-			}
-
-			if (toSp != cspaList.end()) {
-				fsrbuf->pos = toSp - cspaList.begin();
-				fsrbuf->ornt = fsit->_ornt;
-				fsrbuf->usag = fsit->_usag;
-				fsrbuf->mask = fsit->_mask;
+			unordered_map<unsigned long long, UInt32>::const_iterator toSp 
+					= spaMap.find(fsit->_name.key());
+
+			if (toSp != spaMap.end()) {
+				fsrbuf.pos = toSp->second;
+				fsrbuf.ornt = fsit->_ornt;
+				fsrbuf.usag = fsit->_usag;
+				fsrbuf.mask = fsit->_mask;
 				irFsptList.push_back(fsrbuf);
 				++frbuf->fsptCount;
 			}
-			else
-				delete fsrbuf;
 		}
 	}
 
 	// Update the MBR of the features, and makes the quick
 	// index of the geo features.
-	tree = rtreeCreate();
-	if (tree == NULL) {
-		fprintf(stderr, "Fail to create R-tree.\n");
-		exit(1);
-	}
-
-	vector<IR_FeatureRec *>::iterator ir_fit = irFrList.begin();
+	treeItems.reserve(grList().size());
+	vector<IR_FeatureRec>::iterator ir_fit = irFrList.begin();
 	for (; ir_fit != irFrList.end(); ++ir_fit) {
 		GRect fmbr;
-		for (int i = 0; i < (*ir_fit)->fsptCount; ++i) {
-			IR_FSPtrRec *ir_fspt = irFsptList[(*ir_fit)->fsptPos + i];
-			fmbr |= cspaList[ir_fspt->pos]->mbr();
+		for (int i = 0; i < ir_fit->fsptCount; ++i) {
+			const IR_FSPtrRec &ir_fspt = irFsptList[ir_fit->fsptPos + i];
+			fmbr |= cspaList[ir_fspt.pos].mbr();
 		}
-		(*ir_fit)->y_max = fmbr.top();
-		(*ir_fit)->x_max = fmbr.right();
-		(*ir_fit)->y_min = fmbr.bottom();
-		(*ir_fit)->x_min = fmbr.left();
+		ir_fit->y_max = fmbr.top();
+		ir_fit->x_max = fmbr.right();
+		ir_fit->y_min = fmbr.bottom();
+		ir_fit->x_min = fmbr.left();
 
-		if ((*ir_fit)->objl < 300) {
+		if (ir_fit->objl < 300) {
 			/*assert(fmbr.isValid());*/
 			// Here the index is global index of the feature records, 
 			// but it is also the index of the geo features, because the geo features
@@ -575,11 +617,22 @@ void S57CastScanner::saveIrFile(FILE *fp)
 			// I want to say is the value passed to the R-tree is it shoule to be.
 			UInt32 index = ir_fit - irFrList.begin();
 			assert(index < grList().size()); 
-			rtreeInsert(tree, fmbr.left(), fmbr.bottom(), fmbr.right(), fmbr.top(), 
-					reinterpret_cast<void *>(index + 1));
+			RT_Item item;
+			item.minX = fmbr.left();
+			item.minY = fmbr.bottom();
+			item.maxX = fmbr.right();
+			item.maxY = fmbr.top();
+			item.data = reinterpret_cast<void *>(index + 1);
+			treeItems.push_back(item);
 		}
 	}
 
+	tree = rtreeBulkLoad(treeItems.data(), treeItems.size());
+	if (tree == NULL) {
+		fprintf(stderr, "Fail to create R-tree.\n");
+		exit(1);
+	}
+
 	assert(dsMbr.isValid());
 	_irParam.y_max = dsMbr.top();
 	_irParam.x_max = dsMbr.right();
@@ -592,150 +645,98 @@ void S57CastScanner::saveIrFile(FILE *fp)
 	//               Writes IR file               //
 	////////////////////////////////////////////////
 
-	IR_DataAreaLeader leader;
-	IR_DirEntry *dir = NULL;
-	long areaStart;
-	long contentsStart;
-	long posSave;
+	// Each area is staged in memory with its leader, the offsets
+	// are known before, then written at once.
+	string area;
 	int i;
 
 	//
-	// Writes the file header
+	// Writes the file header and record area
 	//
-	char lh[2] = { 'L', 'H' };
+	const char lh[2] = { 'L', 'H' };
 	UInt16 major = IRV_MAJOR;
 	UInt16 minor = IRV_MINOR;
 
-	as_fwrite(lh, 1, 2, fp);
-	as_fwrite(&major, sizeof(UInt16), 1, fp);
-	as_fwrite(&minor, sizeof(UInt16), 1, fp);
-	as_fwrite(&_irParam, sizeof(IR_DatasetParam), 1, fp);
-
-	//
-	// Writes record area 
-	//
-	dir = new IR_DirEntry[6];
-	if (dir == NULL) {
-		fprintf(stderr, "Lack of memory.\n");
-		exit(1);
-	}
-
-	areaStart = as_ftell(fp);
-
-	memset(&leader, 0, sizeof(IR_DataAreaLeader));
-	memset(dir, 0, sizeof(IR_DirEntry) * 6);
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
-	as_fwrite(dir, sizeof(IR_DirEntry), 6, fp);
-
-	contentsStart = as_ftell(fp);
+	IR_DirEntry dir[6];
+	memset(dir, 0, sizeof(dir));
 
 	dir[0].label = 1;
 	dir[0].pos = 0;
 	dir[0].size = irFfptList.size();
-	for (i = 0; i < static_cast<int>(irFfptList.size()); ++i)
-		as_fwrite(irFfptList[i], sizeof(IR_FFPtrRec), 1, fp);
 
 	dir[1].label = 2;
-	dir[1].pos = as_ftell(fp) - contentsStart;
+	dir[1].pos = dir[0].pos + sizeof(IR_FFPtrRec) * dir[0].size;
 	dir[1].size = irFsptList.size();
-	for (i = 0; i < static_cast<int>(irFsptList.size()); ++i)
-		as_fwrite(irFsptList[i], sizeof(IR_FSPtrRec), 1, fp);
 
+	// The geo, meta and collection directories all hold the start of
+	// the feature records, which are stored in that order.
 	dir[2].label = 3;
-	dir[2].pos = as_ftell(fp) - contentsStart;
+	dir[2].pos = dir[1].pos + sizeof(IR_FSPtrRec) * dir[1].size;
 	dir[2].size = 0;
 	for (i = 0; i < static_cast<int>(grList().size()); ++i)
 		if (!grList()[i]->isDeleted())
 			++dir[2].size;
 
 	dir[3].label = 4;
-	dir[3].pos = as_ftell(fp) - contentsStart;
+	dir[3].pos = dir[2].pos;
 	dir[3].size = 0;
 	for (i = 0; i < static_cast<int>(mrList().size()); ++i)
 		if (!mrList()[i]->isDeleted())
 			++dir[3].size;
 
 	dir[4].label = 5;
-	dir[4].pos = as_ftell(fp) - contentsStart;
+	dir[4].pos = dir[2].pos;
 	dir[4].size = 0;
 	for (i = 0; i < static_cast<int>(lrList().size()); ++i)
 		if (!lrList()[i]->isDeleted())
 			++dir[4].size;
-
-	for (i = 0; i < static_cast<int>(irFrList.size()); ++i)
-		as_fwrite(irFrList[i], sizeof(IR_FeatureRec), 1, fp);
+	assert(dir[2].size + dir[3].size + dir[4].size == irFrList.size());
 
 	dir[5].label = 6;
-	dir[5].pos = as_ftell(fp) - contentsStart;
+	dir[5].pos = dir[2].pos + sizeof(IR_FeatureRec) * irFrList.size();
 	dir[5].size = cspaList.size();
-	for (i = 0; i < static_cast<int>(cspaList.size()); ++i)
-		as_fwrite(&(cspaList[i]->_r), sizeof(IR_SpatialRec), 1, fp);
 
-	posSave = as_ftell(fp);
+	size_t headerSize = sizeof(IR_DataAreaLeader) + sizeof(IR_DirEntry) * 6;
+	size_t areaLength = headerSize + dir[5].pos + sizeof(IR_SpatialRec) * dir[5].size;
 
-	// writes back the data area header
-	leader.dataIdentifier = 'R';
-	leader.dataVersion = 1;
-	leader.extension[0] = ' ';
-	leader.extension[1] = ' ';
-	leader.extension[2] = ' ';
-	leader.extension[3] = ' ';
-	leader.areaLength = posSave - areaStart;
-	leader.dataOffset = sizeof(IR_DataAreaLeader) + sizeof(IR_DirEntry) * 6;
-	leader.dirSize = 6;
-	as_fseek(fp, areaStart, SEEK_SET);
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
-	as_fwrite(dir, sizeof(IR_DirEntry), 6, fp);
-	as_fseek(fp, posSave, SEEK_SET);
+	area.reserve(sizeof(lh) + sizeof(UInt16) * 2 + sizeof(IR_DatasetParam) + areaLength);
+	appendBytes(area, lh, sizeof(lh));
+	appendBytes(area, &major, sizeof(UInt16));
+	appendBytes(area, &minor, sizeof(UInt16));
+	appendBytes(area, &_irParam, sizeof(IR_DatasetParam));
 
-	delete[] dir;
-	dir = NULL;
+	appendLeader(area, 'R', areaLength, headerSize, 6);
+	appendBytes(area, dir, sizeof(IR_DirEntry) * 6);
+	appendBytes(area, irFfptList.data(), sizeof(IR_FFPtrRec) * irFfptList.size());
+	appendBytes(area, irFsptList.data(), sizeof(IR_FSPtrRec) * irFsptList.size());
+	appendBytes(area, irFrList.data(), sizeof(IR_FeatureRec) * irFrList.size());
+	for (i = 0; i < static_cast<int>(cspaList.size()); ++i)
+		appendBytes(area, &(cspaList[i]._r), sizeof(IR_SpatialRec));
+	as_fwrite(area.data(), 1, area.size(), fp);
 
 	//
 	// Writes attribute area
 	//
-	areaStart = as_ftell(fp);
+	headerSize = sizeof(IR_DataAreaLeader) + sizeof(IR_DirEntry) * irAttrDir.size();
+	areaLength = headerSize + attrString.size();
 
-	size_t headerSize = sizeof(IR_DataAreaLeader) + sizeof(IR_DirEntry) * irAttrDir.size();
-	leader.dataIdentifier = 'A';
-	leader.dataVersion = 1;
-	leader.extension[0] = ' ';
-	leader.extension[1] = ' ';
-	leader.extension[2] = ' ';
-	leader.extension[3] = ' ';
-	leader.areaLength = headerSize + attrString.size();
-	leader.dataOffset = headerSize;
-	leader.dirSize = irAttrDir.size();
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
-	for (i = 0; i < static_cast<int>(irAttrDir.size()); ++i)
-		as_fwrite(irAttrDir[i], sizeof(IR_DirEntry), 1, fp);
-	as_fwrite(attrString.data(), 1, attrString.size(), fp);
-	assert((as_ftell(fp) - areaStart) == leader.areaLength);
+	area.clear();
+	area.reserve(areaLength);
+	appendLeader(area, 'A', areaLength, headerSize, irAttrDir.size());
+	appendBytes(area, irAttrDir.data(), sizeof(IR_DirEntry) * irAttrDir.size());
+	area.append(attrString);
+	assert(area.size() == areaLength);
+	as_fwrite(area.data(), 1, area.size(), fp);
 
 	//
-	// Writes coordinate area
+	// Writes coordinate area, the coordinates are already contiguous
 	//
-	areaStart = as_ftell(fp);
-
-	memset(&leader, 0, sizeof(IR_DataAreaLeader));
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
-	for (i = 0; i < static_cast<int>(cspaList.size()); ++i)
-		as_fwrite(cspaList[i]->_coords, sizeof(Int32), cspaList[i]->_r.coordCount, fp);
-
-	posSave = as_ftell(fp);
+	areaLength = sizeof(IR_DataAreaLeader) + sizeof(Int32) * coordBuf.size();
 
-	leader.dataIdentifier = 'C';
-	leader.dataVersion = 1;
-	leader.extension[0] = ' ';
-	leader.extension[1] = ' ';
-	leader.extension[2] = ' ';
-	leader.extension[3] = ' ';
-	leader.areaLength = posSave - areaStart;
-	leader.dataOffset = sizeof(IR_DataAreaLeader);
-	leader.dirSize = 0;
-	as_fseek(fp, areaStart, SEEK_SET);
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
-	as_fseek(fp, posSave, SEEK_SET);
+	area.clear();
+	appendLeader(area, 'C', areaLength, sizeof(IR_DataAreaLeader), 0);
+	as_fwrite(area.data(), 1, area.size(), fp);
+	as_fwrite(coordBuf.data(), sizeof(Int32), coordBuf.size(), fp);
 
 	//
 	// Writes R-tree area
@@ -744,40 +745,23 @@ void S57CastScanner::saveIrFile(FILE *fp)
 
 	as_fflush(fp);
 
-	// Release all allocated memory
-	for (i = 0; i < static_cast<int>(irFfptList.size()); ++i)
-		delete irFfptList[i];
-	for (i = 0; i < static_cast<int>(irFsptList.size()); ++i)
-		delete irFsptList[i];
-	for (i = 0; i < static_cast<int>(irFrList.size()); ++i)
-		delete irFrList[i];
-	for (i = 0; i < static_cast<int>(irAttrDir.size()); ++i)
-		delete irAttrDir[i];
-	for (i = 0; i < static_cast<int>(cspaList.size()); ++i)
-		delete cspaList[i];
 	rtreeDestroy(tree);
 }
 
 void S57CastScanner::writeRTreeArea(FILE *fp, RTree *tree)
 {
-	IR_DataAreaLeader leader;
-	long areaStart = as_ftell(fp);
-
-	memset(&leader, 0, sizeof(IR_DataAreaLeader));
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
-	rtreeSave(tree, fp);
-
-	leader.dataIdentifier = 'Q';
-	leader.dataVersion = 1;
-	leader.extension[0] = ' ';
-	leader.extension[1] = ' ';
-	leader.extension[2] = ' ';
-	leader.extension[3] = ' ';
-	leader.areaLength = as_ftell(fp) - areaStart;
-	leader.dataOffset = sizeof(IR_DataAreaLeader);
-	leader.dirSize = 0;
-	as_fseek(fp, areaStart, SEEK_SET);
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
+	// The flat image is searched in place on the mapped file, 
+	// so its start is aligned in the file.
+	size_t imageSize = rtreeFlatImageSize(tree);
+	size_t dataOffset = sizeof(IR_DataAreaLeader);
+	dataOffset += (RT_IMAGE_ALIGN - (as_ftell(fp) + dataOffset) % RT_IMAGE_ALIGN) % RT_IMAGE_ALIGN;
+	string area;
+
+	area.reserve(dataOffset + imageSize);
+	appendLeader(area, 'Q', dataOffset + imageSize, dataOffset, 0, IR_RTREE_FLAT);
+	area.resize(dataOffset + imageSize, '\0');
+	rtreeSaveFlatImage(tree, &area[dataOffset]);
+	as_fwrite(area.data(), 1, area.size(), fp);
 }
 
 void S57CastScanner::onRecDsInfo(S57DSInfoRecord *r)
@@ -846,6 +830,128 @@ void S57CastScanner::onParse(const DsItem &ds)
 	fclose(fp);
 }
 
+size_t S57CastScanner::workerCount() const
+{
+	size_t nthreads = _threadCount > 0 ? _threadCount : thread::hardware_concurrency();
+	return nthreads > 0 ? nthreads : 1;
+}
+
+void S57CastScanner::setupWorker(S57CastScanner &worker) const
+{
+	S57ParseScanner::setupWorker(worker);
+	worker._outputPath = _outputPath;
+	worker._deferRegister = true;
+}
+
+bool S57CastScanner::claimFamily(const DsItem &ds, unordered_set<string> &families)
+{
+	// the module file is named by family, a later data set of the family
+	// would overwrite it
+	if (families.insert(ds.family()).second)
+		return true;
+	fprintf(stderr, "%s: family casted from another data set, skipped\n", ds.dsFile().c_str());
+	return false;
+}
+
+void S57CastScanner::parseDatasets(vector<DsItem> &dsList)
+{
+	unordered_set<string> families;
+	size_t n = 0;
+	for (size_t i = 0; i < dsList.size(); ++i)
+		if (claimFamily(dsList[i], families))
+			dsList[n++] = dsList[i];
+	dsList.resize(n);
+
+	size_t nthreads = workerCount();
+	if (nthreads > dsList.size())
+		nthreads = dsList.size();
+	if (nthreads <= 1) {
+		S57ParseScanner::parseDatasets(dsList);
+		return;
+	}
+
+	vector<IR_ModuleEntry *> entries(dsList.size(), NULL);
+	atomic<size_t> next(0);
+
+	vector<thread> workers;
+	for (size_t i = 0; i < nthreads; ++i)
+		workers.push_back(thread(&S57CastScanner::castWorker, this, 
+					ref(dsList), ref(entries), ref(next)));
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	// Registers the modules as the data sets were casted one by one.
+	for (size_t i = 0; i < entries.size(); ++i)
+		if (entries[i] != NULL)
+			registerModuleEntry(entries[i]);
+}
+
+void S57CastScanner::castWorker(vector<DsItem> &dsList, 
+					vector<IR_ModuleEntry *> &entries, 
+					atomic<size_t> &next)
+{
+	S57CastScanner worker;
+	setupWorker(worker);
+
+	for (;;) {
+		size_t i = next++;
+		if (i >= dsList.size())
+			break;
+		worker._castEntry = NULL;
+		worker.doParse(dsList[i]);
+		worker.flushProgress();
+		entries[i] = worker._castEntry;
+	}
+}
+
+void S57CastScanner::parseQueue(DsItemQueue &queue)
+{
+	vector<pair<size_t, IR_ModuleEntry *> > entries;
+	unordered_set<string> families;
+	mutex entriesMutex;
+
+	vector<thread> workers;
+	size_t nthreads = workerCount();
+	for (size_t i = 0; i < nthreads; ++i)
+		workers.push_back(thread(&S57CastScanner::queueWorker, this, 
+					ref(queue), ref(entries), ref(families), ref(entriesMutex)));
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+
+	// Registers the modules in the order the data sets were found,
+	// as parseDatasets() does.
+	sort(entries.begin(), entries.end());
+	for (size_t i = 0; i < entries.size(); ++i)
+		if (entries[i].second != NULL)
+			registerModuleEntry(entries[i].second);
+}
+
+void S57CastScanner::queueWorker(DsItemQueue &queue, 
+					vector<pair<size_t, IR_ModuleEntry *> > &entries, 
+					unordered_set<string> &families, 
+					mutex &entriesMutex)
+{
+	S57CastScanner worker;
+	setupWorker(worker);
+
+	DsItem ds;
+	size_t seq;
+	while (queue.pop(&ds, &seq)) {
+		{
+			lock_guard<mutex> lock(entriesMutex);
+			if (!claimFamily(ds, families))
+				continue;
+		}
+
+		worker._castEntry = NULL;
+		worker.doParse(ds);
+		worker.flushProgress();
+
+		lock_guard<mutex> lock(entriesMutex);
+		entries.push_back(make_pair(seq, worker._castEntry));
+	}
+}
+
 S57CastScanner::S57CastScanner()
 	: S57ParseScanner()
 {
@@ -870,7 +976,7 @@ S57CastScanner::~S57CastScanner()
 void S57CastScanner::setProjDatumType(Mercator::DatumType dtype)
 {
 	S57ParseScanner::setProjDatumType(dtype);
-	CastingSpatialItem::setProjDatumType(dtype);
+	_mer.setDatumType(dtype);
 }
 
 void S57CastScanner::setIndexFile(string moduleDir)
@@ -950,45 +1056,40 @@ bool S57CastScanner::removeModuleEntry(string name)
 
 void S57CastScanner::saveIndexFile()
 {
-	IR_DataAreaLeader leader;
 	IR_DirEntry dir;
-	long areaStart, posSave;
 	const char lh[2] = { 'L', 'H' };
 	UInt16 major, minor;
+	string area;
 
 	/* Save Module List */
 
-	RTree *tree = rtreeCreate();
-	if (tree == NULL) {
-		fprintf(stderr, "Fail to create R-tree.\n");
-		exit(1);
-	}
+	vector<RT_Item> treeItems;
+	treeItems.reserve(_irModuleDir.size());
 
 	string ofile = outputPath();
 	ofile.append("index");
 	FILE *fp = as_fopen(ofile.c_str(), "wb");
 
 	//
-	// Writes the file header
+	// Writes the file header and the module entries
 	//
-	major = 1;
-	minor = 1;
-	as_fwrite(lh, 1, 2, fp);
-	as_fwrite(&major, sizeof(UInt16), 1, fp);
-	as_fwrite(&minor, sizeof(UInt16), 1, fp);
+	major = IRV_MAJOR;
+	minor = IRV_MINOR;
 
-	//
-	// Writes the module entries
-	//
-	areaStart = as_ftell(fp);
+	size_t headerSize = sizeof(IR_DataAreaLeader) + sizeof(IR_DirEntry);
+	size_t areaLength = headerSize + sizeof(IR_ModuleEntry) * _irModuleDir.size();
 
-	memset(&leader, 0, sizeof(IR_DataAreaLeader));
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
+	area.reserve(sizeof(lh) + sizeof(UInt16) * 2 + areaLength);
+	appendBytes(area, lh, sizeof(lh));
+	appendBytes(area, &major, sizeof(UInt16));
+	appendBytes(area, &minor, sizeof(UInt16));
+
+	appendLeader(area, 'I', areaLength, headerSize, 1);
 
 	dir.label = 0;
 	dir.pos = 0;
 	dir.size = _irModuleDir.size();
-	as_fwrite(&dir, sizeof(IR_DirEntry), 1, fp);
+	appendBytes(area, &dir, sizeof(IR_DirEntry));
 
 	// resets ids
 	vector<IR_ModuleEntry *>::iterator it = _irModuleDir.begin();
@@ -999,29 +1100,26 @@ void S57CastScanner::saveIndexFile()
 	it = _irModuleDir.begin();
 	for (; it != _irModuleDir.end(); ++it) {
 		const IR_ModuleEntry *e = *it;
-		as_fwrite(e, sizeof(IR_ModuleEntry), 1, fp);
-		rtreeInsert(tree, e->x_min, e->y_min, e->x_max, e->y_max, 
-				reinterpret_cast<void *>(e->id));
+		appendBytes(area, e, sizeof(IR_ModuleEntry));
+		RT_Item item;
+		item.minX = e->x_min;
+		item.minY = e->y_min;
+		item.maxX = e->x_max;
+		item.maxY = e->y_max;
+		item.data = reinterpret_cast<void *>(e->id);
+		treeItems.push_back(item);
 	}
 
-	posSave = as_ftell(fp);
-
-	leader.dataIdentifier = 'I';
-	leader.dataVersion = 1;
-	leader.extension[0] = ' ';
-	leader.extension[1] = ' ';
-	leader.extension[2] = ' ';
-	leader.extension[3] = ' ';
-	leader.areaLength = posSave - areaStart;
-	leader.dataOffset = sizeof(IR_DataAreaLeader) + sizeof(IR_DirEntry);
-	leader.dirSize = 1;
-	as_fseek(fp, areaStart, SEEK_SET);
-	as_fwrite(&leader, sizeof(IR_DataAreaLeader), 1, fp);
-	as_fseek(fp, posSave, SEEK_SET);
+	as_fwrite(area.data(), 1, area.size(), fp);
 
 	//
 	// Writes R-tree area
 	//
+	RTree *tree = rtreeBulkLoad(treeItems.data(), treeItems.size());
+	if (tree == NULL) {
+		fprintf(stderr, "Fail to create R-tree.\n");
+		exit(1);
+	}
 	writeRTreeArea(fp, tree);
 
 	rtreeDestroy(tree);
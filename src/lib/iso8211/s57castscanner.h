@@ -4,6 +4,10 @@
 #include <vector>
 #include <list>
 #include <string>
+#include <atomic>
+#include <mutex>
+#include <unordered_set>
+#include <utility>
 
 #include "ir_struct.h"
 #include "s57_module.h"
@@ -24,6 +28,14 @@ private:
 	// Variables for casting a dataset
 	IR_DatasetParam _irParam;
 	double _comf;
+	Geo::Mercator _mer;
+
+	// Number of threads for casting a data set list, 0 for all cores
+	int _threadCount;
+	// Set on worker scanners: the module entry of the last casted data set
+	// is kept in _castEntry instead of being registered.
+	bool _deferRegister;
+	IR_ModuleEntry *_castEntry;
 
 private:
 	static bool loadModuleList(std::string indexFile, 
@@ -34,6 +46,23 @@ private:
 	void init();
 
 	void registerCurModule();
+	void registerModuleEntry(IR_ModuleEntry *);
+
+	size_t workerCount() const;
+	// Copies the settings of the scanner to a worker scanner
+	void setupWorker(S57CastScanner &worker) const;
+	// Adds the family of the data set to the set, returns false if it's
+	// there already, a data set of the family being casted.
+	static bool claimFamily(const DsItem &ds, std::unordered_set<std::string> &families);
+	void castWorker(std::vector<DsItem> &dsList, 
+					std::vector<IR_ModuleEntry *> &entries, 
+					std::atomic<size_t> &next);
+	// Casts the data sets taken from the queue, the module entries are
+	// paired with the sequence numbers of the data sets.
+	void queueWorker(DsItemQueue &queue, 
+					std::vector<std::pair<size_t, IR_ModuleEntry *> > &entries, 
+					std::unordered_set<std::string> &families, 
+					std::mutex &entriesMutex);
 
 	void saveIrFile(FILE *fp);
 	void writeRTreeArea(FILE *fp, struct RTree *tree);
@@ -45,6 +74,8 @@ protected:
 	virtual void onRecDsAccuracy(S57DSAccuracyRecord *);
 	virtual void onPrepareParse(const DsItem &);
 	virtual void onParse(const DsItem &);
+	virtual void parseDatasets(std::vector<DsItem> &);
+	virtual void parseQueue(DsItemQueue &);
 
 public:
 	// Constructs a empty object.
@@ -62,6 +93,15 @@ public:
 	std::string outputPath() const;
 	void setOutputPath(std::string);
 
+	int threadCount() const;
+	// Sets the number of threads used by scan(). Each data set is casted
+	// on a worker, the module entries are registered in the scanning order,
+	// so the output is the same as a single-threaded run.
+	// 0 uses one thread per hardware core, 1 (by default) disables workers.
+	// In pipeline mode the data sets are casted on workers anyway, and the
+	// entries registered in the order the data sets were found as well.
+	void setThreadCount(int);
+
 	const IR_ModuleEntry *castDataset(std::string filepath);
 
 	std::vector<IR_ModuleEntry> getModuleList() const;
@@ -77,6 +117,12 @@ public:
 inline std::string S57CastScanner::outputPath() const
 { return _outputPath; }
 
+inline int S57CastScanner::threadCount() const
+{ return _threadCount; }
+
+inline void S57CastScanner::setThreadCount(int n)
+{ _threadCount = n < 0 ? 1 : n; }
+
 // ~
 
 #endif
@@ -5,260 +5,328 @@
 #include <errno.h>
 #include <assert.h>
 
-#include "assure_fio.h"
+#include <thread>
+#include <unordered_set>
+
 #include "s57_utils.h"
+#include "s57_flatgeobuf.h"
 #include "s57extract.h"
 
 using namespace std;
 
+// Returns the family of the data set file, its name without extension,
+// as DsItem::family() gives
+static string familyOf(const string &path)
+{
+	string::size_type begin = path.rfind('/');
+	begin = begin == string::npos ? 0 : begin + 1;
+	return path.substr(begin, path.find('.', begin) - begin);
+}
+
 // S57Extract members
 
 void S57Extract::onRecDsGeo(S57DSGeoRecord *r)
 {
 	const S57_DSPM *dspm = r->fieldDSPM();
-	if (dspm != NULL)
+	if (dspm != NULL) {
 		_comf = dspm->_comf;
+		_somf = dspm->_somf;
+	}
 }
 
-void S57Extract::onPrepareParse(const DsItem &)
+void S57Extract::onRecFeature(S57FeatureRecord *r)
 {
+	// Streaming: the feature is written right away, as all the vector
+	// records it points to precede it in the data set.
+	if (streamingEnabled())
+		writeFeature(r);
+	else
+		keepFeature(r);
+}
+
+void S57Extract::onRecSpatial(S57VectorRecord *r)
+{
+	// The vector records are always kept for the FSPT lookups.
+	keepSpatial(r);
+}
+
+void S57Extract::onPrepareParse(const DsItem &ds)
+{
+	closeOutput();
 	_comf = 0.0;
+	_somf = 0.0;
+	_outputName = outputPath();
+	_outputName.append(ds.family());
 }
 
-void S57Extract::onParse(const DsItem &ds)
+void S57Extract::onParse(const DsItem &)
 {
-	char sbuf[8];
-	sprintf_s(sbuf, "%d", _targetObjl);
-
-	string fn = outputPath();
-	fn.append(ds.family());
-	fn.push_back('_');
-	fn.append(sbuf);
-	FILE *miffp = as_fopen((fn + ".MIF").c_str(), "wb");
-	FILE *midfp = as_fopen((fn + ".MID").c_str(), "wb");
-
-	writeMifHeader(miffp);
-
-	const vector<S57FeatureRecordRef> *frList;
-	if (_targetObjl < 300)
-		frList = &grList();
-	else if (_targetObjl < 400)
-		frList = &mrList();
-	else
-		frList = &lrList();
+	// every class gets its files, even if none of its features is found
+	for (size_t i = 0; i < _outputs.size(); ++i)
+		openOutput(i);
+
+	// one pass over each list holding a target class
+	bool inGr = false, inMr = false, inLr = false;
+	for (size_t i = 0; i < _targetObjls.size(); ++i) {
+		if (_targetObjls[i] < 300)
+			inGr = true;
+		else if (_targetObjls[i] < 400)
+			inMr = true;
+		else
+			inLr = true;
+	}
 
-	vector<S57FeatureRecordRef>::const_iterator fit = frList->begin();
-	for (; fit != frList->end(); ++fit) {
-		const S57FeatureRecord *theFr = fit->getPtr();
-		if (theFr->isDeleted())
+	const vector<S57FeatureRecordRef> *lists[] = {
+		inGr ? &grList() : NULL, inMr ? &mrList() : NULL, inLr ? &lrList() : NULL };
+	for (int i = 0; i < 3; ++i) {
+		if (lists[i] == NULL)
 			continue;
+		vector<S57FeatureRecordRef>::const_iterator fit = lists[i]->begin();
+		for (; fit != lists[i]->end(); ++fit)
+			writeFeature(fit->getPtr());
+	}
 
-		const S57_FRID *frid = theFr->fieldFRID();
-		if (frid->_objl != _targetObjl)
-			continue;
+	closeOutput();
+}
 
-		if (frid->_objl == 129)
-			writeSounding(theFr, miffp, midfp);
-		else if (frid->_prim == PRIM_P)
-			writePointObject(theFr, miffp, midfp);
-		else if (frid->_prim == PRIM_L)
-			writeLineObject(theFr, miffp, midfp);
-		else if (frid->_prim == PRIM_A)
-			writeAreaObject(theFr, miffp, midfp);
-	}
+void S57Extract::setTargetClasses(const vector<int> &objls)
+{
+	closeOutput();
+	_targetObjls.clear();
+	_outputs.clear();
+	_outputIndex.clear();
 
-	fclose(miffp);
-	fclose(midfp);
+	for (size_t i = 0; i < objls.size(); ++i) {
+		if (_outputIndex.find(objls[i]) != _outputIndex.end())
+			continue;
+		ClassOutput out;
+		out.objl = objls[i];
+		out.backend = _backend->clone();
+		_outputIndex[objls[i]] = _outputs.size();
+		_outputs.push_back(out);
+		_targetObjls.push_back(objls[i]);
+	}
 }
 
-void S57Extract::writeMifHeader(FILE *fp)
+S57Extract::ClassOutput &S57Extract::openOutput(size_t i)
 {
-	fprintf(fp, "VERSION 300\r\n");
-	fprintf(fp, "CHARSET \"WindowsLatin1\"\r\n");
-	fprintf(fp, "COLUMNS 1\r\n");
-	fprintf(fp, "\tFeatureID integer\r\n");
-	fprintf(fp, "\r\n");
-	fprintf(fp, "DATA\r\n");
+	ClassOutput &out = _outputs[i];
+	if (out.backend->isOpen())
+		return out;
+
+	char sbuf[16];
+	sprintf_s(sbuf, "_%d", out.objl);
+	out.backend->open(_outputName + sbuf, out.objl, _comf, _somf);
+	return out;
 }
 
-void S57Extract::writeSounding(const S57FeatureRecord *fr, FILE *miffp, FILE *midfp)
+void S57Extract::closeOutput()
 {
+	vector<ClassOutput>::iterator it = _outputs.begin();
+	for (; it != _outputs.end(); ++it)
+		it->backend->close();
 }
 
-void S57Extract::writePointObject(const S57FeatureRecord *fr, FILE *miffp, FILE *midfp)
+void S57Extract::writeFeature(const S57FeatureRecord *theFr)
 {
-	vector<S57_FSPT>::const_iterator fsit = fr->fieldsFSPT().begin();
-	for (; fsit != fr->fieldsFSPT().end(); ++fsit) {
-		S57VectorRecordRef toVr = findVectorTarget(fsit->_name);
-		if (toVr.isNull() || toVr->isDeleted()) {
-			fprintf(stderr, "Feature [%s]: invalid FSPT to %s\n", 
-					fr->fieldFRID()->_name.toString().c_str(), 
-					fsit->_name.toString().c_str());
-			continue;
-		}
+	const S57_FRID *frid = theFr->fieldFRID();
+	if (frid == NULL || theFr->isDeleted())
+		return;
 
-		assert(toVr->coordType() == S57VectorRecord::SG2D);
-		if (toVr->coords().size() != 2) {
-			fprintf(stderr, "Vector [%s]: invalid SG2D field\n", toVr->fieldVRID()->_name.toString().c_str());
-			continue;
-		}
+	unordered_map<int, size_t>::const_iterator it = _outputIndex.find(frid->_objl);
+	if (it == _outputIndex.end())
+		return;
 
-		fprintf(miffp, "POINT %.7lf %.7lf\r\n", toVr->coords()[1] / _comf, toVr->coords()[0] / _comf);
-		fprintf(midfp, "%lu\r\n", fr->fieldFRID()->_name._rcid);
+	// no coordinate can be computed without the COMF of the DSPM
+	if (_comf == 0.0)
+		return;
+
+	// the geometry is resolved once, in the units of the data set
+	_feature.clear();
+	_feature._record = theFr;
+	if (frid->_objl == 129)
+		resolveSounding(theFr);
+	else if (frid->_prim == PRIM_P)
+		resolvePoint(theFr);
+	else if (frid->_prim == PRIM_L)
+		resolveLine(theFr);
+	else if (frid->_prim == PRIM_A)
+		resolveArea(theFr);
+	else
+		return;
+
+	if (_feature._ends.empty())
+		return;
+
+	ClassOutput &out = openOutput(it->second);
+	out.backend->write(_feature);
+}
+
+// Returns the vector record of the FSPT, if valid
+const S57VectorRecordRef *S57Extract::spatialOf(const S57FeatureRecord *fr, const S57_FSPT &fspt)
+{
+	const S57VectorRecordRef &toVr = findVectorTarget(fspt._name);
+	if (toVr.isNull() || toVr->isDeleted()) {
+		fprintf(stderr, "Feature [%s]: invalid FSPT to %s\n", 
+				fr->fieldFRID()->_name.toString().c_str(), 
+				fspt._name.toString().c_str());
+		return NULL;
 	}
+	return &toVr;
 }
 
-void S57Extract::writeLineObject(const S57FeatureRecord *fr, FILE *miffp, FILE *midfp)
+// Appends the begin node, the points and the end node of the edge,
+// reversed if asked.
+bool S57Extract::appendEdge(const S57VectorRecord *toVr, bool reversed)
 {
-	if (fr->fieldsFSPT().size() == 0)
-		return;
+	const vector<S57_VRPT> &vrpts = toVr->fieldsVRPT();
+	if (vrpts.size() != 2) {
+		fprintf(stderr, "Vector [%s]: invalid VRPT field\n", toVr->fieldVRID()->_name.toString().c_str());
+		return false;
+	}
+	assert(vrpts[0]._topi == TOPI_B);
+	assert(vrpts[1]._topi == TOPI_E);
+	const S57VectorRecordRef &beginVr = findVectorTarget(vrpts[0]._name);
+	const S57VectorRecordRef &endVr = findVectorTarget(vrpts[1]._name);
+	if (beginVr.isNull() || endVr.isNull()) {
+		fprintf(stderr, "Vector [%s]: invalid VRPT field\n", toVr->fieldVRID()->_name.toString().c_str());
+		return false;
+	}
 
-	fprintf(miffp, "PLINE");
-	if (fr->fieldsFSPT().size() > 1)
-		fprintf(miffp, " MULTIPLE %zd", fr->fieldsFSPT().size());
-	fprintf(miffp, "\r\n");
+	assert(beginVr->coordType() == S57VectorRecord::SG2D);
+	if (beginVr->coords().empty()) {
+		fprintf(stderr, "Vector [%s]: invalid SG2D field\n", beginVr->fieldVRID()->_name.toString().c_str());
+		return false;
+	}
 
-	vector<S57_FSPT>::const_iterator fsit = fr->fieldsFSPT().begin();
-	for (; fsit != fr->fieldsFSPT().end(); ++fsit) {
-		S57VectorRecordRef toVr = findVectorTarget(fsit->_name);
-		if (toVr.isNull() || toVr->isDeleted()) {
-			fprintf(stderr, "Feature [%s]: invalid FSPT to %s\n", 
-					fr->fieldFRID()->_name.toString().c_str(), 
-					fsit->_name.toString().c_str());
-			continue;
-		}
+	assert(endVr->coordType() == S57VectorRecord::SG2D);
+	if (endVr->coords().empty()) {
+		fprintf(stderr, "Vector [%s]: invalid SG2D field\n", endVr->fieldVRID()->_name.toString().c_str());
+		return false;
+	}
 
-		const vector<S57_VRPT> &vrpts = toVr->fieldsVRPT();
-		if (vrpts.size() != 2) {
-			fprintf(stderr, "Vector [%s]: invalid VRPT field\n", toVr->fieldVRID()->_name.toString().c_str());
-			continue;
+	assert(toVr->coordType() == S57VectorRecord::SG2D);
+
+	vector<s57_b24> &v = _feature._xy;
+	const S57CoordArray &coords = toVr->coords();
+	if (reversed) {
+		v.push_back(endVr->coords().x(0));
+		v.push_back(endVr->coords().y(0));
+		for (size_t i = coords.size(); i > 0; --i) {
+			v.push_back(coords.x(i - 1));
+			v.push_back(coords.y(i - 1));
 		}
-		assert(vrpts[0]._topi == TOPI_B);
-		assert(vrpts[1]._topi == TOPI_E);
-		S57VectorRecordRef beginVr = findVectorTarget(vrpts[0]._name);
-		S57VectorRecordRef endVr = findVectorTarget(vrpts[1]._name);
-		if (beginVr.isNull() || endVr.isNull()) {
-			fprintf(stderr, "Vector [%s]: invalid VRPT field\n", toVr->fieldVRID()->_name.toString().c_str());
-			continue;
+		v.push_back(beginVr->coords().x(0));
+		v.push_back(beginVr->coords().y(0));
+	}
+	else {
+		v.push_back(beginVr->coords().x(0));
+		v.push_back(beginVr->coords().y(0));
+		for (size_t i = 0; i < coords.size(); ++i) {
+			v.push_back(coords.x(i));
+			v.push_back(coords.y(i));
 		}
+		v.push_back(endVr->coords().x(0));
+		v.push_back(endVr->coords().y(0));
+	}
+	return true;
+}
 
-		assert(beginVr->coordType() == S57VectorRecord::SG2D);
-		if (beginVr->coords().empty() || beginVr->coords().size() % 2 != 0) {
-			fprintf(stderr, "Vector [%s]: invalid SG2D field\n", beginVr->fieldVRID()->_name.toString().c_str());
+void S57Extract::resolveSounding(const S57FeatureRecord *fr)
+{
+	_feature._type = S57ExportFeature::SOUNDING;
+
+	vector<S57_FSPT>::const_iterator fsit = fr->fieldsFSPT().begin();
+	for (; fsit != fr->fieldsFSPT().end(); ++fsit) {
+		const S57VectorRecordRef *toVr = spatialOf(fr, *fsit);
+		if (toVr == NULL)
 			continue;
-		}
 
-		assert(endVr->coordType() == S57VectorRecord::SG2D);
-		if (endVr->coords().empty() || endVr->coords().size() % 2 != 0) {
-			fprintf(stderr, "Vector [%s]: invalid SG2D field\n", endVr->fieldVRID()->_name.toString().c_str());
+		if ((*toVr)->coordType() != S57VectorRecord::SG3D) {
+			fprintf(stderr, "Vector [%s]: invalid SG3D field\n", (*toVr)->fieldVRID()->_name.toString().c_str());
 			continue;
 		}
 
-		assert(toVr->coordType() == S57VectorRecord::SG2D);
-
-		fprintf(miffp, "%zd\r\n", toVr->coords().size() / 2 + 2);
-		fprintf(miffp, "%.7lf %.7lf\r\n", beginVr->coords()[1] / _comf, beginVr->coords()[0] / _comf);
-		vector<s57_b24>::const_iterator it = toVr->coords().begin();
-		for (; it != toVr->coords().end(); it += 2)
-			fprintf(miffp, "%.7lf %.7lf\r\n", *(it + 1) / _comf, *it / _comf);
-		fprintf(miffp, "%.7lf %.7lf\r\n", endVr->coords()[1] / _comf, endVr->coords()[0] / _comf);
+		const S57CoordArray &coords = (*toVr)->coords();
+		for (size_t i = 0; i < coords.size(); ++i) {
+			_feature._xy.push_back(coords.x(i));
+			_feature._xy.push_back(coords.y(i));
+			_feature._zs.push_back(coords.z(i));
+		}
+		_feature._ends.push_back(_feature.pointCount());
 	}
-
-	fprintf(midfp, "%lu\r\n", fr->fieldFRID()->_name._rcid);
 }
 
-void S57Extract::writeAreaObject(const S57FeatureRecord *fr, FILE *miffp, FILE *midfp)
+void S57Extract::resolvePoint(const S57FeatureRecord *fr)
 {
-	string sbuf;
-	vector<s57_b24> v;
-	int nPolygons = 0;
+	_feature._type = S57ExportFeature::POINT;
 
 	vector<S57_FSPT>::const_iterator fsit = fr->fieldsFSPT().begin();
 	for (; fsit != fr->fieldsFSPT().end(); ++fsit) {
-		S57VectorRecordRef toVr = findVectorTarget(fsit->_name);
-		if (toVr.isNull() || toVr->isDeleted()) {
-			fprintf(stderr, "Feature [%s]: invalid FSPT to %s\n", 
-					fr->fieldFRID()->_name.toString().c_str(), 
-					fsit->_name.toString().c_str());
+		const S57VectorRecordRef *toVr = spatialOf(fr, *fsit);
+		if (toVr == NULL)
 			continue;
-		}
 
-		const vector<S57_VRPT> &vrpts = toVr->fieldsVRPT();
-		if (vrpts.size() != 2) {
-			fprintf(stderr, "Vector [%s]: invalid VRPT field\n", toVr->fieldVRID()->_name.toString().c_str());
-			continue;
-		}
-		assert(vrpts[0]._topi == TOPI_B);
-		assert(vrpts[1]._topi == TOPI_E);
-		S57VectorRecordRef beginVr = findVectorTarget(vrpts[0]._name);
-		S57VectorRecordRef endVr = findVectorTarget(vrpts[1]._name);
-		if (beginVr.isNull() || endVr.isNull()) {
-			fprintf(stderr, "Vector [%s]: invalid VRPT field\n", toVr->fieldVRID()->_name.toString().c_str());
+		assert((*toVr)->coordType() == S57VectorRecord::SG2D);
+		if ((*toVr)->coords().size() != 1) {
+			fprintf(stderr, "Vector [%s]: invalid SG2D field\n", (*toVr)->fieldVRID()->_name.toString().c_str());
 			continue;
 		}
 
-		assert(beginVr->coordType() == S57VectorRecord::SG2D);
-		if (beginVr->coords().empty() || beginVr->coords().size() % 2 != 0) {
-			fprintf(stderr, "Vector [%s]: invalid SG2D field\n", beginVr->fieldVRID()->_name.toString().c_str());
-			continue;
-		}
+		_feature._xy.push_back((*toVr)->coords().x(0));
+		_feature._xy.push_back((*toVr)->coords().y(0));
+		_feature._ends.push_back(_feature.pointCount());
+	}
+}
 
-		assert(endVr->coordType() == S57VectorRecord::SG2D);
-		if (endVr->coords().empty() || endVr->coords().size() % 2 != 0) {
-			fprintf(stderr, "Vector [%s]: invalid SG2D field\n", endVr->fieldVRID()->_name.toString().c_str());
-			continue;
-		}
+void S57Extract::resolveLine(const S57FeatureRecord *fr)
+{
+	_feature._type = S57ExportFeature::LINE;
 
-		assert(toVr->coordType() == S57VectorRecord::SG2D);
+	// a part per edge, in the direction of the edge
+	vector<S57_FSPT>::const_iterator fsit = fr->fieldsFSPT().begin();
+	for (; fsit != fr->fieldsFSPT().end(); ++fsit) {
+		const S57VectorRecordRef *toVr = spatialOf(fr, *fsit);
+		if (toVr != NULL && appendEdge(toVr->getPtr(), false))
+			_feature._ends.push_back(_feature.pointCount());
+	}
+}
 
-		if (fsit->_ornt == ORNT_R) {
-			v.push_back(endVr->coords()[1]);
-			v.push_back(endVr->coords()[0]);
-			vector<s57_b24>::const_reverse_iterator rit = toVr->coords().rbegin();
-			while (rit != toVr->coords().rend()) {
-				v.push_back(*rit++);
-				v.push_back(*rit++);
-			}
-			v.push_back(beginVr->coords()[1]);
-			v.push_back(beginVr->coords()[0]);
-		}
-		else {
-			v.push_back(beginVr->coords()[1]);
-			v.push_back(beginVr->coords()[0]);
-			vector<s57_b24>::const_iterator it = toVr->coords().begin();
-			for (; it != toVr->coords().end(); it += 2) {
-				v.push_back(*(it + 1));
-				v.push_back(*it);
-			}
-			v.push_back(endVr->coords()[1]);
-			v.push_back(endVr->coords()[0]);
-		}
+void S57Extract::resolveArea(const S57FeatureRecord *fr)
+{
+	_feature._type = S57ExportFeature::AREA;
 
-		if (v[0] == v[v.size() - 2] && v[1] == v[v.size() - 1]) {
-			char tmp[64];
-			sprintf_s(tmp, "%zd\r\n", v.size() / 2);
-			sbuf.append(tmp);
-			for (int i = 0; i < static_cast<int>(v.size()); i += 2) {
-				sprintf_s(tmp, "%.7lf %.7lf\r\n", v[i] / _comf, v[i + 1] / _comf);
-				sbuf.append(tmp);
-			}
+	// The edges are chained until the ring is closed
+	vector<s57_b24> &v = _feature._xy;
+	size_t ringBegin = 0;
+	vector<S57_FSPT>::const_iterator fsit = fr->fieldsFSPT().begin();
+	for (; fsit != fr->fieldsFSPT().end(); ++fsit) {
+		const S57VectorRecordRef *toVr = spatialOf(fr, *fsit);
+		if (toVr == NULL || !appendEdge(toVr->getPtr(), fsit->_ornt == ORNT_R))
+			continue;
 
-			v.clear();
-			++nPolygons;
+		if (v[ringBegin] == v[v.size() - 2] && v[ringBegin + 1] == v[v.size() - 1]) {
+			_feature._ends.push_back(_feature.pointCount());
+			ringBegin = v.size();
 		}
 	}
 
-	if (nPolygons != 0) {
-		fprintf(miffp, "REGION %d\r\n", nPolygons);
-		fprintf(miffp, "%s", sbuf.c_str());
-		fprintf(midfp, "%lu\r\n", fr->fieldFRID()->_name._rcid);
-	}
+	// an open ring left is dropped
+	v.resize(ringBegin);
 }
 
 void S57Extract::init()
 {
-	_targetObjl = 0;
 	_comf = 0.0;
+	_somf = 0.0;
+	_threadCount = 1;
+	_backend = new S57MifBackend;
+
+	// Without update merging, nothing but the vector records need to
+	// be kept while parsing. Only the FRID of most features is looked
+	// at, and only the vectors of the target features are decoded.
+	setStreaming(true);
+	setLazyDecoding(true);
 }
 
 S57Extract::S57Extract()
@@ -277,6 +345,7 @@ S57Extract::S57Extract(string targetDs, string outputPath)
 
 S57Extract::~S57Extract()
 {
+	closeOutput();
 }
 
 void S57Extract::setOutputPath(string path)
@@ -286,9 +355,75 @@ void S57Extract::setOutputPath(string path)
 
 void S57Extract::extract(int objl)
 {
-	_targetObjl = objl;
+	extract(vector<int>(1, objl));
+}
+
+void S57Extract::extract(const vector<int> &objls)
+{
+	setTargetClasses(objls);
 
+	// update cells are merged on the records kept
+	bool streaming = streamingEnabled();
+	setStreaming(streaming && !updatingEnabled());
 	parseOneDataset(_targetDs);
+	setStreaming(streaming);
+}
+
+void S57Extract::extract(const vector<string> &dsList, const vector<int> &objls)
+{
+	// the files are named by family, the first data set of a family is
+	// extracted, the others would overwrite it
+	vector<string> datasets;
+	unordered_set<string> families;
+	for (size_t i = 0; i < dsList.size(); ++i) {
+		if (families.insert(familyOf(dsList[i])).second)
+			datasets.push_back(dsList[i]);
+		else
+			fprintf(stderr, "%s: family extracted from another data set, skipped\n",
+					dsList[i].c_str());
+	}
+
+	size_t nthreads = _threadCount > 0 ? _threadCount : thread::hardware_concurrency();
+	if (nthreads > datasets.size())
+		nthreads = datasets.size();
+	if (nthreads <= 1) {
+		atomic<size_t> next(0);
+		extractWorker(datasets, objls, next);
+		return;
+	}
+
+	atomic<size_t> next(0);
+	vector<thread> workers;
+	for (size_t i = 0; i < nthreads; ++i)
+		workers.push_back(thread(&S57Extract::extractWorker, this,
+					cref(datasets), cref(objls), ref(next)));
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].join();
+}
+
+void S57Extract::setupWorker(S57Extract &worker) const
+{
+	S57ParseScanner::setupWorker(worker);
+	worker._outputPath = _outputPath;
+	worker._backend = _backend;
+}
+
+void S57Extract::extractWorker(const vector<string> &datasets, const vector<int> &objls,
+					atomic<size_t> &next)
+{
+	// a scanner per worker, as the parsed records belong to the scanner;
+	// its backends buffer the output of the thread
+	S57Extract worker;
+	setupWorker(worker);
+
+	for (;;) {
+		size_t i = next++;
+		if (i >= datasets.size())
+			break;
+		worker.setTargetDataset(datasets[i]);
+		worker.extract(objls);
+		worker.flushProgress();
+	}
 }
 
 // ~
@@ -296,10 +431,11 @@ void S57Extract::extract(int objl)
 static void usage()
 {
 	printf("Extract coordinates from S57 dataset.\n"
-			"usage: s57extr [-hB] SOURCE OBJL [-P] DEST\n"
+			"usage: s57extr [-hB] [-f FORMAT] SOURCE OBJL[,OBJL...] [-P] DEST\n"
 			"options:\n"
 			"  -h\t Show this usage help.\n"
 			"  -B\t Handle base cells only.\n"
+			"  -f\t Output FORMAT: mif (default), geojson or fgb.\n"
 			"  -P\t Create destination dir if it not exist.\n");
 }
 
@@ -311,14 +447,14 @@ int main(int argc, char *argv[])
 {
 	struct stat stbuf;
 	bool createDest = false;
-	int objl = 0;
+	vector<int> objls;
 
 	S57Extract extr;
 	extr.setPrecheck(false);
 	extr.setUpdating(true);
 
 	for (;;) {
-		int c = getopt(argc, argv, "hBP");
+		int c = getopt(argc, argv, "hBPf:");
 		if (c == -1)
 			break;
 
@@ -332,6 +468,18 @@ int main(int argc, char *argv[])
 		case 'P':
 			createDest = true;
 			break;
+		case 'f':
+			if (strcmp(optarg, "mif") == 0)
+				extr.setBackend(new S57MifBackend);
+			else if (strcmp(optarg, "geojson") == 0)
+				extr.setBackend(new S57GeoJsonBackend);
+			else if (strcmp(optarg, "fgb") == 0)
+				extr.setBackend(new S57FlatGeobufBackend);
+			else {
+				usage();
+				return -1;
+			}
+			break;
 		default:
 			usage();
 			return -1;
@@ -341,12 +489,17 @@ int main(int argc, char *argv[])
 	string source, dest;
 	if (optind < argc)
 		source = argv[optind++];
-	if (optind < argc)
-		objl = atoi(argv[optind++]);
+	if (optind < argc) {
+		for (char *p = strtok(argv[optind++], ","); p != NULL; p = strtok(NULL, ",")) {
+			int objl = atoi(p);
+			if (objl != 0)
+				objls.push_back(objl);
+		}
+	}
 	if (optind < argc)
 		dest = argv[optind++];
 
-	if (optind < argc || source.empty() || objl == 0) {
+	if (optind < argc || source.empty() || objls.empty()) {
 		usage();
 		return -1;
 	}
@@ -377,7 +530,7 @@ int main(int argc, char *argv[])
 
 	extr.setTargetDataset(source);
 	extr.setOutputPath(dest);
-	extr.extract(objl);
+	extr.extract(objls);
 	return 0;
 }
 #endif //
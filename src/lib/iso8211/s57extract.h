@@ -2,22 +2,42 @@
 #define S57EXTRACT_H
 
 #include <string>
+#include <vector>
+#include <atomic>
+#include <unordered_map>
 
 #include "s57parsescanner.h"
+#include "s57_exportbackend.h"
 
 #include "iso8211_gloabal.h"
 
 class ISO8211_EXPORT S57Extract : public S57ParseScanner
 {
 private:
-    std::string _targetDs;
-    int         _targetObjl;
-    std::string _outputPath;
-    double      _comf;
+    // Output of an object class
+    struct ClassOutput
+    {
+        int                 objl;
+        S57ExportBackendRef backend;
+    };
+
+    std::string                     _targetDs;
+    std::vector<int>                _targetObjls;
+    std::string                     _outputPath;
+    double                          _comf;
+    double                          _somf;
+    std::string                     _outputName; // Output file name of the data set, without class and extension
+    std::vector<ClassOutput>        _outputs;    // One per target class
+    std::unordered_map<int, size_t> _outputIndex;
+    S57ExportBackendRef             _backend;    // Cloned for each class
+    S57ExportFeature                _feature;    // Feature being written
+    int                             _threadCount;
 
 private:
     // inherits form S57ParseScanner
     void onRecDsGeo(S57DSGeoRecord *);
+    void onRecFeature(S57FeatureRecord *);
+    void onRecSpatial(S57VectorRecord *);
     void onPrepareParse(const DsItem &);
     void onParse(const DsItem &);
 
@@ -26,11 +46,22 @@ private:
     void clear();
     void scan(std::string);
 
-    void writeMifHeader(FILE *);
-    void writeSounding(const S57FeatureRecord *, FILE * mif, FILE * mid);
-    void writePointObject(const S57FeatureRecord *, FILE * mif, FILE * mid);
-    void writeLineObject(const S57FeatureRecord *, FILE * mif, FILE * mid);
-    void writeAreaObject(const S57FeatureRecord *, FILE * mif, FILE * mid);
+    void setTargetClasses(const std::vector<int> & objls);
+    ClassOutput & openOutput(size_t i);
+    void          closeOutput();
+    void          writeFeature(const S57FeatureRecord *);
+
+    // Copies the settings of the extractor to a worker extractor
+    void setupWorker(S57Extract & worker) const;
+    void extractWorker(const std::vector<std::string> & datasets, const std::vector<int> & objls,
+                       std::atomic<size_t> & next);
+
+    const S57VectorRecordRef * spatialOf(const S57FeatureRecord *, const S57_FSPT &);
+    bool                       appendEdge(const S57VectorRecord *, bool reversed);
+    void                       resolveSounding(const S57FeatureRecord *);
+    void                       resolvePoint(const S57FeatureRecord *);
+    void                       resolveLine(const S57FeatureRecord *);
+    void                       resolveArea(const S57FeatureRecord *);
 
     void init();
 
@@ -45,7 +76,25 @@ public:
     void        setOutputPath(std::string path);
     std::string outputPath() const;
 
+    S57ExportBackendRef backend() const;
+    // Sets the output format, MIF/MID (S57MifBackend) by default
+    void setBackend(S57ExportBackendRef);
+
+    int threadCount() const;
+    // Sets the number of threads extracting a data set list,
+    // 0 for all cores, 1 (by default) disables workers.
+    void setThreadCount(int);
+
     void extract(int objl);
+    // Extracts the object classes in a single pass over the data set,
+    // each class to an output of its own. Streaming and lazy decoding are
+    // enabled by default, streaming is left off while merging updates.
+    void extract(const std::vector<int> & objls);
+    // Extracts the object classes from each data set. The data sets are
+    // extracted on threadCount() workers, each writing its own files.
+    // The files are named by family, so of the data sets of the same
+    // family only the first one is extracted.
+    void extract(const std::vector<std::string> & datasets, const std::vector<int> & objls);
 };
 
 // S57Extract inline functions
@@ -65,6 +114,27 @@ inline std::string S57Extract::outputPath() const
     return _outputPath;
 }
 
+inline S57ExportBackendRef S57Extract::backend() const
+{
+    return _backend;
+}
+
+inline void S57Extract::setBackend(S57ExportBackendRef backend)
+{
+    if (!backend.isNull())
+        _backend = backend;
+}
+
+inline int S57Extract::threadCount() const
+{
+    return _threadCount;
+}
+
+inline void S57Extract::setThreadCount(int n)
+{
+    _threadCount = n < 0 ? 1 : n;
+}
+
 // ~
 
 #endif
@@ -63,7 +63,7 @@ void DsLookScanner::dumpContents(string fileName)
 {
 	printf("%s\n", fileName.c_str());
 
-	S57Module mod(fileName);
+	S57Module mod(fileName, true);
 	if (!mod.isOpen())
 		return;
 
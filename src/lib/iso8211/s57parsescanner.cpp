@@ -1,15 +1,63 @@
 #include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
 #include <assert.h>
+#include <sys/stat.h>
+
+#include <thread>
 
 #include "assure_fio.h"
 #include "s57_module.h"
+#include "s57_snapshot.h"
 #include "s57parsescanner.h"
 
 using namespace std;
 using namespace Geo;
 
+// Returns the size of the file, 0 if not found
+static uint64_t fileSize(const string &fileName)
+{
+	struct stat st;
+	if (stat(fileName.c_str(), &st) != 0)
+		return 0;
+	return st.st_size;
+}
+
+// Returns the FNV-1a hash of the path
+static uint64_t hashPath(const string &path)
+{
+	uint64_t h = 14695981039346656037ULL;
+	for (size_t i = 0; i < path.size(); ++i) {
+		h ^= static_cast<unsigned char>(path[i]);
+		h *= 1099511628211ULL;
+	}
+	return h;
+}
+
+// Returns the number of records differing between the lists
+template <typename R>
+static size_t countMismatches(const vector<Ref<R> > &a, const vector<Ref<R> > &b)
+{
+	size_t n = a.size() > b.size() ? a.size() - b.size() : b.size() - a.size();
+	size_t sz = a.size() < b.size() ? a.size() : b.size();
+	for (size_t i = 0; i < sz; ++i) {
+		string sa, sb;
+		S57Encoder ea(&sa), eb(&sb);
+		a[i]->encodeFields(ea, NULL);
+		b[i]->encodeFields(eb, NULL);
+		if (sa != sb)
+			++n;
+	}
+	return n;
+}
+
 // DsItem members
 
+DsItem::DsItem()
+{
+	_isAlive = true;
+}
+
 DsItem::DsItem(string pathName)
 {
 	_isAlive = true;
@@ -32,16 +80,32 @@ string DsItem::family() const
 string DsItem::dsFile() const
 { return _path + _family + ".000"; }
 
-bool DsItem::insertUpdateCell(string fileName)
+// Returns the parent of the directory, both ending with '/'
+static string parentDirectory(const string &dir)
+{
+	if (dir.size() < 2)
+		return string();
+	string::size_type pos = dir.rfind('/', dir.size() - 2);
+	return pos == string::npos ? string() : dir.substr(0, pos + 1);
+}
+
+bool DsItem::insertUpdateCell(string fileName, bool sibling)
 {
 	int num;
 
 	// Converts the extension to update number
 	string::size_type pos = fileName.rfind('.');
 	assert(pos != string::npos);
-	string s = fileName.substr(0, pos);
-	if (s != (_path + _family))
+	string::size_type dirEnd = fileName.rfind('/', pos) + 1;
+	string dir = fileName.substr(0, dirEnd);
+	if (fileName.compare(dirEnd, pos - dirEnd, _family) != 0)
 		return false;
+	if (dir != _path) {
+		// in an exchange set, CELL/EDTN/UPDN/CELL.00N
+		string parent = parentDirectory(_path);
+		if (!sibling || parent.empty() || parentDirectory(dir) != parent)
+			return false;
+	}
 	num = strToInt(fileName.substr(pos + 1, 3));
 	assert(num > 0 && num <= 999);
 
@@ -49,11 +113,12 @@ bool DsItem::insertUpdateCell(string fileName)
 	int i = 0;
 	while (i < static_cast<int>(_upNums.size()) && num > _upNums[i])
 		++i;
-	assert(i == static_cast<int>(_upNums.size()) || num < _upNums[i]);
-	_upNums.resize(_upNums.size() + 1);
-	for (int j = _upNums.size() - 1; j > i; --j)
-		_upNums[j] = _upNums[j - 1];
-	_upNums[i] = num;
+	if (i < static_cast<int>(_upNums.size()) && num == _upNums[i]) {
+		assert(sibling);
+		return false;
+	}
+	_upNums.insert(_upNums.begin() + i, num);
+	_upDirs.insert(_upDirs.begin() + i, dir);
 
 	return true;
 }
@@ -61,6 +126,9 @@ bool DsItem::insertUpdateCell(string fileName)
 int DsItem::updateCount() const
 { return _upNums.size(); }
 
+int DsItem::lastUpdateNumber() const
+{ return _upNums.empty() ? 0 : _upNums.back(); }
+
 DsItem::UpdateIte DsItem::updateBegin()
 { return DsItem::UpdateIte(this, _upNums.begin()); }
 
@@ -80,7 +148,7 @@ string DsItem::UpdateIte::operator*() const
 {
 	char ext[8];
 	sprintf_s(ext, ".%03d", *_it);
-	return _parent->_path + _parent->_family + ext;
+	return _parent->_upDirs[_it - _parent->_upNums.begin()] + _parent->_family + ext;
 }
 
 bool DsItem::UpdateIte::operator==(const UpdateIte &i) const
@@ -94,6 +162,48 @@ int DsItem::UpdateIte::number() const
 
 //~
 
+// DsItemQueue members
+
+DsItemQueue::DsItemQueue(size_t capacity)
+	: _capacity(capacity > 0 ? capacity : 1), _popped(0), _closed(false)
+{
+}
+
+void DsItemQueue::push(const DsItem &ds)
+{
+	unique_lock<mutex> lock(_mutex);
+	_notFull.wait(lock, [this]() { return _items.size() < _capacity || _closed; });
+	if (_closed)
+		return;
+	_items.push_back(ds);
+	_notEmpty.notify_one();
+}
+
+bool DsItemQueue::pop(DsItem *ds, size_t *seq)
+{
+	unique_lock<mutex> lock(_mutex);
+	_notEmpty.wait(lock, [this]() { return !_items.empty() || _closed; });
+	if (_items.empty())
+		return false;
+	if (seq != NULL)
+		*seq = _popped;
+	++_popped;
+	*ds = _items.front();
+	_items.pop_front();
+	_notFull.notify_one();
+	return true;
+}
+
+void DsItemQueue::close()
+{
+	lock_guard<mutex> lock(_mutex);
+	_closed = true;
+	_notEmpty.notify_all();
+	_notFull.notify_all();
+}
+
+//~
+
 // S57ParseScanner members
 
 void S57ParseScanner::init()
@@ -101,6 +211,14 @@ void S57ParseScanner::init()
 	_updatingEnabled = false;
 	_precheckEnabled = false;
 	_ignoreBaseCell = false;
+	_streamingEnabled = false;
+	_lazyDecodingEnabled = false;
+	_mappedReadingEnabled = true;
+	_snapshotVerify = false;
+	_pipelineDepth = 0;
+	_progressBuffered = false;
+	_dsQueue = NULL;
+	_cell = new S57Cell;
 	_projDatumType = Mercator::WGS84;
 }
 
@@ -114,7 +232,7 @@ bool S57ParseScanner::checkDsValid(string fileName)
 	printf("%s\t", fileName.c_str());
 	fflush(stdout);
 
-	if (!mod.open(fileName))
+	if (!mod.open(fileName, _mappedReadingEnabled))
 		return false;
 
 	while (!mod.atEnd() && nsteps < MAX_CHECK_STEPS) {
@@ -195,38 +313,46 @@ bool S57ParseScanner::checkDsValid(string fileName)
 
 void S57ParseScanner::upcellDispatch()
 {
-	list<string>::iterator it = _upCells.begin();
-	while (it != _upCells.end()) {
-		vector<DsItem>::iterator jt = _dsList.begin();
-		bool found = false;
-		for (; jt != _dsList.end() && !found; ++jt)
-			found = jt->insertUpdateCell(*it);
-
-		if (found)
-			it = _upCells.erase(it);
-		else
-			++it;
+	// The base cell in the directory of the update cell is taken first,
+	// then one in a sibling directory.
+	for (int sibling = 0; sibling < 2; ++sibling) {
+		list<string>::iterator it = _upCells.begin();
+		while (it != _upCells.end()) {
+			vector<DsItem>::iterator jt = _dsList.begin();
+			bool found = false;
+			for (; jt != _dsList.end() && !found; ++jt)
+				found = jt->insertUpdateCell(*it, sibling != 0);
+
+			if (found)
+				it = _upCells.erase(it);
+			else
+				++it;
+		}
 	}
 
 	if (!_upCells.empty()) {
 		fprintf(stderr, "Isolated update cells:\n");
-		it = _upCells.begin();
+		list<string>::iterator it = _upCells.begin();
 		for (; it != _upCells.end(); ++it)
 			fprintf(stderr, "  %s\n", it->c_str());
 	}
 }
 
-void S57ParseScanner::updateDataset(DsItem &ds)
+void S57ParseScanner::updateDataset(DsItem &ds, int after, bool dispatch)
 {
-	printf("Merging update:");
+	progress("Merging update:");
 
 	// for each update cells
 	S57Module upCell;
 	DsItem::UpdateIte it = ds.updateBegin();
 	for (; it != ds.updateEnd(); ++it) {
-		printf(" %d", it.number());
-		if (!upCell.open(*it))
+		if (it.number() <= after)
 			continue;
+		progress(" %d", it.number());
+		if (!upCell.open(*it, _mappedReadingEnabled))
+			continue;
+		upCell.setLazyDecoding(_lazyDecodingEnabled);
+		upCell.setAttrPool(_cell->_attrPool);
 		// for each update records
 		while (!upCell.atEnd()) {
 			S57RecordRef r = upCell.getNextRecord();
@@ -235,16 +361,16 @@ void S57ParseScanner::updateDataset(DsItem &ds)
 				S57DSInfoRecord *inf = reinterpret_cast<S57DSInfoRecord *>(r.getPtr());
 				const S57_DSID *up_dsid = inf->fieldDSID();
 				if (up_dsid == NULL) {
-					putchar('?');
+					progress("?");
 					break; // go next update cell
 				}
 				if (up_dsid->_edtn == 0) {
-					putchar('X');
+					progress("X");
 					ds._isAlive = false;
 					return;
 				}
-				if (up_dsid->_edtn != _dsinfRec->fieldDSID()->_edtn) {
-					putchar('!');
+				if (up_dsid->_edtn != _cell->_dsinfRec->fieldDSID()->_edtn) {
+					progress("!");
 					break; // go next update cell
 				}
 			}
@@ -255,14 +381,16 @@ void S57ParseScanner::updateDataset(DsItem &ds)
 					continue; // go next update record
 				// Insert
 				if (up_frid->_ruin == S57_UI_I) {
-					if (findFeatureTarget(up_frid->_name, up_frid->_objl).isNull())
+					if (!findFeatureTarget(up_frid->_name, up_frid->_objl).isNull())
+						fprintf(stderr, "target [%s] already exist\n", up_frid->_name.toString().c_str());
+					else if (dispatch)
 						onRecFeature(fr);
 					else
-						fprintf(stderr, "target [%s] already exist\n", up_frid->_name.toString().c_str());
+						keepFeature(fr);
 				}
 				// Delete
 				else if (up_frid->_ruin == S57_UI_D) {
-					S57FeatureRecordRef target = findFeatureTarget(up_frid->_name, up_frid->_objl);
+					const S57FeatureRecordRef &target = findFeatureTarget(up_frid->_name, up_frid->_objl);
 					if (!target.isNull())
 						target->markDeleted();
 					else
@@ -270,7 +398,7 @@ void S57ParseScanner::updateDataset(DsItem &ds)
 				}
 				// Modify
 				else if (up_frid->_ruin == S57_UI_M) {
-					S57FeatureRecordRef target = findFeatureTarget(up_frid->_name, up_frid->_objl);
+					const S57FeatureRecordRef &target = findFeatureTarget(up_frid->_name, up_frid->_objl);
 					if (!target.isNull())
 						target->update(fr);
 					else
@@ -284,14 +412,16 @@ void S57ParseScanner::updateDataset(DsItem &ds)
 					continue; // go next update record
 				// Insert
 				if (up_vrid->_ruin == S57_UI_I) {
-					if (findVectorTarget(up_vrid->_name).isNull())
+					if (!findVectorTarget(up_vrid->_name).isNull())
+						fprintf(stderr, "target [%s] already exist\n", up_vrid->_name.toString().c_str());
+					else if (dispatch)
 						onRecSpatial(vr);
 					else
-						fprintf(stderr, "target [%s] already exist\n", up_vrid->_name.toString().c_str());
+						keepSpatial(vr);
 				}
 				// Delete
 				else if (up_vrid->_ruin == S57_UI_D) {
-					S57VectorRecordRef target = findVectorTarget(up_vrid->_name);
+					const S57VectorRecordRef &target = findVectorTarget(up_vrid->_name);
 					if (!target.isNull())
 						target->markDeleted();
 					else
@@ -299,7 +429,7 @@ void S57ParseScanner::updateDataset(DsItem &ds)
 				}
 				// Modify
 				else if (up_vrid->_ruin == S57_UI_M) {
-					S57VectorRecordRef target = findVectorTarget(up_vrid->_name);
+					const S57VectorRecordRef &target = findVectorTarget(up_vrid->_name);
 					if (!target.isNull())
 						target->update(vr);
 					else
@@ -307,45 +437,231 @@ void S57ParseScanner::updateDataset(DsItem &ds)
 				}
 			}
 		}
-		fflush(stdout);
+		if (!_progressBuffered)
+			fflush(stdout);
 	}
 
 	if (ds.updateCount() > 0)
-		putchar('\n');
+		progress("\n");
+}
+
+void S57ParseScanner::clearRecords()
+{
+	// a cached cell stays as it is
+	_cell = new S57Cell;
+}
+
+string S57ParseScanner::cellKey(DsItem &ds, int lastUpdate) const
+{
+	string key;
+	char buf[64];
+
+	struct stat st;
+	if (stat(ds.dsFile().c_str(), &st) != 0)
+		return key;
+	key = ds.dsFile();
+	snprintf(buf, sizeof(buf), "|%lld|%lld", static_cast<long long>(st.st_size), 
+			static_cast<long long>(st.st_mtime));
+	key.append(buf);
+
+	DsItem::UpdateIte it = ds.updateBegin();
+	for (; it != ds.updateEnd(); ++it) {
+		if (it.number() > lastUpdate)
+			continue;
+		if (stat((*it).c_str(), &st) != 0)
+			st.st_size = st.st_mtime = 0;
+		snprintf(buf, sizeof(buf), "|%d:%lld:%lld", it.number(), static_cast<long long>(st.st_size), 
+				static_cast<long long>(st.st_mtime));
+		key.append(buf);
+	}
+	return key;
+}
+
+string S57ParseScanner::snapshotFile(const DsItem &ds) const
+{
+	string s = _snapshotPath;
+	if (!s.empty() && s[s.length() - 1] != '/')
+		s.push_back('/');
+	// named by the path too, as cells of a family may be found in
+	// several directories
+	char buf[32];
+	snprintf(buf, sizeof(buf), "_%016llx.snp", static_cast<unsigned long long>(hashPath(ds.dsFile())));
+	return s + ds.family() + buf;
+}
+
+int S57ParseScanner::loadSnapshot(DsItem &ds, S57Module &mod)
+{
+	string fileName = snapshotFile(ds);
+	if (fileSize(fileName) == 0)
+		return -1;
+
+	S57Snapshot snap;
+	if (!snap.load(fileName))
+		return -1;
+
+	S57DSInfoRecordRef inf = mod.generalInfoRecord();
+	if (inf.isNull() || inf->fieldDSID() == NULL || mod.geographicRecord().isNull())
+		return -1;
+	if (snap.edition() != inf->fieldDSID()->_edtn
+			|| snap.updateNumber() > ds.lastUpdateNumber()
+			|| snap.source() != cellKey(ds, snap.updateNumber())) {
+		progress("Snapshot %s out of date\n", fileName.c_str());
+		return -1;
+	}
+
+	// Decodes all the records first, a broken snapshot is then dropped
+	// before any of them is dispatched.
+	vector<S57RecordRef> recs;
+	recs.reserve(snap.recordCount());
+	for (;;) {
+		S57RecordRef r = snap.nextRecord(&mod);
+		if (r.isNull())
+			break;
+		recs.push_back(r);
+	}
+	if (recs.size() != snap.recordCount()) {
+		fprintf(stderr, "%s: broken snapshot, ignored\n", fileName.c_str());
+		return -1;
+	}
+
+	_cell->_dsinfRec = inf;
+	onRecDsInfo(_cell->_dsinfRec.getPtr());
+	_cell->_dsgeoRec = mod.geographicRecord();
+	onRecDsGeo(_cell->_dsgeoRec.getPtr());
+	if (!mod.accuracyRecord().isNull()) {
+		_cell->_dsaccRec = mod.accuracyRecord();
+		onRecDsAccuracy(_cell->_dsaccRec.getPtr());
+	}
+
+	vector<S57RecordRef>::iterator it = recs.begin();
+	for (; it != recs.end(); ++it) {
+		if ((*it)->recordType() == S57Record::Feature)
+			onRecFeature(reinterpret_cast<S57FeatureRecord *>(it->getPtr()));
+		else
+			onRecSpatial(reinterpret_cast<S57VectorRecord *>(it->getPtr()));
+	}
+
+	progress("Snapshot loaded, merged to update %d\n", snap.updateNumber());
+	return snap.updateNumber();
+}
+
+void S57ParseScanner::saveSnapshot(DsItem &ds, int updateNumber)
+{
+	S57Snapshot snap(_cell->_dsinfRec->fieldDSID()->_edtn, updateNumber, cellKey(ds, updateNumber));
+
+	vector<S57VectorRecordRef>::iterator vt = _cell->_vrList.begin();
+	for (; vt != _cell->_vrList.end(); ++vt)
+		snap.addRecord(vt->getPtr());
+
+	vector<S57FeatureRecordRef> *lists[] = { &_cell->_grList, &_cell->_mrList, &_cell->_lrList };
+	for (int i = 0; i < 3; ++i) {
+		vector<S57FeatureRecordRef>::iterator ft = lists[i]->begin();
+		for (; ft != lists[i]->end(); ++ft)
+			snap.addRecord(ft->getPtr());
+	}
+
+	snap.save(snapshotFile(ds));
+}
+
+bool S57ParseScanner::verifySnapshot(DsItem &ds)
+{
+	vector<S57FeatureRecordRef> grList, mrList, lrList;
+	vector<S57VectorRecordRef> vrList;
+	grList.swap(_cell->_grList);
+	mrList.swap(_cell->_mrList);
+	lrList.swap(_cell->_lrList);
+	vrList.swap(_cell->_vrList);
+	_cell->_grIndex.clear();
+	_cell->_mrIndex.clear();
+	_cell->_lrIndex.clear();
+	_cell->_vrIndex.clear();
+
+	S57Module mod(ds.dsFile(), _mappedReadingEnabled);
+	if (!mod.isOpen())
+		return false;
+	mod.setLazyDecoding(_lazyDecodingEnabled);
+	mod.setAttrPool(_cell->_attrPool);
+
+	while (!mod.atEnd()) {
+		S57RecordRef r = mod.getNextRecord();
+		assert(!r.isNull());
+		if (r->recordType() == S57Record::Feature)
+			keepFeature(reinterpret_cast<S57FeatureRecord *>(r.getPtr()));
+		else if (r->recordType() == S57Record::Vector)
+			keepSpatial(reinterpret_cast<S57VectorRecord *>(r.getPtr()));
+	}
+	updateDataset(ds, 0, false);
+
+	size_t n = countMismatches(vrList, _cell->_vrList) + countMismatches(grList, _cell->_grList)
+		+ countMismatches(mrList, _cell->_mrList) + countMismatches(lrList, _cell->_lrList);
+	if (n > 0) {
+		fprintf(stderr, "%s: snapshot differs from full replay in %zu records\n",
+				ds.dsFile().c_str(), n);
+		return false;
+	}
+
+	progress("Snapshot verified\n");
+	return true;
 }
 
 void S57ParseScanner::doParse(DsItem &ds)
 {
 	onPrepareParse(ds);
 
-	_dsinfRec.release();
-	_dsgeoRec.release();
-	_dsaccRec.release();
-	_grList.clear();
-	_mrList.clear();
-	_lrList.clear();
-	_vrList.clear();
-
-	printf("Parsing %s\n", ds.dsFile().c_str());
+	clearRecords();
+
+	progress("Parsing %s\n", ds.dsFile().c_str());
+
+	string key;
+	if (!_cellCache.isNull() && !_streamingEnabled) {
+		key = cellKey(ds, _updatingEnabled ? ds.lastUpdateNumber() : 0);
+		S57CellRef cell = key.empty() ? S57CellRef() : _cellCache->find(key);
+		if (!cell.isNull()) {
+			_cell = cell;
+			onRecDsInfo(_cell->_dsinfRec.getPtr());
+			onRecDsGeo(_cell->_dsgeoRec.getPtr());
+			if (!_cell->_dsaccRec.isNull())
+				onRecDsAccuracy(_cell->_dsaccRec.getPtr());
+			onParse(ds);
+			return;
+		}
+	}
 
-	S57Module mod(ds.dsFile());
+	S57Module mod(ds.dsFile(), _mappedReadingEnabled);
 	if (!mod.isOpen())
 		return;
+	mod.setLazyDecoding(_lazyDecodingEnabled);
+	_cell->_attrPool = mod.attrPool();
 
-	while (!mod.atEnd()) {
+	// Number of the last update cell merged, -1 if the base cell not parsed
+	int merged = -1;
+	bool useSnapshot = !_snapshotPath.empty() && !_streamingEnabled && ds.updateCount() > 0;
+	if (useSnapshot)
+		merged = loadSnapshot(ds, mod);
+
+	while (merged < 0 && !mod.atEnd()) {
 		Ref<S57Record> r = mod.getNextRecord();
 		assert(!r.isNull());
+
+		// streaming hands each record out as it comes, so the data set
+		// records must come before the first feature or vector record
+		if (_streamingEnabled && (_cell->_dsinfRec.isNull() || _cell->_dsgeoRec.isNull())
+				&& (r->recordType() == S57Record::Feature || r->recordType() == S57Record::Vector)) {
+			progress("invalid dataset\n");
+			return;
+		}
+
 		switch (r->recordType()) {
 		case S57Record::DatasetInformation:
-			_dsinfRec = reinterpret_cast<S57DSInfoRecord *>(r.getPtr());
+			_cell->_dsinfRec = reinterpret_cast<S57DSInfoRecord *>(r.getPtr());
 			onRecDsInfo(reinterpret_cast<S57DSInfoRecord *>(r.getPtr()));
 			break;
 		case S57Record::DatasetGeographic:
-			_dsgeoRec = reinterpret_cast<S57DSGeoRecord *>(r.getPtr());
+			_cell->_dsgeoRec = reinterpret_cast<S57DSGeoRecord *>(r.getPtr());
 			onRecDsGeo(reinterpret_cast<S57DSGeoRecord *>(r.getPtr()));
 			break;
 		case S57Record::DatasetAccuracy:
-			_dsaccRec = reinterpret_cast<S57DSAccuracyRecord *>(r.getPtr());
+			_cell->_dsaccRec = reinterpret_cast<S57DSAccuracyRecord *>(r.getPtr());
 			onRecDsAccuracy(reinterpret_cast<S57DSAccuracyRecord *>(r.getPtr()));
 			break;
 		case S57Record::Feature:
@@ -359,13 +675,30 @@ void S57ParseScanner::doParse(DsItem &ds)
 		}
 	}
 
-	if (_dsinfRec.isNull() || _dsgeoRec.isNull()) {
-		printf("invalid dataset\n");
+	if (_cell->_dsinfRec.isNull() || _cell->_dsgeoRec.isNull()) {
+		progress("invalid dataset\n");
 		return;
 	}
 
-	if (ds.updateCount() > 0)
-		updateDataset(ds);
+	if (ds.updateCount() > 0) {
+		if (_streamingEnabled)
+			fprintf(stderr, "%s: %d update cells not merged in streaming mode\n",
+					ds.dsFile().c_str(), ds.updateCount());
+		else {
+			bool loaded = merged >= 0;
+			if (merged < ds.lastUpdateNumber())
+				updateDataset(ds, merged);
+
+			bool verified = true;
+			if (loaded && _snapshotVerify)
+				verified = verifySnapshot(ds);
+			if (useSnapshot && ds._isAlive && (merged < ds.lastUpdateNumber() || !verified))
+				saveSnapshot(ds, ds.lastUpdateNumber());
+		}
+	}
+
+	if (!key.empty() && ds._isAlive)
+		_cellCache->insert(key, _cell);
 
 	onParse(ds);
 }
@@ -412,6 +745,15 @@ void S57ParseScanner::onDataset(string filepath)
 	string::size_type pos = filepath.rfind('.');
 	assert(pos != string::npos);
 
+	if (_dsQueue != NULL) {
+		string dirName = filepath.substr(0, filepath.rfind('/') + 1);
+		if (filepath.substr(pos + 1, 3) == "000")
+			_dirDsList[dirName].push_back(DsItem(filepath.substr(0, pos)));
+		else if (_updatingEnabled)
+			_upCells.push_back(filepath);
+		return;
+	}
+
 	if (filepath.substr(pos + 1, 3) == "000") { // is base cell
 		if (!_ignoreBaseCell) {
 			if (!_precheckEnabled || checkDsValid(filepath))
@@ -425,34 +767,79 @@ void S57ParseScanner::onDataset(string filepath)
 	}
 }
 
-S57FeatureRecordRef S57ParseScanner::findFeatureTarget(const S57_NAME &nm, s57_b12 objl)
+void S57ParseScanner::onDirectoryScanned(string dirName)
+{
+	if (_dsQueue == NULL)
+		return;
+
+	vector<DsItem> dsList;
+	unordered_map<string, vector<DsItem> >::iterator it = _dirDsList.find(dirName);
+	if (it == _dirDsList.end())
+		return;
+	dsList.swap(it->second);
+	_dirDsList.erase(it);
+
+	// The update cells of a data set may be in any directory, in an
+	// exchange set each one is in a directory of its own, so with
+	// updating the data sets wait for the end of the walk.
+	if (_updatingEnabled) {
+		_dsList.insert(_dsList.end(), dsList.begin(), dsList.end());
+		return;
+	}
+
+	for (size_t i = 0; i < dsList.size(); ++i)
+		_dsQueue->push(dsList[i]);
+}
+
+const S57FeatureRecordRef &S57ParseScanner::findFeatureTarget(const S57_NAME &nm, s57_b12 objl) const
 {
-	vector<S57FeatureRecordRef> *l = NULL;
-	if (objl < 300)
-		l = &_grList;
-	else if (objl < 400)
-		l = &_mrList;
-	else if (objl < 500)
-		l = &_lrList;
+	static const S57FeatureRecordRef nullRef;
+
+	const vector<S57FeatureRecordRef> *l = NULL;
+	const S57Cell::NameIndex *idx = NULL;
+	if (objl < 300) {
+		l = &_cell->_grList;
+		idx = &_cell->_grIndex;
+	}
+	else if (objl < 400) {
+		l = &_cell->_mrList;
+		idx = &_cell->_mrIndex;
+	}
+	else if (objl < 500) {
+		l = &_cell->_lrList;
+		idx = &_cell->_lrIndex;
+	}
 	else
-		return NULL;
+		return nullRef;
+
+	S57Cell::NameIndex::const_iterator it = idx->find(nm.key());
+	if (it == idx->end())
+		return nullRef;
+	return (*l)[it->second];
+}
+
+const S57VectorRecordRef &S57ParseScanner::findVectorTarget(const S57_NAME &nm) const
+{
+	static const S57VectorRecordRef nullRef;
+
+	S57Cell::NameIndex::const_iterator it = _cell->_vrIndex.find(nm.key());
+	if (it == _cell->_vrIndex.end())
+		return nullRef;
+	return _cell->_vrList[it->second];
+}
 
-	S57FeatureRecordRef res;
-	vector<S57FeatureRecordRef>::iterator it = l->begin();
-	for (; it != l->end() && res.isNull(); ++it)
-		if ((*it)->fieldFRID()->_name == nm)
-			res = *it;
-	return res;
+void S57ParseScanner::parseDatasets(vector<DsItem> &dsList)
+{
+	vector<DsItem>::iterator it = dsList.begin();
+	for (; it != dsList.end(); ++it)
+		doParse(*it);
 }
 
-S57VectorRecordRef S57ParseScanner::findVectorTarget(const S57_NAME &nm)
+void S57ParseScanner::parseQueue(DsItemQueue &queue)
 {
-	S57VectorRecordRef res;
-	vector<S57VectorRecordRef>::iterator it = _vrList.begin();
-	for (; it != _vrList.end() && res.isNull(); ++it)
-		if ((*it)->fieldVRID()->_name == nm)
-			res = *it;
-	return res;
+	DsItem ds;
+	while (queue.pop(&ds))
+		doParse(ds);
 }
 
 void S57ParseScanner::onRecDsInfo(S57DSInfoRecord *)
@@ -470,32 +857,52 @@ void S57ParseScanner::onRecDsAccuracy(S57DSAccuracyRecord *)
 	// do nothing
 }
 
-void S57ParseScanner::onRecFeature(S57FeatureRecord *r)
+void S57ParseScanner::keepFeature(S57FeatureRecord *r)
 {
 	if (r == NULL || r->fieldFRID() == NULL) {
 		fprintf(stderr, "Bad feature record.\n");
 		return;
 	}
 
+	unsigned long long key = r->fieldFRID()->_name.key();
 	int objl = r->fieldFRID()->_objl;
-	if (objl < 300)
-		_grList.push_back(r);
-	else if (objl < 400)
-		_mrList.push_back(r);
-	else if (objl < 500)
-		_lrList.push_back(r);
+	if (objl < 300) {
+		_cell->_grIndex.emplace(key, _cell->_grList.size());
+		_cell->_grList.push_back(r);
+	}
+	else if (objl < 400) {
+		_cell->_mrIndex.emplace(key, _cell->_mrList.size());
+		_cell->_mrList.push_back(r);
+	}
+	else if (objl < 500) {
+		_cell->_lrIndex.emplace(key, _cell->_lrList.size());
+		_cell->_lrList.push_back(r);
+	}
 	else
 		fprintf(stderr, "Unhandled feature record with OBJL=%d\n", objl);
 }
 
-void S57ParseScanner::onRecSpatial(S57VectorRecord *r)
+void S57ParseScanner::keepSpatial(S57VectorRecord *r)
 {
 	if (r == NULL || r->fieldVRID() == NULL) {
 		fprintf(stderr, "Bad vector record.\n");
 		return;
 	}
 
-	_vrList.push_back(r);
+	_cell->_vrIndex.emplace(r->fieldVRID()->_name.key(), _cell->_vrList.size());
+	_cell->_vrList.push_back(r);
+}
+
+void S57ParseScanner::onRecFeature(S57FeatureRecord *r)
+{
+	if (!_streamingEnabled)
+		keepFeature(r);
+}
+
+void S57ParseScanner::onRecSpatial(S57VectorRecord *r)
+{
+	if (!_streamingEnabled)
+		keepSpatial(r);
 }
 
 void S57ParseScanner::onPrepareParse(const DsItem &)
@@ -508,6 +915,66 @@ void S57ParseScanner::onParse(const DsItem &)
 	// do nothing
 }
 
+void S57ParseScanner::progress(const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	if (!_progressBuffered) {
+		vprintf(fmt, ap);
+		va_end(ap);
+		return;
+	}
+
+	char buf[256];
+	va_list aq;
+	va_copy(aq, ap);
+	int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+	if (n >= static_cast<int>(sizeof(buf))) {
+		size_t pos = _progress.size();
+		_progress.resize(pos + n + 1);
+		vsnprintf(&_progress[pos], n + 1, fmt, aq);
+		_progress.resize(pos + n);
+	}
+	else if (n > 0)
+		_progress.append(buf, n);
+	va_end(aq);
+	va_end(ap);
+}
+
+void S57ParseScanner::flushProgress()
+{
+	static mutex stdoutMutex;
+
+	if (_progress.empty())
+		return;
+	lock_guard<mutex> lock(stdoutMutex);
+	fwrite(_progress.data(), 1, _progress.size(), stdout);
+	fflush(stdout);
+	_progress.clear();
+}
+
+void S57ParseScanner::setupWorker(S57ParseScanner &worker) const
+{
+	worker.setProjDatumType(projDatumType());
+	worker.setUpdating(updatingEnabled());
+	worker.setPrecheck(precheckEnabled());
+	worker.setIgnoreBaseCell(ignoreBaseCell());
+	worker.setStreaming(streamingEnabled());
+	worker.setLazyDecoding(lazyDecodingEnabled());
+	worker.setMappedReading(mappedReadingEnabled());
+	worker.setSnapshotPath(snapshotPath());
+	worker.setSnapshotVerify(snapshotVerifyEnabled());
+	worker.setCellCache(cellCache());
+	worker.setProgressBuffered(true);
+}
+
+void S57ParseScanner::setProgressBuffered(bool on)
+{
+	if (!on)
+		flushProgress();
+	_progressBuffered = on;
+}
+
 S57ParseScanner::S57ParseScanner()
 {
 	init();
@@ -515,6 +982,7 @@ S57ParseScanner::S57ParseScanner()
 
 S57ParseScanner::~S57ParseScanner()
 {
+	flushProgress();
 	clear();
 }
 
@@ -523,17 +991,40 @@ void S57ParseScanner::clear()
 	_dsList.clear();
 	_upCells.clear();
 
-	_dsinfRec.release();
-	_dsgeoRec.release();
-	_dsaccRec.release();
-	_grList.clear();
-	_mrList.clear();
-	_lrList.clear();
-	_vrList.clear();
+	clearRecords();
+}
+
+void S57ParseScanner::scanPipelined(string path)
+{
+	DsItemQueue queue(_pipelineDepth);
+	_dsQueue = &queue;
+
+	// The walker only touches the members of the pipeline mode,
+	// the parsing runs here meanwhile.
+	thread walker([this, &queue, path]() {
+		S57DatasetScanner::scan(path);
+		// the update cells are merged as in a walk without pipeline,
+		// then the data sets held back are queued
+		upcellDispatch();
+		for (size_t i = 0; i < _dsList.size(); ++i)
+			_dsQueue->push(_dsList[i]);
+		queue.close();
+	});
+	parseQueue(queue);
+	queue.close();
+	walker.join();
+
+	_dsQueue = NULL;
+	_dirDsList.clear();
 }
 
 void S57ParseScanner::scan(string path)
 {
+	if (_pipelineDepth > 0 && !_precheckEnabled && !_ignoreBaseCell) {
+		scanPipelined(path);
+		return;
+	}
+
 	S57DatasetScanner::scan(path);
 	upcellDispatch();
 
@@ -551,9 +1042,7 @@ void S57ParseScanner::scan(string path)
 			return;
 	}
 
-	vector<DsItem>::iterator it = _dsList.begin();
-	for (; it != _dsList.end(); ++it)
-		doParse(*it);
+	parseDatasets(_dsList);
 }
 
 // ~
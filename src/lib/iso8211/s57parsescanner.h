@@ -3,12 +3,17 @@
 
 #include <vector>
 #include <list>
+#include <deque>
 #include <string>
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
 
 #include "../geo/utmproject.h"
 
 #include "s57_utils.h"
 #include "s57_record.h"
+#include "s57_cellcache.h"
 #include "iso8211_gloabal.h"
 
 class ISO8211_EXPORT DsItem
@@ -16,12 +21,15 @@ class ISO8211_EXPORT DsItem
 private:
     std::string      _path;
     std::string      _family; // File name of the data set, without extension.
-    std::vector<int> _upNums; // Update numbers, in ASC order.
+    std::vector<int>         _upNums; // Update numbers, in ASC order.
+    std::vector<std::string> _upDirs; // Directory of each update cell
 
 public:
     bool _isAlive;
 
 public:
+    // Constructs an empty DsItem
+    DsItem();
     // Constructs a DsItem using the file path and name,
     // but without externsion.
     DsItem(std::string pathName);
@@ -33,9 +41,15 @@ public:
     // Returns the filename of the data set. (_path/_family.000)
     std::string dsFile() const;
 
-    bool insertUpdateCell(std::string fileName);
+    // Adds the update cell if it's of the family and in the directory
+    // of the data set. If sibling is true, one in a sibling directory
+    // is taken too, as in an exchange set, where each update cell is in
+    // a directory of its own, CELL/EDTN/UPDN/CELL.00N.
+    bool insertUpdateCell(std::string fileName, bool sibling = false);
 
     int updateCount() const;
+    // Returns the number of the last update cell, 0 if none
+    int lastUpdateNumber() const;
 
     class UpdateIte;
     friend class UpdateIte;
@@ -63,49 +77,136 @@ public:
     UpdateIte updateEnd();
 };
 
+/*
+ * Bounded queue of the data sets found by a scanner, waiting to be parsed.
+ * push() blocks while the queue is full, so the directory walk never gets
+ * far ahead of the parsing.
+ */
+class ISO8211_EXPORT DsItemQueue
+{
+private:
+    std::deque<DsItem>      _items;
+    size_t                  _capacity;
+    size_t                  _popped;   // Number of data sets taken
+    bool                    _closed;
+    std::mutex              _mutex;
+    std::condition_variable _notEmpty;
+    std::condition_variable _notFull;
+
+    DsItemQueue(const DsItemQueue &);
+    DsItemQueue & operator=(const DsItemQueue &);
+
+public:
+    DsItemQueue(size_t capacity);
+
+    void push(const DsItem &);
+    // Takes the next data set, waits for one if the queue is empty.
+    // Returns false once the queue is closed and empty. The sequence
+    // number is the position of the data set in the order pushed.
+    bool pop(DsItem *, size_t * seq = NULL);
+    // Ends the queue, no data set is pushed after
+    void close();
+};
+
 class ISO8211_EXPORT S57ParseScanner : public S57DatasetScanner
 {
 private:
     bool                     _updatingEnabled;
     bool                     _precheckEnabled;
     bool                     _ignoreBaseCell;
+    bool                     _streamingEnabled;
+    bool                     _lazyDecodingEnabled;
+    bool                     _mappedReadingEnabled;
+    bool                     _snapshotVerify;
+    std::string              _snapshotPath;
+    int                      _pipelineDepth;
+    bool                     _progressBuffered;
+    std::string              _progress; // Progress output not flushed yet
     std::vector<DsItem>      _dsList;
     Geo::Mercator::DatumType _projDatumType;
 
     // Temp update cell list
     std::list<std::string> _upCells;
 
-    // S-57 records
-    S57DSInfoRecordRef               _dsinfRec;
-    S57DSGeoRecordRef                _dsgeoRec;
-    S57DSAccuracyRecordRef           _dsaccRec;
-    std::vector<S57FeatureRecordRef> _grList; // Geo features
-    std::vector<S57FeatureRecordRef> _mrList; // Meta features
-    std::vector<S57FeatureRecordRef> _lrList; // Collection features
-    std::vector<S57VectorRecordRef>  _vrList; // Vector records
+    // Pipeline mode: the queue being fed, and the base cells found in
+    // each directory, waiting for it to be scanned.
+    DsItemQueue *                                        _dsQueue;
+    std::unordered_map<std::string, std::vector<DsItem>> _dirDsList;
+
+    // S-57 records of the data set being parsed, or the cached one
+    S57CellRef      _cell;
+    S57CellCacheRef _cellCache;
 
 private:
     void init();
     bool checkDsValid(std::string fileName);
     void upcellDispatch();
-    void updateDataset(DsItem &);
-    void doParse(DsItem &);
+    // Merges the update cells numbered after the given one. If dispatch
+    // is false, the records inserted are kept without onRecFeature()
+    // or onRecSpatial() called.
+    void updateDataset(DsItem &, int after = 0, bool dispatch = true);
+    void clearRecords();
+
+    // Returns the path, size and time of the base cell and of the update
+    // cells up to lastUpdate, the key of the data set in the cell cache and
+    // the source of its snapshot. Empty if the base cell is not found.
+    std::string cellKey(DsItem &, int lastUpdate) const;
+
+    std::string snapshotFile(const DsItem &) const;
+    // Dispatches the records of the snapshot of the data set if it's
+    // still valid, returns the number of the last update cell merged
+    // in it, or -1 if none is loaded.
+    int  loadSnapshot(DsItem &, S57Module &);
+    void saveSnapshot(DsItem &, int updateNumber);
+    // Replays the data set fully and compares the result with the records
+    // kept, which stay replaced by the replay. Returns true if same.
+    bool verifySnapshot(DsItem &);
+
+    void scanPipelined(std::string path);
 
     // inherits from S57DatasetScanner
     void onDataset(std::string);
+    void onDirectoryScanned(std::string);
 
 protected:
     void setIgnoreBaseCell(bool);
     bool ignoreBaseCell() const;
 
-    void parseOneDataset(std::string fileName);
+    // Writes the progress of the parsing to stdout, as printf() does.
+    // A worker scanner buffers it instead, then flushProgress() writes
+    // it at once, under a lock shared by all the scanners, so the lines
+    // of the workers never mix.
+    void progress(const char * fmt, ...);
+    void flushProgress();
+    void setProgressBuffered(bool);
 
-    S57FeatureRecordRef findFeatureTarget(const S57_NAME &, s57_b12 objl);
-    S57VectorRecordRef  findVectorTarget(const S57_NAME &);
+    // Copies the parse settings to a worker scanner, the cell cache
+    // included, and makes it buffer its progress.
+    void setupWorker(S57ParseScanner & worker) const;
 
-    S57DSInfoRecordRef                       s57DsInfoRecord() const;
-    S57DSGeoRecordRef                        s57DsGeoRecord() const;
-    S57DSAccuracyRecordRef                   s57DsAccuracyRecord() const;
+    void parseOneDataset(std::string fileName);
+
+    // Parses one data set and its update cells, then calls onParse().
+    void doParse(DsItem &);
+    // Parses each data set of the list in order, called by scan().
+    virtual void parseDatasets(std::vector<DsItem> &);
+    // Parses each data set taken from the queue until it's closed,
+    // called by scan() in pipeline mode.
+    virtual void parseQueue(DsItemQueue &);
+
+    // Keeps the record in its list and indexes it by name, as the
+    // default onRecFeature() and onRecSpatial() do when not streaming.
+    void keepFeature(S57FeatureRecord *);
+    void keepSpatial(S57VectorRecord *);
+
+    // Returns the record kept in the list, or a null one if not found.
+    // The reference is valid until the next record is kept.
+    const S57FeatureRecordRef & findFeatureTarget(const S57_NAME &, s57_b12 objl) const;
+    const S57VectorRecordRef &  findVectorTarget(const S57_NAME &) const;
+
+    const S57DSInfoRecordRef &               s57DsInfoRecord() const;
+    const S57DSGeoRecordRef &                s57DsGeoRecord() const;
+    const S57DSAccuracyRecordRef &           s57DsAccuracyRecord() const;
     const std::vector<S57FeatureRecordRef> & grList() const;
     const std::vector<S57FeatureRecordRef> & mrList() const;
     const std::vector<S57FeatureRecordRef> & lrList() const;
@@ -136,6 +237,52 @@ public:
     bool precheckEnabled() const;
     void setPrecheck(bool);
 
+    // In streaming mode each feature and vector record is dropped as soon
+    // as onRecFeature() or onRecSpatial() returns, unless it is kept by the
+    // handler, so the record lists are empty in onParse(). Update cells
+    // are not merged in this mode.
+    bool streamingEnabled() const;
+    void setStreaming(bool);
+
+    // Parses the data sets with lazy record decoding,
+    // see S57Module::setLazyDecoding().
+    bool lazyDecodingEnabled() const;
+    void setLazyDecoding(bool);
+
+    // Reads the cells through a memory mapping rather than the stdio
+    // buffer, see S57Module::open(). Enabled by default.
+    bool mappedReadingEnabled() const;
+    void setMappedReading(bool);
+
+    // If the path is set, the merged state of each data set having update
+    // cells is saved there as a snapshot, then a later run loads it and
+    // merges only the update cells newer than it. Not used in streaming
+    // mode. In verify mode the state loaded is checked against a full
+    // replay of the update cells.
+    std::string snapshotPath() const;
+    void        setSnapshotPath(std::string);
+    bool        snapshotVerifyEnabled() const;
+    void        setSnapshotVerify(bool);
+
+    // If the depth is not 0, scan() walks the directories on a thread of
+    // its own and queues each data set as soon as its directory has been
+    // listed, up to depth data sets, so the parsing starts before the walk
+    // ends. The data sets are then parsed in the order found. With updating
+    // the data sets are queued at the end of the walk, once the update
+    // cells of each one are known, so only the walk runs ahead. Not used
+    // with precheck, 0 (by default) finds all the data sets first.
+    int  pipelineDepth() const;
+    void setPipelineDepth(int);
+
+    // If a cache is set, each data set parsed is cached merged, keyed by
+    // the path, size and modification time of its base and update cells,
+    // and parsing it again takes the cached records, which stay read-only.
+    // onRecFeature() and onRecSpatial() are then not called, the records
+    // are in the lists already. A cache can be shared by scanners of any
+    // kind and thread. Not used in streaming mode.
+    S57CellCacheRef cellCache() const;
+    void            setCellCache(S57CellCacheRef);
+
     void scan(std::string path);
 };
 
@@ -181,39 +328,109 @@ inline void S57ParseScanner::setPrecheck(bool on)
     _precheckEnabled = on;
 }
 
-inline S57DSInfoRecordRef S57ParseScanner::s57DsInfoRecord() const
+inline bool S57ParseScanner::streamingEnabled() const
+{
+    return _streamingEnabled;
+}
+
+inline void S57ParseScanner::setStreaming(bool on)
+{
+    _streamingEnabled = on;
+}
+
+inline bool S57ParseScanner::lazyDecodingEnabled() const
+{
+    return _lazyDecodingEnabled;
+}
+
+inline void S57ParseScanner::setLazyDecoding(bool on)
+{
+    _lazyDecodingEnabled = on;
+}
+
+inline bool S57ParseScanner::mappedReadingEnabled() const
+{
+    return _mappedReadingEnabled;
+}
+
+inline void S57ParseScanner::setMappedReading(bool on)
+{
+    _mappedReadingEnabled = on;
+}
+
+inline std::string S57ParseScanner::snapshotPath() const
+{
+    return _snapshotPath;
+}
+
+inline void S57ParseScanner::setSnapshotPath(std::string path)
+{
+    _snapshotPath = path;
+}
+
+inline bool S57ParseScanner::snapshotVerifyEnabled() const
+{
+    return _snapshotVerify;
+}
+
+inline void S57ParseScanner::setSnapshotVerify(bool on)
+{
+    _snapshotVerify = on;
+}
+
+inline int S57ParseScanner::pipelineDepth() const
+{
+    return _pipelineDepth;
+}
+
+inline void S57ParseScanner::setPipelineDepth(int depth)
+{
+    _pipelineDepth = depth < 0 ? 0 : depth;
+}
+
+inline S57CellCacheRef S57ParseScanner::cellCache() const
+{
+    return _cellCache;
+}
+
+inline void S57ParseScanner::setCellCache(S57CellCacheRef cache)
+{
+    _cellCache = cache;
+}
+
+inline const S57DSInfoRecordRef & S57ParseScanner::s57DsInfoRecord() const
 {
-    return _dsinfRec;
+    return _cell->_dsinfRec;
 }
 
-inline S57DSGeoRecordRef S57ParseScanner::s57DsGeoRecord() const
+inline const S57DSGeoRecordRef & S57ParseScanner::s57DsGeoRecord() const
 {
-    return _dsgeoRec;
+    return _cell->_dsgeoRec;
 }
 
-inline S57DSAccuracyRecordRef S57ParseScanner::s57DsAccuracyRecord() const
+inline const S57DSAccuracyRecordRef & S57ParseScanner::s57DsAccuracyRecord() const
 {
-    return _dsaccRec;
+    return _cell->_dsaccRec;
 }
 
 inline const std::vector<S57FeatureRecordRef> & S57ParseScanner::grList() const
 {
-    return _grList;
+    return _cell->_grList;
 }
 
 inline const std::vector<S57FeatureRecordRef> & S57ParseScanner::mrList() const
 {
-    return _mrList;
+    return _cell->_mrList;
 }
 
 inline const std::vector<S57FeatureRecordRef> & S57ParseScanner::lrList() const
 {
-    return _lrList;
+    return _cell->_lrList;
 }
 
 inline const std::vector<S57VectorRecordRef> & S57ParseScanner::vrList() const
 {
-    return _vrList;
+    return _cell->_vrList;
 }
 
 // ~
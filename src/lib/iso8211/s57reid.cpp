@@ -254,7 +254,7 @@ bool DsReidScanner::checkDsValid(string fileName)
     printf("%s\t", fileName.c_str());
     fflush(stdout);
 
-    S57Module mod(fileName);
+    S57Module mod(fileName, true);
     if (!mod.isOpen())
         return false;
 
@@ -410,7 +410,7 @@ void DsReidScanner::updateDataset(DsItem & ds)
     for (; it != ds.updateEnd(); ++it)
     {
         printf(" %d", it.number());
-        if (!upCell.open(*it))
+        if (!upCell.open(*it, true))
             continue;
         // for each update records
         while (!upCell.atEnd())
@@ -573,7 +573,7 @@ void DsReidScanner::doCast(DsItem & ds)
     // Reads all records.
     // Data set information record, Data set Geographic record,
     // Data set accruacy record to form IR_DatasetParam structure.
-    S57Module mod(ds.dsFile());
+    S57Module mod(ds.dsFile(), true);
     if (!mod.isOpen())
         return;
     while (!mod.atEnd())
@@ -3,6 +3,7 @@
 // #include <string.h>
 #include <cstring>
 #include <assert.h>
+#include <mutex>
 
 #include "debug_alloc.h"
 
@@ -124,6 +125,9 @@ inline int SrcModule::allocCount() const
 
 static SrcModule * modq = NULL;
 
+// Guards the module list, allocations may come from several threads.
+static std::recursive_mutex modqLock;
+
 SrcModule * setModule(const char * src)
 {
     SrcModule * pmod = modq;
@@ -161,6 +165,7 @@ MemEntry * findPtr(void * ptr)
 
 void * dbg_calloc(size_t nmemb, size_t size, const char * src, int lno)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     void *      ptr = calloc(nmemb, size);
     SrcModule * m   = setModule(src);
     m->addEntry(FROM_MALLOC, ptr, size, lno);
@@ -169,6 +174,7 @@ void * dbg_calloc(size_t nmemb, size_t size, const char * src, int lno)
 
 void * dbg_malloc(size_t size, const char * src, int lno)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     void *      ptr = malloc(size);
     SrcModule * m   = setModule(src);
     m->addEntry(FROM_MALLOC, ptr, size, lno);
@@ -177,6 +183,7 @@ void * dbg_malloc(size_t size, const char * src, int lno)
 
 void * dbg_realloc(void * ptr, size_t size, const char * src, int lno)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     if (ptr == NULL)
         return dbg_malloc(size, src, lno);
 
@@ -211,6 +218,7 @@ void * dbg_realloc(void * ptr, size_t size, const char * src, int lno)
 
 char * dbg_strdup(const char * s, const char * src, int lno)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     char *      ptr = strdup(s);
     SrcModule * m   = setModule(src);
     m->addEntry(FROM_STRDUP, ptr, strlen(s) + 1, lno);
@@ -219,6 +227,7 @@ char * dbg_strdup(const char * s, const char * src, int lno)
 
 void dbg_free(void * ptr, const char * src, int lno)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     MemEntry * ent = findPtr(ptr);
     if (ent == NULL)
     {
@@ -241,6 +250,7 @@ void dbg_free(void * ptr, const char * src, int lno)
 #ifdef __cplusplus
 void * operator new(size_t size, const char * src, int lno, bool)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     void *      ptr = malloc(size);
     SrcModule * m   = setModule(src);
     m->addEntry(FROM_NEW, ptr, size, lno);
@@ -249,6 +259,7 @@ void * operator new(size_t size, const char * src, int lno, bool)
 
 void * operator new[](size_t size, const char * src, int lno, bool oarr)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     void *      res = malloc(size);
     void *      ptr = oarr ? reinterpret_cast<void *>(reinterpret_cast<long long>(res) + 4) : res;
     SrcModule * mod = setModule(src);
@@ -270,6 +281,7 @@ void operator delete[](void * ptr)
 
 void removeEntry(void * ptr, const char * src, int lno, int flag)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     MemEntry * ent = findPtr(ptr);
     if (ent == NULL)
     {
@@ -307,6 +319,7 @@ void removeEntry(void * ptr, const char * src, int lno, int flag)
 
 void assureNoLeaks(const char * src)
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     SrcModule * mod = setModule(src);
     if (mod->allocCount() > 0)
     {
@@ -317,6 +330,7 @@ void assureNoLeaks(const char * src)
 
 void printAllocStats()
 {
+    std::lock_guard<std::recursive_mutex> lock(modqLock);
     printf("-----------------------------------------------------\n");
     printf("%-20s%6s %-10s%8s %s\n", "Source", "Line", "Ptr", "Size", "From");
     SrcModule * pmod = modq;